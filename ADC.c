@@ -9,6 +9,52 @@
 //      This file handles the thumb wheel and detectors
 //      Including calibration, emitter control, and displaying values
 //
+//      The ADC runs one long sequence, MEM8-MEM23:  thumb/left/right/slow
+//      ADC_BLOCK_SEQUENCES times, where slow is the temperature in the even
+//      sequences and the supply (1/2 AVCC) in the odd ones.  Every
+//      sequence is the same 4 slots, so the samples are evenly spaced.
+//      Nobody takes an ADC interrupt.  The end of the sequence triggers DMA
+//      channel 1, which copies the whole thing into one of two block
+//      buffers (dma.c) while the ADC starts on the next one, and the DMA
+//      interrupt hands us the full block:  ADC_Block runs the filters over
+//      every sequence in it and publishes, once per block instead of once
+//      per sequence.  The block stays put until the DMA comes back around
+//      to it, so ADC_Last_Block is the last ADC_BLOCK_SEQUENCES raw
+//      readings of each channel, for anything that wants a history instead
+//      of just the latest value.
+//
+//      Sample rate:  G<hz> (Set_ADC_Rate) has TA1.1 start every conversion
+//      (ADC12SHS_3, no MSC), ADC_SEQUENCE_LENGTH of them per sequence, so a
+//      sequence comes exactly every 1/hz and the filters know what a sample
+//      means in time.  ADC_RATE_MIN to ADC_RATE_MAX, ADC_RATE_DEFAULT at
+//      power up.  G0 goes back to free running (ADC12SC once, MSC), as fast
+//      as MODOSC goes and not a fixed rate.  The slots all use SHT1, the 30us
+//      the temperature sensor needs, which is what caps the rate.
+//
+//      Pulsed emitter:  E1 (Set_Emitter_Pulsed) has the TA1 ISR blink the
+//      IR LED in step with the sequences, off for the even ones and on for
+//      the odd ones, and each detector reading is off - on, a pair at a
+//      time (the emitter pulls the reading down, so that's how much the
+//      surface reflected - big on white, small on black, 0 with the LED
+//      disabled).  Sunlight and room light are in both halves, so they drop
+//      out.  Pulsed readings go the other way from steady ones and have
+//      their own thresholds (pulse_xxx_threshold, calibrate in E1).
+//      The LED goes on as the odd sequence starts (the thumb slot gives it
+//      time to settle) and off again once right has been sampled, so it's
+//      only lit 3/8 of the time.  Pulsing only works with TA1 pacing (G0
+//      turns it off), and the detectors get half as many samples.
+//
+//      Temperature and supply hardly move, so they're added up over
+//      ADC_SLOW_COUNT pairs and published as averages a few times a second
+//      (telemetry).  Both use the internal 2.5V reference, against AVCC the
+//      supply channel would always read half scale.  The supply is the
+//      regulated MCU rail, not the motor pack - the pack isn't wired to any
+//      A-channel, so nothing here can tell how tired it is.
+//
+//      Thumb and detectors go through a Filter (filter.c) before
+//      they're published, so SpeedAdjust doesn't steer on one noisy sample.
+//      The detectors default to a boxcar of 4, A<tsd> picks another one.
+//
 //      global functions
 //              ADC_Process(void)
 //              Show_Adc_Process(void)
@@ -16,13 +62,21 @@
 //              Init_ADC(void)
 //              Enable_Emitter(void)
 //              Disable_Emitter(void)
+//              ADC_Block(const unsigned int* block)            DMA ISR only
+//              Set_Detector_Filter(int code)
+//              Set_ADC_Rate(unsigned int hz)
+//              Set_Emitter_Pulsed(char on)
+//              Emitter_Pulse_Slot(void)                        TA1 ISR only
 //
 //      local functions
+//              ADC_Detectors(int left, int right)
+//              ADC_Slow_Sample(unsigned int temperature, unsigned int supply)
+//              Supply_Update(void)
 //              Average_Detectors(void)
 //              turn_Emitter_On(void)
 //              turn_Emitter_Off(void)
 //              toggle_Emitter(void)
-//              Show_Adc_Setup(void)
+//              Show_Adc_Setup(void)            a task (see timerMacros.h)
 //==============================================================================
 #include "macros.h"
 #include  "msp430.h"
@@ -30,19 +84,41 @@
 #include <string.h>
 
 int Average_Detectors(void);
+void ADC_Slow_Sample(unsigned int temperature, unsigned int supply);
+void ADC_Detectors(int left, int right);
+void Supply_Update(void);
 void turn_Emitter_On(void);
 void turn_Emitter_Off(void);
 void toggle_Emitter(void);
-void Show_Adc_Setup(void);
+char Show_Adc_Setup(void);
   
 char ADC_oneTime = YES;                                 //run setup functions one time only
+Task show_adc_task;                                     //Show_Adc_Setup's place
 extern volatile int ADC_Thumb           = EMPTY;        //ADC values
 extern volatile int ADC_Right_Detector  = EMPTY;        //directly from interrupt
 extern volatile int ADC_Left_Detector   = EMPTY;
+volatile int ADC_Temperature = EMPTY;                   //slow averages
+volatile int ADC_Supply      = EMPTY;                   //(ADC_Slow_Sample)
+volatile char adc_slow_ready = NO;                      //a new pair is in
+unsigned long temperature_sum = COUNT_RESET;            //ISR only
+unsigned long supply_sum      = COUNT_RESET;
+unsigned int slow_count       = COUNT_RESET;
+unsigned int supply_mv        = EMPTY;                  //AVCC in mV, EMPTY until measured
+const unsigned int* volatile ADC_Last_Block = NULL;    //the newest full block
+volatile unsigned int adc_blocks = COUNT_RESET;         //how many so far
+unsigned int adc_rate = EMPTY;                          //sequences a second, EMPTY = free running
+char emitter_pulsed = NO;                               //E1, blink it with the sequences
+unsigned char emitter_slot = COUNT_RESET;               //the conversion TA1 starts next, 0-7
+Filter thumb_filter;                                    //ISR only, once running
+Filter left_filter;
+Filter right_filter;
 
 extern float black_threshold = DEFAULT_BLACK_THRESHOLD;   //value between black/grey
 extern float white_threshold = DEFAULT_WHITE_THRESHOLD;   //value between grey/white
 extern float on_threshold = DEFAULT_ON_THRESHOLD;         //was the emitter on for the reading?
+float pulse_black_threshold = DEFAULT_PULSE_BLACK_THRESHOLD; //the same three for E1,
+float pulse_white_threshold = DEFAULT_PULSE_WHITE_THRESHOLD; //where white is the big one
+float pulse_on_threshold    = DEFAULT_PULSE_ON_THRESHOLD;
 
 char enabled_emitter = NO;       //is the emitter enabled?
 char emitter_on = NO;            //is the emitter on?
@@ -72,8 +148,12 @@ void Disable_Emitter(void) {
 //If another function wants to turn on the emitter, it should
 //call the function Enable_Emitter()
 void ADC_Process(void) {
-  if(emitter_switched) {        //to avoid repeatedly assigning pin output
-    emitter_switched = NO;
+  if(adc_slow_ready){           //new supply reading, a few times a second
+    adc_slow_ready = NO;
+    Supply_Update();
+  }
+  if(emitter_switched && !emitter_pulsed) {     //to avoid repeatedly assigning pin output
+    emitter_switched = NO;                      //(pulsed, the TA1 ISR does it)
     if(enabled_emitter)
       turn_Emitter_On();
     else
@@ -81,6 +161,132 @@ void ADC_Process(void) {
   }
 }
 
+//a block came in (DMA channel 1), filter every sequence in it and publish
+void ADC_Block(const unsigned int* block){
+  const unsigned int* sequence = block;
+  const unsigned int* previous;
+  char count;
+  for(count=COUNT_RESET; count<ADC_BLOCK_SEQUENCES; count++){
+    if(Filter_Sample(&thumb_filter, sequence[ADC_SEQUENCE_THUMB]))
+      ADC_Thumb          = thumb_filter.output;
+    if(!emitter_pulsed)
+      ADC_Detectors(sequence[ADC_SEQUENCE_LEFT], sequence[ADC_SEQUENCE_RIGHT]);
+    if(count & ADJUST_1){                       //odd, the supply; the one before was the temperature
+      previous = sequence - ADC_SEQUENCE_LENGTH;
+      ADC_Slow_Sample(previous[ADC_SEQUENCE_SLOW], sequence[ADC_SEQUENCE_SLOW]);
+      if(emitter_pulsed)                        //this one lit, the one before dark
+        ADC_Detectors(previous[ADC_SEQUENCE_LEFT] - sequence[ADC_SEQUENCE_LEFT],
+                      previous[ADC_SEQUENCE_RIGHT] - sequence[ADC_SEQUENCE_RIGHT]);
+    }
+    sequence += ADC_SEQUENCE_LENGTH;
+  }
+  ADC_Last_Block = block;
+  adc_blocks++;
+}
+
+//one reading per detector, through the filters
+void ADC_Detectors(int left, int right){
+  if(left < EMPTY)                              //pulsed, the room got darker mid pair
+    left = EMPTY;
+  if(right < EMPTY)
+    right = EMPTY;
+  if(Filter_Sample(&left_filter, left))
+    ADC_Left_Detector  = left_filter.output;
+  if(Filter_Sample(&right_filter, right))
+    ADC_Right_Detector = right_filter.output;
+}
+
+//G<hz> - TA1 starts every conversion at hz sequences a second, 0 = free run
+//stops the ADC on the spot, the DMA just waits for the next full sequence
+void Set_ADC_Rate(unsigned int hz){
+  if(hz && hz < ADC_RATE_MIN)
+    hz = ADC_RATE_MIN;
+  if(hz > ADC_RATE_MAX)
+    hz = ADC_RATE_MAX;
+  ADC12CTL0 &= ~ADC12ENC;
+  ADC12CTL1 &= ~ADC12CONSEQ_3;                  //ENC and CONSEQ 0 stop it right away
+  Timer_A1_Rate(hz * ADC_SEQUENCE_LENGTH);      //0 stops TA1
+  if(!hz && emitter_pulsed){                    //nothing to keep in step with
+    emitter_pulsed = NO;
+    emitter_switched = YES;                     //ADC_Process puts it back steady
+  }
+  emitter_slot = COUNT_RESET;                   //TA1 and the ADC both start over
+  if(emitter_pulsed){
+    turn_Emitter_Off();                         //sequence 0 is dark
+    TA1CCTL0 |= CCIE;                           //Emitter_Pulse_Slot
+  }
+  else
+    TA1CCTL0 &= ~CCIE;
+  ADC12CTL1 &= ~ADC12SHS_7;
+  if(hz){
+    ADC12CTL0 &= ~ADC12MSC;                     //one TA1.1 edge per conversion
+    ADC12CTL1 |= ADC12SHS_3;                    //sample-and-hold source TA1.1
+  }
+  else{
+    ADC12CTL0 |= ADC12MSC;                      //back to back
+    ADC12CTL1 |= ADC12SHS_0;                    //sample-and-hold source ADC12SC
+  }
+  ADC12CTL1 |= ADC12CONSEQ_3;                   //Repeat-sequence-of-channels, from MEM8 again
+  ADC12CTL0 |= ADC12ENC;
+  if(!hz)
+    ADC12CTL0 |= ADC12SC;                       //free running needs the first push
+  adc_rate = hz;
+}
+
+//E<n> - 1 pulses the emitter with the sequences, 0 holds it steady again
+//restarts the ADC so TA1 and the sequence line up
+void Set_Emitter_Pulsed(char on){
+  if(on && adc_rate == EMPTY)                   //free running, G<hz> first
+    return;
+  emitter_pulsed = on;
+  emitter_switched = YES;
+  Set_ADC_Rate(adc_rate);
+}
+
+//TA1.1 just started conversion emitter_slot (two sequences, 0-7)
+//the LED changes while thumb or slow is sampling, never left or right
+void Emitter_Pulse_Slot(void){
+  if(emitter_slot == EMITTER_ON_SLOT && enabled_emitter)
+    turn_Emitter_On();
+  else if(emitter_slot == EMITTER_OFF_SLOT)
+    turn_Emitter_Off();
+  emitter_slot = (emitter_slot + ADJUST_1) & EMITTER_SLOT_MASK;
+}
+
+//one temperature and supply conversion per pair of sequences
+//average ADC_SLOW_COUNT of them, then publish
+void ADC_Slow_Sample(unsigned int temperature, unsigned int supply){
+  temperature_sum += temperature;
+  supply_sum += supply;
+  slow_count++;
+  if(slow_count < ADC_SLOW_COUNT)
+    return;
+  ADC_Temperature = temperature_sum >> ADC_SLOW_SHIFT;
+  ADC_Supply = supply_sum >> ADC_SLOW_SHIFT;
+  temperature_sum = COUNT_RESET;
+  supply_sum = COUNT_RESET;
+  slow_count = COUNT_RESET;
+  adc_slow_ready = YES;
+}
+
+//A<tsd> - the same filter on both detectors (see macros.h), starts over empty
+void Set_Detector_Filter(int code){
+  char type = code / FILTER_CODE_TYPE;
+  char size = (code / FILTER_CODE_SIZE) % MOVE_UP_A_TENS_PLACE;
+  char decimate = code % MOVE_UP_A_TENS_PLACE;
+  unsigned short interrupt_state = __get_interrupt_state();
+  __disable_interrupt();                        //not halfway through a sample
+  Init_Filter(&left_filter, type, size, decimate);
+  Init_Filter(&right_filter, type, size, decimate);
+  __set_interrupt_state(interrupt_state);
+}
+
+//the supply average in mV, for telemetry
+void Supply_Update(void){
+  supply_mv = ((unsigned long)ADC_Supply * ADC_REF_MILLIVOLTS * SUPPLY_DIVIDER)
+              / ADC_FULL_SCALE;
+}
+
 //local access functions
 void turn_Emitter_On(void){
   P8OUT |= IR_LED;
@@ -96,20 +302,24 @@ void toggle_Emitter(void){
 
 
 //clear the screen and label the ADC values
-void Show_Adc_Setup(void) {
+//leave the labels up for a bit before the numbers show up
+char Show_Adc_Setup(void) {
+  TASK_BEGIN(&show_adc_task);
   clearDisplay();
   strcpy(display_line[DISPLAY_LINE_1], "     THUMB");
   strcpy(display_line[DISPLAY_LINE_2], "      LEFT");
   strcpy(display_line[DISPLAY_LINE_3], "     RIGHT");
   strcpy(display_line[DISPLAY_LINE_4], "b2 to Menu");
-  delay_100ms(VHUNDRED_MS);
+  TASK_DELAY(&show_adc_task, VHUNDRED_MS);
+  TASK_END(&show_adc_task);
 }
 
 //Show the three ADCs on the display
 //Press button 1 to turn on the emitter
 void Show_Adc_Process(void) {
   if(ADC_oneTime) {     //run a setup function
-    Show_Adc_Setup();   //that labels the values
+    if(Show_Adc_Setup() == TASK_WAITING)        //that labels the values
+      return;
     ADC_oneTime = NO;
   }
   showADC(ADC_Thumb,            DISPLAY_LINE_1);
@@ -158,6 +368,12 @@ void Calibrate_Process(void) {
       break;
     case DONE_CALIBRATING:
       Disable_Emitter();
+      if(emitter_pulsed){
+        showADC((int)pulse_white_threshold, DISPLAY_LINE_2);
+        showADC((int)pulse_black_threshold, DISPLAY_LINE_3);
+        showADC((int)pulse_on_threshold,    DISPLAY_LINE_4);
+        break;
+      }
       showADC((int)white_threshold, DISPLAY_LINE_2);
       showADC((int)black_threshold, DISPLAY_LINE_3);
       showADC((int)on_threshold,   DISPLAY_LINE_4);
@@ -188,9 +404,16 @@ void Calibrate_Process(void) {
       case CAL_LINE:                            //EMITTER ON LINE===============
         grey_reading = ADC_Right_Detector;      //don't average the values for this reading
         //finished calibrating - time to calculate the color thresholds
-        black_threshold = grey_reading + BLACK_MARGIN;          //black - grey transition
-        white_threshold = grey_reading - WHITE_MARGIN;          //grey - white transition
-        on_threshold = (black_reading + off_reading)/AVERAGE_2; //for knowing if the emitter is actually on
+        if(emitter_pulsed){                     //E1, white reads high and black low
+          pulse_black_threshold = grey_reading - BLACK_MARGIN;
+          pulse_white_threshold = grey_reading + WHITE_MARGIN;
+          pulse_on_threshold = (black_reading + off_reading)/AVERAGE_2;
+        }
+        else{
+          black_threshold = grey_reading + BLACK_MARGIN;          //black - grey transition
+          white_threshold = grey_reading - WHITE_MARGIN;          //grey - white transition
+          on_threshold = (black_reading + off_reading)/AVERAGE_2; //for knowing if the emitter is actually on
+        }
         
         Disable_Emitter();      //no need for the emitter any more
         clearDisplay();         
@@ -207,18 +430,29 @@ void Calibrate_Process(void) {
 
 //this function prepares the ADCs for use
 void Init_ADC(void){
+  volatile unsigned int* channel_control;
+  char sequence;
+  Init_Filter(&thumb_filter, THUMB_FILTER_TYPE, THUMB_FILTER_SIZE, ADJUST_1);
+  Set_Detector_Filter(DETECTOR_FILTER_DEFAULT);
+
+// Internal reference for the temperature and supply channels
+  REFCTL0 |= REFVSEL_2;         // 2.5V
+  REFCTL0 |= REFON;
+  while(!(REFCTL0 & REFGENRDY));        // wait for it to settle (init only)
+
 // Configure ADC12 - Copied from Wolfware
 // ADC10CTL0 Register Description
   ADC12CTL0 = RESET_STATE;
-  ADC12CTL0 |= ADC12SHT0_2;     // Sample and Hold time, ADC12MEM8-MEM23,               16 ADC clocks
-  ADC12CTL0 |= ADC12SHT1_2;     // Sample and Hold time, ADC12MEM0-MEM7, MEM24-MEM31,   16 ADC clocks
-  ADC12CTL0 |= ADC12MSC;        // First rising edge SHI signal triggers sampling timer
+  ADC12CTL0 |= ADC12SHT0_2;     // Sample and Hold time, ADC12MEM0-MEM7, MEM24-MEM31,   16 ADC clocks (not used)
+  ADC12CTL0 |= ADC12SHT1_7;     // Sample and Hold time, ADC12MEM8-MEM23,               192 ADC clocks
+                                // (the temperature sensor needs 30us, every slot gets it)
+  ADC12CTL0 |= ADC12MSC;        // First rising edge SHI signal triggers sampling timer (Set_ADC_Rate)
   ADC12CTL0 |= ADC12ON;         // ADC12 on
 
 // ADC10CTL1 Register Description
   ADC12CTL1 = RESET_STATE;
   ADC12CTL1 |= ADC12PDIV_0;     // Predivide ADC12_B clock source by 1
-  ADC12CTL1 |= ADC12SHS_0;      // sample-and-hold source ADC12SC
+  ADC12CTL1 |= ADC12SHS_0;      // sample-and-hold source ADC12SC (Set_ADC_Rate)
   ADC12CTL1 |= ADC12SHP;        // SAMPCON signal is sourced from the sampling timer.
   ADC12CTL1 |= ADC12ISSH_0;     // sample-input signal is not inverted
   ADC12CTL1 |= ADC12DIV_0;      // clock divider, /1
@@ -241,40 +475,23 @@ void Init_ADC(void){
   ADC12CTL3 |= ADC12ICH0MAP_0;  // external pin is selected for ADC input channel A29
   ADC12CTL3 |= ADC12TCMAP_1;    // ADC internal temperature sensor ADC input channel A30
   ADC12CTL3 |= ADC12BATMAP_1;   // ADC internal 1/2 x AVCC is ADC input channel A31
-  ADC12CTL3 |= ADC12CSTARTADD_0; // conversion start address: 0h to 1Fh, corresponding to ADC12MEM0 to ADC12MEM31
-
-// ADC10MCTL0 Register Description
-  ADC12MCTL0 = RESET_STATE;
-  ADC12MCTL0 |= ADC12WINC_0;    // Comparator window disabled
-  ADC12MCTL0 |= ADC12DIF_0;     // Single-ended mode enabled
-  ADC12MCTL0 |= ADC12VRSEL_0;   // VR+ = AVCC, VR- = AVSS
-  ADC12MCTL0 |= ADC12INCH_2;    // channel = A2 Thumb Wheel
-
-  ADC12MCTL1 = RESET_STATE;
-  ADC12MCTL1 |= ADC12WINC_0;  // Comparator window disabled
-  ADC12MCTL1 |= ADC12DIF_0;   // Single-ended mode enabled
-  ADC12MCTL1 |= ADC12VRSEL_0; // VR+ = AVCC, VR- = AVSS
-  ADC12MCTL1 |= ADC12INCH_5;  // channel = A5 Left
-
-  ADC12MCTL2 = RESET_STATE;
-  ADC12MCTL2 |= ADC12WINC_0;  // Comparator window disabled
-  ADC12MCTL2 |= ADC12DIF_0;   // Single-ended mode enabled
-  ADC12MCTL2 |= ADC12VRSEL_0; // VR+ = AVCC, VR- = AVSS
-  ADC12MCTL2 |= ADC12INCH_4;  // channel = A4 Right
-  ADC12MCTL2 |= ADC12EOS;               //from the slides
-
-  ADC12MCTL3 = RESET_STATE;
-  ADC12MCTL3 |= ADC12WINC_0;  // Comparator window disabled
-  ADC12MCTL3 |= ADC12DIF_0;   // Single-ended mode enabled
-  ADC12MCTL3 |= ADC12VRSEL_0; // VR+ = AVCC, VR- = AVSS
-  ADC12MCTL3 |= ADC12INCH_30; // Temp sensor
-
-  ADC12MCTL4 = RESET_STATE;
-  ADC12MCTL4 |= ADC12WINC_0;  // Comparator window disabled
-  ADC12MCTL4 |= ADC12DIF_0;   // Single-ended mode enabled
-  ADC12MCTL4 |= ADC12VRSEL_0; // VR+ = AVCC, VR- = AVSS
-  ADC12MCTL4 |= ADC12INCH_31; // Battery voltage monitor
-  ADC12MCTL4 |= ADC12EOS;     // End of Sequence
+  ADC12CTL3 |= ADC12CSTARTADD_8; // conversion start address: 0h to 1Fh, corresponding to ADC12MEM0 to ADC12MEM31
+
+// ADC12MCTLx Register Descriptions
+// The sequence is one DMA block (see the top):  thumb/left/right/slow
+// ADC_BLOCK_SEQUENCES times in MEM8-MEM23 (all SHT1), slow is the temp sensor
+// in the even sequences and 1/2 AVCC in the odd ones
+  channel_control = &ADC12MCTL8;        // the MCTLs are one after the other
+  for(sequence=COUNT_RESET; sequence<ADC_BLOCK_SEQUENCES; sequence++){
+    *channel_control++ = ADC12VRSEL_0 | ADC12INCH_2;    // A2 Thumb Wheel, AVCC
+    *channel_control++ = ADC12VRSEL_0 | ADC12INCH_5;    // A5 Left
+    *channel_control++ = ADC12VRSEL_0 | ADC12INCH_4;    // A4 Right
+    if(sequence & ADJUST_1)                             // VREF buffered (2.5V)
+      *channel_control++ = ADC12VRSEL_1 | ADC12INCH_31; // Supply (1/2 AVCC) monitor
+    else
+      *channel_control++ = ADC12VRSEL_1 | ADC12INCH_30; // Temp sensor
+  }
+  *(channel_control - ADJUST_1) |= ADC12EOS;            // End of Sequence, the DMA trigger
 
 // ADC12IER0-2 Register Descriptions
   ADC12IER0 = RESET_STATE;    // Interrupts for channels  0 - 15
@@ -282,12 +499,12 @@ void Init_ADC(void){
   ADC12IER2 = RESET_STATE;    // Interrupts for ADC12RDYIE ADC12TOVIE ADC12OVIE
                               // ADC12HIIE ADC12LOIE ADC12INIE
 							  
-//  ADC12IER0 |= ADC12IE4;      // Generate Interrupt for MEM2 ADC Data load//
-  ADC12IER0 |= ADC12IE2;    // Generate Interrupt for MEM2 ADC Data load
+                              // none, DMA channel 1 takes every sequence
+//  ADC12IER0 |= ADC12IE2;    // Generate Interrupt for MEM2 ADC Data load
 //  ADC12IER0 |= ADC12IE0;    // Enable ADC conv complete interrupt
+  Init_DMA_ADC();             // ready before the first sequence ends
 
-  ADC12CTL0 |= ADC12ENC;     // Start conversion
-  ADC12CTL0 |= ADC12SC;      // Start sampling
+  Set_ADC_Rate(ADC_RATE_DEFAULT);       // Start conversion, TA1 paced
 //------------------------------------------------------------------------------
 }
 
@@ -0,0 +1,84 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      assembler.c
+//
+//      puts text commands together one char at a time, one Assembler per
+//      place commands come from:
+//              pc_assembler            the terminal (UCA0), in serial.c
+//              Session.assembler       each TCP client, in session.c
+//      Nobody shares a buffer, so typing on the terminal in the middle of a
+//      Wi-Fi command (or two clients talking at once) can't glue two
+//      commands together.  Every finished command goes the same way,
+//      Execute_Command(command, source, cid), and from there the queue.
+//
+//      A command ends with \r or \n.  \r\n (or a blank line) isn't two
+//      commands, an empty one is just skipped.  An assembler that isn't in
+//      line mode also ends a command at Assembler_End_Of_Frame, for TCP
+//      clients that send one command per frame and never send \r or \n;
+//      the first \r or \n it sees switches it to line mode for good.
+//
+//      A command that doesn't fit in COMMAND_MAX_LENGTH is thrown out when
+//      it ends (and counted in commands_too_long), cutting it short could
+//      turn f100 into f10.
+//
+//      global functions
+//              Init_Assembler(Assembler* a, char source, char cid, char line_mode)
+//              Assembler_Char(Assembler* a, char c)
+//              Assembler_End_Of_Frame(Assembler* a)
+//
+//      local functions
+//              Assembler_Done(Assembler* a)
+//
+//==============================================================================
+#include "macros.h"
+#include  "functions.h"
+
+void Assembler_Done(Assembler* a);
+
+unsigned int commands_too_long = COUNT_RESET;
+
+
+
+//==============================================================================
+//start empty, every command out of this one goes to source/cid
+void Init_Assembler(Assembler* a, char source, char cid, char line_mode){
+  a->length = COUNT_RESET;
+  a->source = source;
+  a->cid = cid;
+  a->line_mode = line_mode;
+  a->too_long = NO;
+}
+
+void Assembler_Char(Assembler* a, char c){
+  if(c == EMPTY)                                //never part of a text command
+    return;
+  if(c == RETURN_CHAR || c == NEW_LINE_CHAR){
+    a->line_mode = YES;
+    Assembler_Done(a);
+    return;
+  }
+  if(a->length < (COMMAND_MAX_LENGTH - NEXT_TO_LAST)){  //keep room for the NUL
+    a->command[a->length] = c;
+    a->length++;
+  }
+  else
+    a->too_long = YES;
+}
+
+//the frame the chars came in is over
+void Assembler_End_Of_Frame(Assembler* a){
+  if(!a->line_mode)                             //old client, the frame is the command
+    Assembler_Done(a);
+}
+
+void Assembler_Done(Assembler* a){
+  if(a->too_long)
+    commands_too_long++;
+  else if(a->length){
+    a->command[a->length] = EMPTY;
+    Execute_Command(a->command, a->source, a->cid);
+  }
+  a->length = COUNT_RESET;
+  a->too_long = NO;
+}
@@ -0,0 +1,99 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      bridge.c
+//
+//      the PC <-> IOT bridge, so the PC can talk to the module directly
+//      (configuration, firmware tools) at full speed
+//
+//      While the bridge is up the RX ISRs do all the work:
+//              UCA0 RX char -> UCA3 TX ring -> the module
+//              UCA3 RX char -> UCA0 TX ring -> the PC
+//      no OS loop pass in the middle, so it keeps up with the line.  Each
+//      direction has its own ring, so a burst one way never holds up the
+//      other way.  A char that doesn't fit is dropped and counted in that
+//      TX ring (see the Q command).  If UCA3 runs faster than UCA0 a long
+//      reply from the module can outrun the PC side, keep the rates close.
+//
+//      The ISRs are the producers for both TX rings now, so the OS loop
+//      doesn't queue anything (commands, AT, telemetry, mirror) until the
+//      bridge is down again.  TCP frames aren't pulled apart either, the
+//      PC sees exactly what the module sent.
+//
+//      To leave:  BRIDGE_ESCAPE_COUNT BRIDGE_ESCAPE_CHARs in a row from the
+//      PC (Ctrl-] three times, they do get passed on) or button 2.
+//
+//      global functions
+//              Bridge_Process(void)                    the menu event
+//              Bridge_UCA0_Char(char c)                ISR only
+//              Bridge_UCA3_Char(char c)                ISR only
+//
+//      local functions
+//              Start_Bridge(void)
+//              Stop_Bridge(void)
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include  "functions.h"
+#include <string.h>
+
+void Start_Bridge(void);
+void Stop_Bridge(void);
+
+volatile char bridge_active = NO;               //the ISRs forward while this is YES
+volatile char bridge_escape_count = COUNT_RESET;        //escape chars in a row
+volatile char bridge_exit = NO;                 //the PC asked to leave
+
+
+
+//==============================================================================
+//the menu event
+void Bridge_Process(void){
+  if(!bridge_active)
+    Start_Bridge();
+  if(bridge_exit || Check_Button_2()){
+    Stop_Bridge();
+    endEvent();
+  }
+}
+
+void Start_Bridge(void){
+  bridge_escape_count = COUNT_RESET;
+  bridge_exit = NO;
+  bridge_active = YES;                          //from here on the ISRs own the TX rings
+  clearDisplay();
+  strcpy(display_line[DISPLAY_LINE_1], "  BRIDGE  ");
+  strcpy(display_line[DISPLAY_LINE_2], "PC <-> IOT");
+  strcpy(display_line[DISPLAY_LINE_4], "      EXIT");
+}
+
+//an ISR can't be halfway through a char when this runs (the OS loop is
+//what got interrupted), so once the flag is down nothing else is forwarded
+void Stop_Bridge(void){
+  bridge_active = NO;
+  bridge_exit = NO;
+}
+
+
+//==============================================================================
+//                      ISR side
+//==============================================================================
+//from the PC, on its way to the module
+void Bridge_UCA0_Char(char c){
+  if(c == BRIDGE_ESCAPE_CHAR){
+    bridge_escape_count++;
+    if(bridge_escape_count >= BRIDGE_ESCAPE_COUNT)
+      bridge_exit = YES;                        //Bridge_Process takes it down
+  }
+  else
+    bridge_escape_count = COUNT_RESET;
+  if(put_Ring_Char(&UCA3_Tx_Ring, c))           //dropped (and counted) if full
+    StartTransmit_UCA3();
+}
+
+//from the module, on its way to the PC
+void Bridge_UCA3_Char(char c){
+  if(put_Ring_Char(&UCA0_Tx_Ring, c))
+    StartTransmit_UCA0();
+}
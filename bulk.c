@@ -0,0 +1,122 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      bulk.c
+//
+//      the module's bulk data mode, the fast way to move a lot of bytes
+//
+//      A bulk frame has its length up front instead of an end marker:
+//                              <ESC>Z<n><llll>DATA
+//      llll is the length in 4 decimal digits (at most BULK_MAX_LENGTH, the
+//      module's limit), and DATA is taken as is, so binary data doesn't need
+//      any escaping and an <ESC>E in it can't end the frame early.
+//
+//      TX - Bulk_Send() queues the 7 byte header in the UCA3 TX ring like any
+//      other message, and the payload goes out straight from the caller's
+//      buffer, no copy into the ring.  bulk_tx_ahead counts the ring chars
+//      that were queued before the payload (the header and whatever was
+//      already waiting).  The TX engine (DMA or ISR) sends those, then the
+//      payload, then carries on with the ring, so everything still goes out
+//      in the order it was queued, and the OS loop can keep writing the
+//      ring the whole time.  The buffer has to stay put until Bulk_Busy()
+//      says NO.  One bulk frame at a time.
+//
+//      RX - frames.c knows bulk frames too.  One that fits in a frame slot
+//      is handed over like any TCP frame (so a client can send commands in
+//      bulk mode), a longer one is skipped and counted in frames_rejected.
+//
+//      global functions
+//              Bulk_Send(char cid, const char* data, unsigned int length)
+//              Bulk_Busy(void)
+//              Bulk_Cancel(void)
+//              Bulk_TX_Span(const char** span)         TX engine only
+//              Bulk_TX_Commit(unsigned int count)      TX engine only
+//              Bulk_Ring_Clip(unsigned int length)     TX engine only
+//              Bulk_Ring_Sent(unsigned int count)      TX engine only
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include  "functions.h"
+#include <string.h>
+
+const char* volatile bulk_tx_data = NULL;       //the rest of the payload
+volatile unsigned int bulk_tx_left = EMPTY;     //payload chars to go, EMPTY = idle
+volatile unsigned int bulk_tx_ahead = EMPTY;    //ring chars that go before the payload
+char bulk_header[BULK_HEADER_LENGTH];
+unsigned int bulk_frames_sent = COUNT_RESET;
+volatile unsigned int bulk_frames_received = COUNT_RESET;      //frames.c
+
+
+
+//==============================================================================
+//start a bulk frame to TCP client cid, returns NO if one is still going,
+//it's too long, or the header doesn't fit in the TX ring
+//data has to stay the same until Bulk_Busy() is NO
+char Bulk_Send(char cid, const char* data, unsigned int length){
+  unsigned short interrupt_state;
+  unsigned int value = length;
+  char digit;
+  if(bulk_tx_left || !length || length > BULK_MAX_LENGTH || cid == TCP_NO_CID)
+    return NO;
+  bulk_header[COUNT_RESET] = TCP_ESCAPE_CHAR;
+  bulk_header[ADJUST_1] = BULK_START_CHAR;
+  bulk_header[BULK_CID_INDEX] = cid;
+  for(digit=BULK_LENGTH_DIGITS; digit>COUNT_RESET; digit--){    //lowest digit goes last
+    bulk_header[BULK_LENGTH_INDEX + digit - ADJUST_1] = (value % MOVE_UP_A_TENS_PLACE) + MAKE_A_CHAR;
+    value /= MOVE_UP_A_TENS_PLACE;
+  }
+  if(!ring_Write_All(&UCA3_Tx_Ring, bulk_header, BULK_HEADER_LENGTH))
+    return NO;
+  interrupt_state = __get_interrupt_state();
+  __disable_interrupt();                        //the TX engine can't send while we count
+  bulk_tx_ahead = ring_Count(&UCA3_Tx_Ring);
+  bulk_tx_data = data;
+  bulk_tx_left = length;
+  __set_interrupt_state(interrupt_state);
+  bulk_frames_sent++;
+  StartTransmit_UCA3();
+  return YES;
+}
+
+//is the last payload still going out?
+char Bulk_Busy(void){
+  return (bulk_tx_left != EMPTY);
+}
+
+//the TX ring was cleared, the header went with it
+void Bulk_Cancel(void){
+  bulk_tx_left = EMPTY;
+  bulk_tx_ahead = EMPTY;
+}
+
+
+//==============================================================================
+//                      TX engine side
+//==============================================================================
+//if it's the payload's turn, where it is and how much is left, else 0
+unsigned int Bulk_TX_Span(const char** span){
+  if(!bulk_tx_left || bulk_tx_ahead)
+    return EMPTY;
+  *span = bulk_tx_data;
+  return bulk_tx_left;
+}
+
+//count payload chars went out
+void Bulk_TX_Commit(unsigned int count){
+  bulk_tx_data += count;
+  bulk_tx_left -= count;
+}
+
+//a span of the ring is about to go out, don't let it pass the payload
+unsigned int Bulk_Ring_Clip(unsigned int length){
+  if(bulk_tx_left && length > bulk_tx_ahead)
+    return bulk_tx_ahead;
+  return length;
+}
+
+//count ring chars went out
+void Bulk_Ring_Sent(unsigned int count){
+  if(bulk_tx_left)
+    bulk_tx_ahead -= count;
+}
@@ -13,6 +13,15 @@
 
 
 void Init_Clocks(void);
+unsigned long get_SMCLK_Frequency(void);
+
+//DCO frequencies for each DCOFSEL setting (datasheet), low range and high range
+const unsigned long dco_frequency_low[NUM_DCOFSEL]  = {1000000, 2670000, 3500000,
+                                                       4000000, 5330000, 7000000,
+                                                       8000000, 8000000};
+const unsigned long dco_frequency_high[NUM_DCOFSEL] = {1000000, 5330000, 7000000,
+                                                       8000000, 16000000, 21000000,
+                                                       24000000, 24000000};
 
 void Init_Clocks(void){
 //------------------------------------------------------------------------------
@@ -90,3 +99,35 @@ void Init_Clocks(void){
 }
 
 
+
+//------------------------------------------------------------------------------
+// What SMCLK is actually running at, worked out from the CS registers
+// (instead of trusting SMCLK_FREQUENCY).  The serial ports use this to
+// figure out their baud rate settings.
+// Sources without a known frequency fall back to SMCLK_FREQUENCY.
+//------------------------------------------------------------------------------
+unsigned long get_SMCLK_Frequency(void){
+  unsigned long frequency;
+  unsigned int dcofsel = (CSCTL1 & DCOFSEL) >> DCOFSEL_SHIFT;
+  switch(CSCTL2 & SELS){
+  case SELS__DCOCLK:
+    if(CSCTL1 & DCORSEL)
+      frequency = dco_frequency_high[dcofsel];
+    else
+      frequency = dco_frequency_low[dcofsel];
+    break;
+  case SELS__LFXTCLK:
+    frequency = LFXT_FREQUENCY;
+    break;
+  case SELS__VLOCLK:
+    frequency = VLO_FREQUENCY;
+    break;
+  case SELS__MODOSC:
+    frequency = MODOSC_FREQUENCY;
+    break;
+  default:
+    frequency = SMCLK_FREQUENCY;
+    break;
+  }
+  return frequency >> ((CSCTL3 & DIVS) >> DIVS_SHIFT);  //DIVS is a power of two
+}
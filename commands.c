@@ -0,0 +1,274 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      commands.c
+//
+//      the command queue - sits between parsing a command and running it
+//
+//      Execute_Command() (serial.c) checks the pin and hands the rest of the
+//      command to Queue_Command_Batch().  Command_Process() runs in the OS loop
+//      and feeds the queue to Execute_Command_FRAM() one entry at a time.
+//      A timed movement doesn't block anything anymore, so the next command
+//      just waits in the queue until the wheels stop.  Meanwhile new commands
+//      keep coming in and keep getting queued.
+//
+//      One frame can carry a whole batch, separated by ';'
+//              6824^f10;r9;f20;B
+//      the pin is checked once, then every command in the batch is queued.
+//      A batch either fits in the queue completely or isn't queued at all,
+//      so a path never gets driven with a piece missing out of the middle.
+//
+//      Some commands have to wait on something (H, U, I).  They hand a task
+//      to Start_Command_Task() and the queue holds until that task is done,
+//      the same way it holds for a movement.
+//
+//      A batch that starts with B (motors off) doesn't wait in line.  It stops
+//      the car right away and throws away everything still queued, then the
+//      rest of the batch (if any) is queued like normal.  A UDP datagram
+//      (command_takeover, see udp.c) does the same thing whatever it starts
+//      with, the newest steering command is the only one that matters.
+//
+//      Every command remembers when and how it got here (command_via and
+//      command_arrival, set by whoever calls Execute_Command), and when one
+//      starts the wheels, Stats_Latency gets how long that took (Q1).
+//
+//      Binary commands ------------------------------------------------------
+//      A TCP frame whose first byte is BINARY_COMMAND_MARKER is a binary
+//      command instead of text.  Every field is a fixed size, so there is no
+//      number parsing, and a CRC covers the whole thing, so a garbled byte
+//      gets the frame thrown out instead of turning f1 into f9.
+//
+//              byte 0          BINARY_COMMAND_MARKER
+//              byte 1          sequence number
+//              byte 2          opcode (the same letter as the text command)
+//              byte 3-4        argument        (low byte first)
+//              byte 5-6        pin             (low byte first)
+//              byte 7-8        CRC-16/CCITT of bytes 0-6 (low byte first)
+//                              (poly 0x1021, starts at 0xFFFF)
+//
+//      Any of those bytes can be 0x1B (<ESC>), and <ESC>E in the middle
+//      would end the frame early.  So the sender stuffs the 9 bytes before
+//      they go out:  every 0x1B is sent twice, and frames.c turns <ESC><ESC>
+//      back into one before we see it.  Nothing else is escaped, and the
+//      CRC covers the bytes before stuffing.
+//
+//      A frame with the same sequence number as the last one from that
+//      TCP client (session.c) is a resend, it's dropped instead of being
+//      run twice.
+//      Text commands still work exactly the same, it's picked frame by frame.
+//
+//      global functions
+//              Queue_Command_Batch(char* batch, char source, char cid)
+//              Execute_Binary_Command(char* frame, unsigned int length, char cid)
+//              CRC16(char* data, unsigned int length)
+//              Command_Process(void)
+//              clear_Command_Queue(void)
+//              Start_Command_Task(char (*task)(void))
+//
+//      local functions
+//              Parse_Command(char** next, Command* command)
+//              command_Queue_Space(void)
+//              Queue_Command(Command* command)
+//
+//==============================================================================
+#include "macros.h"
+#include  "functions.h"
+#include <string.h>
+
+char Parse_Command(char** next, Command* command);
+unsigned int command_Queue_Space(void);
+void Queue_Command(Command* command);
+
+Command command_queue[COMMAND_QUEUE_SIZE];      //the queue itself
+unsigned int command_queue_wr = COUNT_RESET;    //free running, masked when used
+unsigned int command_queue_rd = COUNT_RESET;    //(same idea as ring.c)
+unsigned int commands_queued   = COUNT_RESET;
+unsigned int commands_rejected = COUNT_RESET;   //batches that didn't fit
+char (*command_task)(void) = NULL;              //the task the queue is waiting on
+char command_source = COMMAND_SOURCE_PC;        //who sent the command that's running
+char command_cid = TCP_NO_CID;                  //and which TCP client, if it was one
+char command_via = VIA_PC;                      //the next command to be queued came
+unsigned long command_arrival = COUNT_RESET;    //this way, at this Timer_Now()
+char command_takeover = NO;                     //YES - drop everything for it (UDP)
+
+unsigned int binary_crc_errors = COUNT_RESET;   //binary commands thrown out
+unsigned int binary_duplicates = COUNT_RESET;
+
+
+
+//==============================================================================
+//pull one command off the front of *next and move *next past it
+//a command is a letter followed by an optional number, ended by ';' or the end
+//returns NO when there are no more commands in the string
+char Parse_Command(char** next, Command* command){
+  char* c = *next;
+  while(*c == COMMAND_SEPARATOR)        //skip empty commands (;;)
+    c++;
+  if(*c == EMPTY || *c == RETURN_CHAR || *c == NEW_LINE_CHAR)
+    return NO;                          //end of the batch
+  command->letter = *c;
+  command->argument = EMPTY;
+  c++;
+  while(*c >= '0' && *c <= '9'){        //the number, if there is one
+    command->argument *= MOVE_UP_A_TENS_PLACE;
+    command->argument += (*c - MAKE_A_CHAR);
+    c++;
+  }
+  while(*c != COMMAND_SEPARATOR && *c != EMPTY) //ignore anything else in this one
+    c++;
+  *next = c;
+  return YES;
+}
+
+unsigned int command_Queue_Space(void){
+  return COMMAND_QUEUE_SIZE - (unsigned int)(command_queue_wr - command_queue_rd);
+}
+
+//queue every command in the batch, or none of them if they don't all fit
+//returns YES if the batch was queued
+char Queue_Command_Batch(char* batch, char source, char cid){
+  Command command;
+  char* next = batch;
+  unsigned int count = COUNT_RESET;
+  if(Parse_Command(&next, &command) && command.letter == 'B'){
+    clear_Command_Queue();                      //stop, right now
+    Motion_Stop();
+    batch = next;                               //B itself is done
+  }
+  else if(command_takeover){                    //whatever was going on is stale
+    clear_Command_Queue();
+    Motion_Stop();
+  }
+  next = batch;
+  while(Parse_Command(&next, &command))         //first pass - how many?
+    count++;
+  if(count > command_Queue_Space()){
+    commands_rejected++;
+    return NO;
+  }
+  next = batch;
+  while(Parse_Command(&next, &command)){        //second pass - queue them
+    command.source = source;
+    command.cid = cid;
+    command.via = command_via;
+    command.arrival = command_arrival;
+    Queue_Command(&command);
+  }
+  return YES;
+}
+
+//check for room first, this doesn't
+void Queue_Command(Command* command){
+  command_queue[command_queue_wr & COMMAND_QUEUE_MASK] = *command;
+  command_queue_wr++;
+  commands_queued++;
+}
+
+
+//==============================================================================
+//                      Binary Commands
+//==============================================================================
+//check a binary command frame and queue it, returns YES if it was queued
+//binary commands only come in TCP frames, cid says which client
+char Execute_Binary_Command(char* frame, unsigned int length, char cid){
+  Command command;
+  Session* session = Find_Session(cid);
+  unsigned int crc;
+  unsigned char seq;
+  if(length != BINARY_FRAME_LENGTH){
+    binary_crc_errors++;                        //lost or gained a byte somewhere
+    return NO;
+  }
+  crc  = (unsigned char)frame[BINARY_CRC_INDEX];
+  crc |= (unsigned char)frame[BINARY_CRC_INDEX + ADJUST_1] << REMOVE_LOWER_8BITS;
+  if(crc != CRC16(frame, BINARY_CRC_INDEX)){
+    binary_crc_errors++;
+    return NO;
+  }
+  if(((unsigned char)frame[BINARY_PIN_INDEX] |
+      ((unsigned char)frame[BINARY_PIN_INDEX + ADJUST_1] << REMOVE_LOWER_8BITS)) != COMMAND_PIN){
+    Stats_Bad_Pin(STATS_UCA3);
+    return NO;
+  }
+  seq = (unsigned char)frame[BINARY_SEQ_INDEX];
+  if(session && session->binary_seen && seq == session->binary_last_seq){
+    binary_duplicates++;                        //we already ran this one
+    return NO;
+  }
+
+  command.letter = frame[BINARY_OPCODE_INDEX];
+  command.argument  = (unsigned char)frame[BINARY_ARGUMENT_INDEX];
+  command.argument |= (unsigned char)frame[BINARY_ARGUMENT_INDEX + ADJUST_1] << REMOVE_LOWER_8BITS;
+  command.source = COMMAND_SOURCE_TCP;
+  command.cid = cid;
+  command.via = command_via;
+  command.arrival = command_arrival;
+  if(command.letter == 'B'){                    //stop, right now
+    clear_Command_Queue();
+    Motion_Stop();
+  }
+  if(!command_Queue_Space()){
+    commands_rejected++;                        //not seen, so a resend gets its chance
+    return NO;
+  }
+  Queue_Command(&command);
+  if(session){                                  //only once it's really queued
+    session->binary_seen = YES;
+    session->binary_last_seq = seq;
+  }
+  return YES;
+}
+
+//CRC-16/CCITT, a bit at a time (the frames are tiny)
+unsigned int CRC16(char* data, unsigned int length){
+  unsigned int crc = CRC16_INIT;
+  unsigned int i;
+  char bit;
+  for(i=COUNT_RESET; i<length; i++){
+    crc ^= (unsigned int)((unsigned char)data[i]) << REMOVE_LOWER_8BITS;
+    for(bit=COUNT_RESET; bit<BITS_PER_BYTE; bit++){
+      if(crc & CRC16_TOP_BIT)
+        crc = (crc << ADJUST_1) ^ CRC16_POLY;
+      else
+        crc <<= ADJUST_1;
+    }
+  }
+  return crc;
+}
+
+//the running command isn't done until this task is (see timerMacros.h)
+void Start_Command_Task(char (*task)(void)){
+  command_task = task;
+}
+
+//forget everything that hasn't started yet
+void clear_Command_Queue(void){
+  command_queue_rd = command_queue_wr;
+}
+
+
+//==============================================================================
+//runs in the OS loop
+//the next command only starts once the last movement is finished
+void Command_Process(void){
+  Command command;
+  if(Motion_Busy())                             //still driving
+    return;
+  if(command_task){                             //still waiting on something
+    if(command_task() == TASK_WAITING)
+      return;
+    command_task = NULL;
+  }
+  if(command_queue_rd == command_queue_wr)      //nothing to do
+    return;
+  command = command_queue[command_queue_rd & COMMAND_QUEUE_MASK];
+  command_queue_rd++;                           //the slot can be reused now
+  command_source = command.source;              //so a reply knows where to go
+  command_cid = command.cid;
+  Execute_Command_FRAM(command.letter, command.argument);
+  if(Motion_Busy())                             //it just started the wheels
+    Stats_Latency(command.via, command.arrival);
+  if(command_task)                              //get it going right away
+    if(command_task() == TASK_DONE)
+      command_task = NULL;
+}
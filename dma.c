@@ -0,0 +1,169 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      dma.c
+//
+//      DMA-driven transmit for UCA0 and UCA3, and ADC capture
+//
+//      Instead of taking one TX interrupt per char, the DMA moves a whole
+//      contiguous chunk of the TX ring straight into UCAxTXBUF.  Every time
+//      UCTXIFG goes high the DMA writes the next char, and the CPU only hears
+//      about it once the chunk is done (interrupts_DMA.c).  If the ring wrapped,
+//      the rest of it goes out as the next chunk.
+//
+//      DMA channel 0 - UCA0 TX         trigger 15 = UCA0TXIFG (channels 0-2)
+//      DMA channel 1 - ADC12 results   trigger 26 = ADC12 end of sequence
+//      DMA channel 3 - UCA3 TX         trigger 17 = UCA3TXIFG (channels 3-5)
+//
+//      The DMA only sees the rising edge of UCTXIFG.  If the port is idle the
+//      flag is already high, so we pulse it to get the first char moving.
+//      If a char is still in TXBUF the edge comes on its own.
+//
+//      A bulk payload (bulk.c) goes out of the caller's buffer as its own
+//      chunk, once the ring chars queued ahead of it are gone.
+//
+//      ADC capture - at the end of every sequence channel 1 copies all of
+//      ADC12MEM8-MEM23 into one of two block buffers in one go.  The DMA
+//      interrupt points it at the other buffer and hands the full one to
+//      ADC_Block (ADC.c).  The next sequence takes longer than that, so no
+//      trigger is missed unless an ISR holds everything up for a whole
+//      sequence; then the ADC just overwrites MEMx and that block is lost.
+//
+//      Set UCAx_use_DMA to NO to fall back to the one-interrupt-per-char ISR
+//      in interrupts_serial.c.  Only change it while the port is idle.
+//
+//      global functions
+//              Init_DMA(void)
+//              DMA_Transmit_UCA0(void)
+//              DMA_Transmit_UCA3(void)
+//              DMA_Stop_UCA0(void)
+//              DMA_Stop_UCA3(void)
+//              Init_DMA_ADC(void)
+//              DMA_ADC_Swap(void)              DMA ISR only
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include  "functions.h"
+
+char UCA0_use_DMA = UCA0_TX_DMA;                //which TX engine each port uses
+char UCA3_use_DMA = UCA3_TX_DMA;
+volatile unsigned int UCA0_dma_length = EMPTY;  //size of the chunk in flight, EMPTY = idle
+volatile unsigned int UCA3_dma_length = EMPTY;
+volatile char UCA3_dma_bulk = NO;               //the chunk in flight is a bulk payload
+unsigned int adc_block[ADC_NUM_BLOCKS][ADC_BLOCK_LENGTH];       //ping-pong
+unsigned char adc_dma_block = COUNT_RESET;            //the one channel 1 is filling
+
+
+void Init_DMA(void){
+  DMACTL4 = DMARMWDIS;          //don't let a DMA transfer split a read-modify-write
+
+  //UCA0 TX - single transfers, byte to byte, source walks the ring, dest is TXBUF
+  DMA0CTL = RESET_STATE;
+  DMACTL0 &= ~DMA0TSEL;
+  DMACTL0 |= DMA_TRIGGER_UCA0TX;
+  DMA0CTL |= DMADT_0;           //single transfer, DMAEN clears itself when done
+  DMA0CTL |= DMASRCINCR_3;      //source address increments
+  DMA0CTL |= DMADSTINCR_0;      //destination stays on TXBUF
+  DMA0CTL |= DMASRCBYTE;
+  DMA0CTL |= DMADSTBYTE;
+  DMA0CTL |= DMAIE;             //tell us when the chunk is done
+  __data16_write_addr((unsigned short)&DMA0DA, (unsigned long)&UCA0TXBUF);
+
+  //UCA3 TX - same thing on channel 3
+  DMA3CTL = RESET_STATE;
+  DMACTL1 &= ~DMA3TSEL;
+  DMACTL1 |= (DMA_TRIGGER_UCA3TX << DMA_TSEL_ODD_SHIFT);
+  DMA3CTL |= DMADT_0;
+  DMA3CTL |= DMASRCINCR_3;
+  DMA3CTL |= DMADSTINCR_0;
+  DMA3CTL |= DMASRCBYTE;
+  DMA3CTL |= DMADSTBYTE;
+  DMA3CTL |= DMAIE;
+  __data16_write_addr((unsigned short)&DMA3DA, (unsigned long)&UCA3TXBUF);
+
+  UCA0_dma_length = EMPTY;
+  UCA3_dma_length = EMPTY;
+}
+
+
+//==============================================================================
+//start the next chunk if the channel is idle and the ring has something
+//call with interrupts off (StartTransmit does this) or from an ISR
+void DMA_Transmit_UCA0(void){
+  volatile char* span;
+  unsigned int length;
+  if(UCA0_dma_length)   return;         //a chunk is already moving
+  if(!PC_TX_Enable)     return;         //the PC hasn't talked to us yet
+  length = ring_Read_Span(&UCA0_Tx_Ring, &span);
+  if(!length)           return;         //nothing to send
+  UCA0_dma_length = length;
+  __data16_write_addr((unsigned short)&DMA0SA, (unsigned long)span);
+  DMA0SZ = length;
+  DMA0CTL |= DMAEN;
+  if(UCA0IFG & UCTXIFG){                //idle port, no edge is coming
+    UCA0IFG &= ~UCTXIFG;                //so make one
+    UCA0IFG |= UCTXIFG;
+  }
+}
+
+void DMA_Transmit_UCA3(void){
+  volatile char* span;
+  const char* bulk_span;
+  unsigned int length;
+  if(UCA3_dma_length)   return;
+  length = Bulk_TX_Span(&bulk_span);    //the bulk payload's turn?
+  UCA3_dma_bulk = (length != EMPTY);
+  if(UCA3_dma_bulk)
+    span = (volatile char*)bulk_span;
+  else
+    length = Bulk_Ring_Clip(ring_Read_Span(&UCA3_Tx_Ring, &span));
+  if(!length)           return;
+  UCA3_dma_length = length;
+  __data16_write_addr((unsigned short)&DMA3SA, (unsigned long)span);
+  DMA3SZ = length;
+  DMA3CTL |= DMAEN;
+  if(UCA3IFG & UCTXIFG){
+    UCA3IFG &= ~UCTXIFG;
+    UCA3IFG |= UCTXIFG;
+  }
+}
+
+//abandon whatever chunk is in flight (the ring is about to be cleared)
+void DMA_Stop_UCA0(void){
+  DMA0CTL &= ~DMAEN;
+  UCA0_dma_length = EMPTY;
+}
+
+void DMA_Stop_UCA3(void){
+  DMA3CTL &= ~DMAEN;
+  UCA3_dma_length = EMPTY;
+}
+
+
+//==============================================================================
+//ADC capture on channel 1, Init_ADC calls this before it starts converting
+void Init_DMA_ADC(void){
+  DMA1CTL = RESET_STATE;
+  DMACTL0 &= ~DMA1TSEL;
+  DMACTL0 |= (DMA_TRIGGER_ADC12 << DMA_TSEL_ODD_SHIFT);
+  DMA1CTL |= DMADT_1;           //block transfer, the whole sequence per trigger
+  DMA1CTL |= DMASRCINCR_3;      //source walks MEM8 on up
+  DMA1CTL |= DMADSTINCR_3;      //destination walks the block
+  DMA1CTL |= DMAIE;             //tell us when a block is in
+  __data16_write_addr((unsigned short)&DMA1SA, (unsigned long)&ADC12MEM8);
+  adc_dma_block = COUNT_RESET;
+  __data16_write_addr((unsigned short)&DMA1DA, (unsigned long)adc_block[adc_dma_block]);
+  DMA1SZ = ADC_BLOCK_LENGTH;
+  DMA1CTL |= DMAEN;
+}
+
+//a block is in (DMAEN cleared itself), start on the other one
+//returns the full one
+const unsigned int* DMA_ADC_Swap(void){
+  const unsigned int* full = adc_block[adc_dma_block];
+  adc_dma_block ^= ADJUST_1;
+  __data16_write_addr((unsigned short)&DMA1DA, (unsigned long)adc_block[adc_dma_block]);
+  DMA1CTL |= DMAEN;             //SA and SZ come back on their own
+  return full;
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      filter.c
+//
+//      small integer filters for the ADC channels, cheap enough for the ISR
+//      (no floats, no division - windows are powers of two, so it's shifts)
+//
+//      Every sample goes in with Filter_Sample().  The filter runs on every
+//      one, and every decimate'th result comes out (Filter_Sample returns
+//      YES and it's in filter->output).  Oversampling is a boxcar as long as
+//      the decimation:  average 4, keep 1 out of 4.
+//
+//      FILTER_NONE     the sample, as is
+//      FILTER_BOXCAR   average of the last 2^size samples (a running sum)
+//                      noise / sqrt(2^size), (2^size - 1)/2 samples late
+//      FILTER_EMA      out += (in - out) / 2^size
+//                      about the same noise as a boxcar of 2^(size+1) - 1,
+//                      but it takes about 2^size samples to get most of the
+//                      way to a step - smooth, and no history to keep
+//      FILTER_MEDIAN   middle of the last size samples (3 or 5)
+//                      throws out spikes completely, (size - 1)/2 samples late
+//
+//      Until the window has filled up, boxcar and median just pass the
+//      samples through (no ramp up from 0 at power up).
+//
+//      global functions
+//              Init_Filter(Filter* f, char type, char size, char decimate)
+//              Filter_Sample(Filter* f, int sample)            ISR safe
+//
+//      local functions
+//              Filter_Median(Filter* f)
+//
+//==============================================================================
+#include "macros.h"
+#include  "functions.h"
+
+int Filter_Median(Filter* f);
+
+
+
+//==============================================================================
+//set it up and forget the history
+//size is the shift for boxcar/EMA, the window for median (see the top)
+//call with the ISR that feeds it held off
+void Init_Filter(Filter* f, char type, char size, char decimate){
+  f->type = type;
+  f->size = size;
+  switch(type){                                 //keep size in range
+  case FILTER_BOXCAR:
+    if(f->size > FILTER_BOXCAR_MAX_SHIFT)
+      f->size = FILTER_BOXCAR_MAX_SHIFT;
+    break;
+  case FILTER_EMA:
+    if(f->size > FILTER_EMA_MAX_SHIFT)
+      f->size = FILTER_EMA_MAX_SHIFT;
+    break;
+  case FILTER_MEDIAN:
+    if(f->size > FILTER_MEDIAN_MAX)
+      f->size = FILTER_MEDIAN_MAX;
+    f->size |= ADJUST_1;                        //odd, so there is a middle
+    break;
+  default:
+    f->type = FILTER_NONE;
+    break;
+  }
+  f->decimate = decimate ? decimate : ADJUST_1;
+  f->index = COUNT_RESET;
+  f->filled = COUNT_RESET;
+  f->sum = COUNT_RESET;
+  f->skip = COUNT_RESET;
+}
+
+//one new sample, returns YES if f->output is new
+char Filter_Sample(Filter* f, int sample){
+  int result = sample;
+  unsigned char window;
+  switch(f->type){
+  case FILTER_BOXCAR:
+    window = ADJUST_1 << f->size;
+    if(f->filled < window){                     //nothing to drop out yet
+      f->sum += sample;
+      f->filled++;
+    }
+    else{
+      f->sum += sample - f->history[f->index];  //the oldest one drops out
+      result = (int)(f->sum >> f->size);
+    }
+    f->history[f->index] = sample;
+    f->index = (f->index + ADJUST_1) & (window - ADJUST_1);
+    break;
+  case FILTER_EMA:
+    if(!f->filled){                             //start where the signal is
+      f->sum = (long)sample << f->size;
+      f->filled = YES;
+    }
+    f->sum += sample - (int)(f->sum >> f->size);
+    result = (int)(f->sum >> f->size);
+    break;
+  case FILTER_MEDIAN:
+    f->history[f->index] = sample;
+    f->index++;
+    if(f->index >= f->size)
+      f->index = COUNT_RESET;
+    if(f->filled < f->size)
+      f->filled++;
+    else
+      result = Filter_Median(f);
+    break;
+  default:
+    break;
+  }
+  f->skip++;
+  if(f->skip < f->decimate)                     //not this one
+    return NO;
+  f->skip = COUNT_RESET;
+  f->output = result;
+  return YES;
+}
+
+//sort a copy of the window (5 at most), take the middle
+int Filter_Median(Filter* f){
+  int sorted[FILTER_MEDIAN_MAX];
+  int value;
+  unsigned char i;
+  unsigned char j;
+  for(i=COUNT_RESET; i<f->size; i++){           //insertion sort as they're copied
+    value = f->history[i];
+    for(j=i; j>COUNT_RESET && sorted[j - ADJUST_1] > value; j--)
+      sorted[j] = sorted[j - ADJUST_1];
+    sorted[j] = value;
+  }
+  return sorted[f->size >> ADJUST_1];
+}
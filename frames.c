@@ -0,0 +1,241 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      frames.c
+//
+//      TCP frame delimiting for the IOT module (UCA3)
+//
+//      When we connect to the port via TCP, every command we send is framed
+//      by the IOT module like this:
+//                              <ESC>S<n>COMMAND<ESC>E
+//      where <n> is the connection ID.
+//
+//      The USCI_A3_ISR hands every received char to Frame_RX_Char(), which
+//      runs the framing state machine right there in the ISR:
+//              chars outside of a frame        -> UCA3 RX ring (AT responses, etc.)
+//              chars inside of a frame         -> straight into a frame slot
+//      <n> is kept in the slot's cid instead of in the payload, so nothing
+//      has to be shifted later.  As soon as <ESC>E shows up the slot is handed
+//      to the main loop, already NUL terminated and ready to execute.
+//
+//      The slots work like a little ring: the ISR fills frame_slot[frame_wr],
+//      the main loop reads frame_slot[frame_rd].  If every slot is full, or a
+//      frame is longer than FRAME_MAX_LENGTH, the frame is thrown away and
+//      counted in frames_rejected.
+//
+//      An <ESC> inside a frame that isn't followed by E (or S, u, Z) is kept
+//      as data.  A sender that can have <ESC> in its data (binary commands,
+//      see commands.c) stuffs it:  every <ESC> goes out as <ESC><ESC> and
+//      comes back out of here as one, so no data byte can end a frame.
+//
+//      UDP datagrams (udp.c) come framed almost the same way:
+//                              <ESC>u<n><ip> <port><tab>DATA<ESC>E
+//      the address is skipped, the slot is marked udp, and the rest is the
+//      same as a TCP frame.  Bulk frames (bulk.c) have a length instead of
+//      an end marker:
+//                              <ESC>Z<n><llll>DATA
+//      exactly llll chars are taken as data, <ESC> and all.  A bulk frame
+//      too long for a slot is read to the end and thrown away.  Every
+//      frame is stamped with Timer_Now() when it's finished, for the
+//      latency numbers (Q1).
+//
+//      global functions
+//              Frame_RX_Char(char)             called from USCI_A3_ISR only
+//              get_Frame(void)                 main loop only
+//              release_Frame(void)             main loop only
+//              clear_Frames(void)
+//
+//      local functions
+//              Frame_Begin(char)
+//              Frame_Store(char)
+//              Frame_Finish(void)
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include <string.h>
+
+void Frame_Begin(char cid);
+void Frame_Store(char c);
+void Frame_Finish(void);
+
+Frame frame_slot[NUM_FRAME_SLOTS];              //the frame pool
+volatile unsigned int frame_wr = COUNT_RESET;   //free running, ISR only
+volatile unsigned int frame_rd = COUNT_RESET;   //free running, main loop only
+volatile unsigned int frames_parsed   = COUNT_RESET;
+volatile unsigned int frames_rejected = COUNT_RESET;
+
+char frame_state = FRAME_LOOK_FOR_START;        //ISR state machine
+char frame_udp = NO;                            //the frame being read is a datagram
+char frame_bulk = NO;                           //or a bulk frame
+unsigned int frame_bulk_left = COUNT_RESET;     //bulk chars still to come
+char frame_bulk_digits = COUNT_RESET;           //length digits read so far
+Frame* frame_filling = NULL;                    //slot being written, NULL = throwing it away
+
+
+
+//==============================================================================
+//                      ISR side
+//==============================================================================
+void Frame_RX_Char(char c){
+  switch(frame_state){
+  case FRAME_LOOK_FOR_START:            //not in a frame
+    if(c == TCP_ESCAPE_CHAR)
+      frame_state = FRAME_START_ESCAPE;
+    else
+      put_Ring_Char(&UCA3_Rx_Ring, c);  //regular chatter from the module
+    break;
+
+  case FRAME_START_ESCAPE:              //<ESC> outside of a frame
+    if(c == TCP_START_CHAR || c == UDP_START_CHAR || c == BULK_START_CHAR){
+      frame_udp = (c == UDP_START_CHAR);
+      frame_bulk = (c == BULK_START_CHAR);
+      frame_state = FRAME_GET_CID;
+    }
+    else{                               //wasn't a frame after all
+      put_Ring_Char(&UCA3_Rx_Ring, TCP_ESCAPE_CHAR);
+      put_Ring_Char(&UCA3_Rx_Ring, c);
+      frame_state = FRAME_LOOK_FOR_START;
+    }
+    break;
+
+  case FRAME_GET_CID:                   //<n> comes right after <ESC>S
+    Frame_Begin(c);
+    frame_state = frame_udp ? FRAME_SKIP_ADDRESS : FRAME_STORE;
+    if(frame_bulk){
+      frame_bulk_left = COUNT_RESET;
+      frame_bulk_digits = COUNT_RESET;
+      frame_state = FRAME_BULK_LENGTH;
+    }
+    break;
+
+  case FRAME_BULK_LENGTH:               //<llll>, in decimal
+    if(c < '0' || c > '9'){             //lost track, drop it
+      if(frame_filling)
+        frames_rejected++;
+      frame_filling = NULL;
+      frame_state = FRAME_LOOK_FOR_START;
+      break;
+    }
+    frame_bulk_left *= MOVE_UP_A_TENS_PLACE;
+    frame_bulk_left += (c - MAKE_A_CHAR);
+    frame_bulk_digits++;
+    if(frame_bulk_digits < BULK_LENGTH_DIGITS)
+      break;
+    frame_state = FRAME_BULK_DATA;
+    if(frame_bulk_left)
+      break;
+    Frame_Finish();                     //nothing in it
+    frame_state = FRAME_LOOK_FOR_START;
+    break;
+
+  case FRAME_BULK_DATA:                 //no escapes, just count
+    Frame_Store(c);
+    frame_bulk_left--;
+    if(frame_bulk_left)
+      break;
+    if(frame_filling)
+      bulk_frames_received++;
+    Frame_Finish();
+    frame_state = FRAME_LOOK_FOR_START;
+    break;
+
+  case FRAME_SKIP_ADDRESS:              //<ip> <port><tab>, who sent it
+    if(c == UDP_ADDRESS_END_CHAR)
+      frame_state = FRAME_STORE;
+    else if(c == TCP_ESCAPE_CHAR)       //no data at all
+      frame_state = FRAME_END_ESCAPE;
+    break;
+
+  case FRAME_STORE:                     //the payload
+    if(c == TCP_ESCAPE_CHAR)
+      frame_state = FRAME_END_ESCAPE;
+    else
+      Frame_Store(c);
+    break;
+
+  case FRAME_END_ESCAPE:                //<ESC> inside of a frame
+    if(c == TCP_END_CHAR){              //<ESC>E, the frame is done
+      Frame_Finish();
+      frame_state = FRAME_LOOK_FOR_START;
+    }
+    else if(c == TCP_START_CHAR || c == UDP_START_CHAR || c == BULK_START_CHAR){      //the last frame never ended
+      if(frame_filling)
+        frames_rejected++;
+      frame_udp = (c == UDP_START_CHAR);
+      frame_bulk = (c == BULK_START_CHAR);
+      frame_state = FRAME_GET_CID;
+    }
+    else if(c == TCP_ESCAPE_CHAR){      //<ESC><ESC>, one stuffed <ESC> in the data
+      Frame_Store(TCP_ESCAPE_CHAR);
+      frame_state = FRAME_STORE;
+    }
+    else{                               //just an <ESC> in the data
+      Frame_Store(TCP_ESCAPE_CHAR);
+      Frame_Store(c);
+      frame_state = FRAME_STORE;
+    }
+    break;
+
+  default:
+    frame_state = FRAME_LOOK_FOR_START;
+    break;
+  }
+}
+
+//grab a free slot, or plan on throwing the frame away if there isn't one
+void Frame_Begin(char cid){
+  if((unsigned int)(frame_wr - frame_rd) >= NUM_FRAME_SLOTS){
+    frame_filling = NULL;               //main loop hasn't caught up
+    frames_rejected++;
+    return;
+  }
+  frame_filling = &frame_slot[frame_wr & FRAME_SLOT_MASK];
+  frame_filling->cid = cid;
+  frame_filling->udp = frame_udp;
+  frame_filling->length = COUNT_RESET;
+}
+
+//keep one spot for the terminating NUL
+void Frame_Store(char c){
+  if(!frame_filling)    return;
+  if(frame_filling->length >= (FRAME_MAX_LENGTH - NEXT_TO_LAST)){
+    frame_filling = NULL;               //too long, throw it away
+    frames_rejected++;
+    return;
+  }
+  frame_filling->data[frame_filling->length] = c;
+  frame_filling->length++;
+}
+
+//terminate the payload and hand the slot to the main loop
+void Frame_Finish(void){
+  if(!frame_filling)    return;
+  frame_filling->data[frame_filling->length] = EMPTY;
+  frame_filling->arrival = Timer_Now();
+  frame_filling = NULL;
+  frames_parsed++;
+  frame_wr++;                           //publish after the slot is complete
+}
+
+
+
+//==============================================================================
+//                      main loop side
+//==============================================================================
+//the oldest complete frame, or NULL if there isn't one
+Frame* get_Frame(void){
+  if(frame_rd == frame_wr)
+    return NULL;
+  return &frame_slot[frame_rd & FRAME_SLOT_MASK];
+}
+
+//done with the frame from get_Frame(), the ISR can have the slot back
+void release_Frame(void){
+  frame_rd++;
+}
+
+//throw away every complete frame
+void clear_Frames(void){
+  frame_rd = frame_wr;
+}
@@ -38,6 +38,7 @@ void Init_Conditions(void){
   Init_LCD();           // Initialize LCD
   Init_ADC();           // Initialize ADC - IR detectors and wheel
   Init_Serial();        // Initialize Serial Communications
+  Init_DMA();           // Initialize DMA - serial transmit
   
   //Initial LCD Contents
   strcpy(display_line[DISPLAY_LINE_2], "ChrisHamby");
@@ -48,6 +49,7 @@ void Init_Conditions(void){
   P3OUT &= ~IOT_RESET;            //reset the IOT module
   delay_100ms(TWOHUNDRED_MS);     
   P3OUT |= IOT_RESET;  
+  Start_Link_Speed(LINK_FASTEST, LINK_SLOWEST_FAST);    //speed up the IOT link (iot.c)
   //The character emoji on the LCD (just for fun)
   strcpy(shrug_guy, SHRUG_MAN);
   shrug_guy[SHRUG_LHAND]    = SHRUG_HAND;  //the word shrug looks pretty weird 
@@ -14,6 +14,9 @@
 //      be reimplemented in the future.  Or, enable/disable the ADC ISR as needed.  
 //      Optimization follows function.  
 //
+//      No ADC interrupts are enabled anymore.  DMA channel 1 picks up every
+//      sequence and the DMA interrupt does the work (see ADC.c and dma.c).
+//
 //==============================================================================
 #include "msp430.h"
 #include "macros.h"
@@ -30,11 +33,7 @@ __interrupt void ADC12_ISR(void) {
   case ADC12IV__ADC12INIFG:     break;  //Vector 10: ADC12BIN
   case ADC12IV__ADC12IFG0:      break;  //Vector 12: ADC12MEM0
   case ADC12IV__ADC12IFG1:      break;  //Vector 14: ADC12MEM1
-  case ADC12IV__ADC12IFG2:              //Vector 16: ADC12MEM2
-    ADC_Thumb           = ADC12MEM0;
-    ADC_Right_Detector  = ADC12MEM2;
-    ADC_Left_Detector   = ADC12MEM1;
-    break;
+  case ADC12IV__ADC12IFG2:      break;  //Vector 16: ADC12MEM2
   case ADC12IV__ADC12IFG3:      break;  //Vector 18: ADC12MEM3
   case ADC12IV__ADC12IFG4:      break;  //Vector 20: ADC12MEM4
   case ADC12IV__ADC12IFG5:      break;  //Vector 22: ADC12MEM5
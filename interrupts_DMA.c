@@ -0,0 +1,50 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      interrupts_DMA.c
+//
+//      the DMA raises an interrupt when a channel finishes its block
+//
+//      channel 0 - UCA0 TX chunk is out of the ring and into the UART
+//      channel 1 - a block of ADC results is in, filter and publish it
+//      channel 3 - UCA3 TX chunk, same deal
+//
+//      The chars are handed back to the TX ring and, if more were queued
+//      while the chunk was moving, the next chunk starts right away
+//      (a UCA3 chunk can also be a bulk payload, that goes back to bulk.c)
+//
+//==============================================================================
+#include "msp430.h"
+#include "macros.h"
+#include "functions.h"
+
+#pragma vector = DMA_VECTOR
+__interrupt void DMA_ISR(void) {
+  switch (__even_in_range(DMAIV, DMAIV__DMA5IFG)){
+  case DMAIV__NONE:     break;          //Vector 0:  No interrupt
+  case DMAIV__DMA0IFG:                  //Vector 2:  DMA channel 0 - UCA0 TX
+    ring_Read_Commit(&UCA0_Tx_Ring, UCA0_dma_length);
+    Stats_TX(STATS_UCA0, UCA0_dma_length);
+    UCA0_dma_length = EMPTY;
+    DMA_Transmit_UCA0();                //keep going if there is more
+    break;
+  case DMAIV__DMA1IFG:                  //Vector 4:  DMA channel 1 - ADC block
+    ADC_Block(DMA_ADC_Swap());          //swap first, the next sequence is going
+    break;
+  case DMAIV__DMA2IFG:  break;          //Vector 6:  DMA channel 2
+  case DMAIV__DMA3IFG:                  //Vector 8:  DMA channel 3 - UCA3 TX
+    if(UCA3_dma_bulk)
+      Bulk_TX_Commit(UCA3_dma_length);
+    else{
+      ring_Read_Commit(&UCA3_Tx_Ring, UCA3_dma_length);
+      Bulk_Ring_Sent(UCA3_dma_length);
+    }
+    Stats_TX(STATS_UCA3, UCA3_dma_length);
+    UCA3_dma_length = EMPTY;
+    DMA_Transmit_UCA3();
+    break;
+  case DMAIV__DMA4IFG:  break;          //Vector 10: DMA channel 4
+  case DMAIV__DMA5IFG:  break;          //Vector 12: DMA channel 5
+  default: break;
+  }
+}
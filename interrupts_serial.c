@@ -15,17 +15,28 @@
 //
 //      What happens in an ISR here?
 //      If the receive interrupt receives a char:
-//      it is written to the appropriate ring buffer
-//      An index counter ensures the char is written in the correct position
-//      All RX chars are also echoed directly to the UCA0TXBUF
-//      Meaning that, if putty is open, we can see the received chars
-//      They skip the ring buffer, so we don't have to worry about indexing issues
+//      it is written to the appropriate ring buffer (see ring.c)
+//      If the ring is full the char is dropped, unread chars are never overwritten
+//      UCA3 chars go through the TCP frame state machine first (frames.c)
+//      so complete command frames never touch the ring at all
+//      Every char in and out is counted, along with UART errors (stats.c)
+//      RX chars are also handed to the debug tap (mirror.c), which copies
+//      them to the terminal through the UCA0 TX ring, if there's room
+//      (they used to go straight into UCA0TXBUF, on top of whatever was sending)
 
 //      If the transmit interrupt is enabled:
 //      All chars in the TX ring buffer are transmitted
-//      A counter ensures we don't transmit too many chars
-//      Note that setting TXBUF to EMPTY still transmits a NULL char, this is bad
+//      The ring knows how many chars are left, so no separate counter is needed
 //      Afterwards, the transmit interrupt is disabled again
+//      If we go idle without writing TXBUF, UCTXIFG is set again by hand
+//      (reading UCAxIV cleared it) so StartTransmit only has to enable the interrupt
+//
+//      In bridge mode (bridge.c) RX chars skip all of that and go straight
+//      into the other port's TX ring
+//
+//      When a port uses DMA (dma.c) the TX interrupt stays off, and the ring
+//      is emptied by the DMA instead - see interrupts_DMA.c
+//      A bulk payload (bulk.c) is sent from its own buffer when its turn comes
 //==============================================================================
 #include "macros.h"
 #include  "msp430.h"
@@ -33,48 +44,48 @@
 #include <string.h>
 
 char ISR_tempChar;
+char ISR_inFrame;       //was ISR_tempChar part of a TCP frame?
+const char* ISR_bulkSpan;       //where the bulk payload is (bulk.c)
 //============================================================================
 //      UCA0 Serial Interrupt Vector - PC
 //============================================================================
 #pragma vector = USCI_A0_VECTOR
 __interrupt void USCI_A0_ISR(void) {
-  unsigned int temp=EMPTY;
   switch(__even_in_range(UCA0IV, USCI_MAX_FLAG)){
   case USCI_NO_FLAG: break;
   
   //============================================================================
   case USCI_RX_FLAG:         //Received a character from the PC
-    if(!PC_TX_Enable)        //the PC doesn't like to receive before transmitting
+    if(!PC_TX_Enable){       //the PC doesn't like to receive before transmitting
       PC_TX_Enable = YES;    //now we can transmit to the PC
+      if(ring_Count(&UCA0_Tx_Ring))
+        StartTransmit_UCA0();   //send whatever was waiting on the PC
+    }
 
-    temp = UCA0_rx_ring_wr;     //where to write the char in the ring buffer
-    UCA0_rx_ring_wr++;          //only change this variable here
-    if(UCA0_rx_ring_wr >= SMALL_RING_SIZE)
-      UCA0_rx_ring_wr = COUNT_RESET;
-    
-    ISR_tempChar = UCA0RXBUF;               //what to write into the ring buffer
-    UCA0_Char_Rx[temp] = ISR_tempChar;      //do it
-      
-    UCA0TXBUF = ISR_tempChar;   //echo back to the terminal
+    Stats_RX(STATS_UCA0, UCA0STATW);            //errors first, reading RXBUF clears them
+    ISR_tempChar = UCA0RXBUF;                   //what to write into the ring buffer
+    if(bridge_active){                          //straight through to the module
+      Bridge_UCA0_Char(ISR_tempChar);
+      break;
+    }
+    put_Ring_Char(&UCA0_Rx_Ring, ISR_tempChar); //do it (dropped if full)
+    Mirror_RX_Char(STATS_UCA0, ISR_tempChar, NO);       //echo back to the terminal
     break;
     
     
   //============================================================================
   case USCI_TX_FLAG:              //Ready to transmit to the terminal
-    if(!PC_TX_Enable)   break;    //PC transmit hasn't been enabled
     //Read a char from the TX ring buffer, and then transmit this character
-    temp = UCA0_tx_ring_rd;
-    UCA0_tx_ring_rd++;                       //ONLY EDIT THIS VARIABLE HERE
-    if(UCA0_tx_ring_rd >= SMALL_RING_SIZE)   //keep it in bounds
-      UCA0_tx_ring_rd = COUNT_RESET;
-    
-    UCA0_numToTransmit--;               //how many chars we have yet to transmit
-    if(UCA0_numToTransmit == EMPTY){    //if there are no more chars 
-      UCA0IE &= ~UCTXIE;                //disable further transmits 
+    if(PC_TX_Enable && get_Ring_Char(&UCA0_Tx_Ring, &ISR_tempChar)){
+      UCA0TXBUF = ISR_tempChar;         //transmit the character
+      Stats_TX(STATS_UCA0, ADJUST_1);
+      if(!ring_Count(&UCA0_Tx_Ring))    //if there are no more chars 
+        UCA0IE &= ~UCTXIE;              //disable further transmits 
+    }
+    else{                         //nothing to send (or PC transmit isn't enabled)
+      UCA0IE &= ~UCTXIE;
+      UCA0IFG |= UCTXIFG;         //TXBUF is still empty, keep the flag for next time
     }
-    ISR_tempChar = UCA0_Char_Tx[temp];
-    UCA0TXBUF = ISR_tempChar;           //transmit the character
-
     break;
   default: break;
   }
@@ -89,44 +100,42 @@ __interrupt void USCI_A0_ISR(void) {
 //============================================================================
 #pragma vector = USCI_A3_VECTOR
 __interrupt void USCI_A3_ISR(void) {
-  unsigned int temp=EMPTY;
   switch(__even_in_range(UCA3IV, USCI_MAX_FLAG)){
   case USCI_NO_FLAG: 
     break;
   //===========================================================================
   case USCI_RX_FLAG: //the receive flag indicates a new char came in
-    temp = UCA3_rx_ring_wr;    //where to write the char into the ring buffer
+    Stats_RX(STATS_UCA3, UCA3STATW);
     ISR_tempChar = UCA3RXBUF;  //safety for volatile char
-
-    if(store_wireless_info){   //store the network info for parsing later
-      wireless_info[network_parse_index] = ISR_tempChar;
-      network_parse_index++;            
+    if(bridge_active){         //straight through to the PC, frames and all
+      Bridge_UCA3_Char(ISR_tempChar);
+      break;
     }
-    else{
-      UCA3_Char_Rx[temp] = ISR_tempChar;
-      UCA3_rx_ring_wr++;
-      if(UCA3_rx_ring_wr>=SMALL_RING_SIZE)
-        UCA3_rx_ring_wr = COUNT_RESET;
-    }
-
-    if(PC_TX_Enable)               //echo character to the terminal
-      UCA0TXBUF = ISR_tempChar;    //skip the ISR, go straight to the buffer
+    ISR_inFrame = (frame_state != FRAME_LOOK_FOR_START);       //before or after, so
+    Frame_RX_Char(ISR_tempChar);        //frames go to frame slots, the rest to the ring
+    ISR_inFrame |= (frame_state != FRAME_LOOK_FOR_START);      //<ESC>S and <ESC>E count
+    Mirror_RX_Char(STATS_UCA3, ISR_tempChar, ISR_inFrame);     //show the terminal
     break;
   //===========================================================================  
   case USCI_TX_FLAG:  //the transmit buffer is ready for new char   
-    temp = UCA3_tx_ring_rd;         //volatile safety
-    UCA3_tx_ring_rd++;
-    if(UCA3_tx_ring_rd>=SMALL_RING_SIZE)
-      UCA3_tx_ring_rd = COUNT_RESET;
-    
-    ISR_tempChar = UCA3_Char_Tx[temp];
-    UCA3_numToTransmit--;               //how many chars we have yet to transmit
-    
-    if(UCA3_numToTransmit == EMPTY){     //if there are no more chars 
-      UCA3IE &= ~UCTXIE;                //disable further transmits 
+    if(Bulk_TX_Span(&ISR_bulkSpan)){    //a bulk payload's turn (bulk.c)
+      UCA3TXBUF = *ISR_bulkSpan;
+      Bulk_TX_Commit(ADJUST_1);
+      Stats_TX(STATS_UCA3, ADJUST_1);
+      if(!ring_Count(&UCA3_Tx_Ring) && !Bulk_Busy())
+        UCA3IE &= ~UCTXIE;
+    }
+    else if(get_Ring_Char(&UCA3_Tx_Ring, &ISR_tempChar)){
+      UCA3TXBUF = ISR_tempChar;         //transmit the char
+      Bulk_Ring_Sent(ADJUST_1);
+      Stats_TX(STATS_UCA3, ADJUST_1);
+      if(!ring_Count(&UCA3_Tx_Ring) && !Bulk_Busy())    //if there are no more chars 
+        UCA3IE &= ~UCTXIE;              //disable further transmits 
+    }
+    else{
+      UCA3IE &= ~UCTXIE;
+      UCA3IFG |= UCTXIFG;               //TXBUF is still empty
     }
-    
-    UCA3TXBUF = ISR_tempChar;           //transmit the char
     break;
   //===========================================================================
   default:              
@@ -6,13 +6,15 @@
 //      code updated 3-Dec-2018
 //      formatted 5-Dec-2018
 //
-//      This file contains the ISRs for Timer A0
+//      This file contains the ISRs for Timer A0 (and Timer A1's CCR0)
 //
 //      There are two CCR registers utilized, CCR0 and CCR1
 //      CCR0 is always running
 //      CCR1 is the button debounce timer, it only runs when a button is debouncing
 //
 //      They are currently both configured to flag an interrupt every 100ms
+//
+//      TA1CCR0 only interrupts while the IR emitter is pulsed (ADC.c)
 //==============================================================================
 #include "msp430.h"
 #include "macros.h"
@@ -31,6 +33,14 @@
 __interrupt void Timer0_A0_ISR(void){           //the ISR can be named anything
   TA0CCR0 += TA0CCR0_INTERVAL;                  //add offset to TA0CCR0
   TA0_CCR0_COUNT++;                             //counts how many intervals have passed        
+  TA0_tick++;                                   //this one is never reset
+}
+
+//TA1CCR0.CCIFG, once per ADC conversion, as TA1.1 goes high and starts it
+//only enabled while the emitter is pulsed (see ADC.c)
+#pragma vector = TIMER1_A0_VECTOR
+__interrupt void Timer1_A0_ISR(void){
+  Emitter_Pulse_Slot();
 }
 
 //This interrupt handles flags from TA0IV
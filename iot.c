@@ -0,0 +1,314 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      iot.c
+//
+//      AT command engine for the IOT module (UCA3)
+//
+//      Instead of sending an AT command and sleeping for the worst case,
+//      commands go in a queue and AT_Process() (OS loop) runs them one at a time:
+//              send the command
+//              watch the reply for the expected token (usually OK) or ERROR
+//              give up after the timeout, try again if there are retries left
+//              tell whoever asked how it went (the done callback)
+//      so an operation is finished as soon as the module answers.
+//
+//      While a command is waiting for its reply, AT_Process is the only
+//      one reading the UCA3 RX ring (TCP frames never go through the ring,
+//      see frames.c).  When nothing is waiting, the ring belongs to
+//      IOT_Communication like before.
+//
+//      AT_Send_Hook also hands every reply char to a function as it shows up,
+//      for replies that carry data (AT+NSTAT=?).  Nothing has to be saved up
+//      and searched afterwards.
+//
+//      The strings are kept as pointers, so only hand AT_Send strings that
+//      stick around (string literals, globals).
+//
+//      Link speed -----------------------------------------------------------
+//      The module comes out of reset at 115200.  At boot (and for F/S)
+//      IOT_Link_Task talks it up to the fastest rate that works:
+//              AT at the current rate          is anybody there?
+//              ATB=<rate>                      module switches after its OK
+//              UCA3 switches too               (in the ATB callback)
+//              AT at the new rate              did it work?
+//      if the new rate doesn't answer, both sides go back to the old one and
+//      the next slower rate is tried.  Rates SMCLK can't make (Compute_Baud)
+//      are skipped without asking.  If even the old rate stops answering,
+//      the module gets reset, which puts it back at 115200.
+//      The command queue waits on the task, so nothing is sent mid-switch.
+//
+//      global functions
+//              AT_Send(command, expect, timeout, retries, done)
+//              AT_Send_Hook(command, expect, timeout, retries, done, on_char)
+//              AT_Match(AT_Matcher*, char)
+//              AT_Process(void)
+//              AT_Busy(void)
+//              AT_Clear(void)
+//              Start_Link_Speed(char fastest, char slowest)
+//
+//      local functions
+//              AT_Start(void)
+//              AT_Finish(char result)
+//              IOT_Link_Task(void)               a task (see timerMacros.h)
+//              Link_AT(const char* command, void (*done)(char result))
+//              Link_Done(char result)            AT callbacks
+//              Link_Rate_Done(char result)
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include  "functions.h"
+#include <string.h>
+
+void AT_Start(void);
+void AT_Finish(char result);
+char IOT_Link_Task(void);
+void Link_AT(const char* command, void (*done)(char result));
+void Link_Done(char result);
+void Link_Rate_Done(char result);
+
+AT_Command at_queue[AT_QUEUE_SIZE];             //waiting to be sent
+unsigned int at_queue_wr = COUNT_RESET;         //free running, masked when used
+unsigned int at_queue_rd = COUNT_RESET;
+
+char at_state = AT_IDLE;                        //what at_queue[at_queue_rd] is up to
+char at_tries_left = EMPTY;                     //retries left for the active command
+unsigned int at_deadline = COUNT_RESET;         //TA0_tick when the active one times out
+AT_Matcher at_expect_matcher;                   //the token we want
+AT_Matcher at_error_matcher;                    //the token we don't
+
+unsigned int at_timeouts = COUNT_RESET;         //keeping score
+unsigned int at_errors   = COUNT_RESET;
+
+//the link rates, fastest first (LINK_xxx picks one)
+const unsigned long link_rates[NUM_LINK_RATES] = {BAUD921600, BAUD460800,
+                                                  BAUD230400, BAUD115200, BAUD9600};
+const char* link_rate_commands[NUM_LINK_RATES] = {"ATB=921600\r\n", "ATB=460800\r\n",
+                                                  "ATB=230400\r\n", "ATB=115200\r\n",
+                                                  "ATB=9600\r\n"};
+const char* link_rate_names[NUM_LINK_RATES] = {"L 921600  ", "L 460800  ",
+                                               "L 230400  ", "L 115200  ", "L 9600    "};
+Task link_task;
+char link_try = LINK_FASTEST;                   //the rate being tried
+char link_slowest = LINK_SLOWEST_FAST;          //give up after this one
+char link_result = EMPTY;                       //EMPTY until the AT engine answers
+char link_reset = NO;                           //the module needs a reset first
+
+
+
+//==============================================================================
+//queue a command, returns NO if the queue is full
+//expect  - the token that means it worked, NULL for AT_OK_TOKEN
+//timeout - how long to wait for it, in 100ms ticks (ONE_SECOND, etc.)
+//retries - how many more times to try after the first one fails
+//done    - called with AT_RESULT_xxx when it's over, can be NULL
+char AT_Send(const char* command, const char* expect, unsigned int timeout,
+             char retries, void (*done)(char result)){
+  return AT_Send_Hook(command, expect, timeout, retries, done, NULL);
+}
+
+//same, but on_char sees every char of the reply before it's matched
+char AT_Send_Hook(const char* command, const char* expect, unsigned int timeout,
+                  char retries, void (*done)(char result), void (*on_char)(char c)){
+  AT_Command* at;
+  if((unsigned int)(at_queue_wr - at_queue_rd) >= AT_QUEUE_SIZE)
+    return NO;
+  at = &at_queue[at_queue_wr & AT_QUEUE_MASK];
+  at->command = command;
+  at->expect  = expect ? expect : AT_OK_TOKEN;
+  at->timeout = timeout;
+  at->retries = retries;
+  at->done    = done;
+  at->on_char = on_char;
+  at_queue_wr++;
+  return YES;
+}
+
+//YES if anything is waiting or in progress
+char AT_Busy(void){
+  return (at_queue_rd != at_queue_wr);
+}
+
+//drop everything, nobody gets a callback
+void AT_Clear(void){
+  at_state = AT_IDLE;
+  at_queue_rd = at_queue_wr;
+}
+
+
+//==============================================================================
+//runs in the OS loop
+void AT_Process(void){
+  char c;
+  void (*on_char)(char c);
+  if(!AT_Busy())
+    return;
+  if(at_state == AT_IDLE){                      //next command
+    at_tries_left = at_queue[at_queue_rd & AT_QUEUE_MASK].retries;
+    at_state = AT_SENDING;
+  }
+  if(at_state == AT_SENDING){
+    AT_Start();
+    return;
+  }
+
+  on_char = at_queue[at_queue_rd & AT_QUEUE_MASK].on_char;
+  while(read_UCA3_RX(&c)){                      //look through the reply
+    Session_Chatter_Char(c);                    //a client can connect any time
+    if(on_char)
+      on_char(c);
+    if(AT_Match(&at_expect_matcher, c)){
+      AT_Finish(AT_RESULT_OK);
+      return;
+    }
+    if(AT_Match(&at_error_matcher, c)){
+      at_errors++;
+      if(at_tries_left){                        //try again
+        at_tries_left--;
+        at_state = AT_SENDING;
+      }
+      else
+        AT_Finish(AT_RESULT_ERROR);
+      return;
+    }
+  }
+
+  if((int)(TA0_tick - at_deadline) >= EMPTY){  //waited long enough
+    at_timeouts++;
+    if(at_tries_left){
+      at_tries_left--;
+      at_state = AT_SENDING;
+    }
+    else
+      AT_Finish(AT_RESULT_TIMEOUT);
+  }
+}
+
+//send the command at the front of the queue and start the clock
+//if it doesn't fit in the TX ring, it stays AT_SENDING and tries next pass
+void AT_Start(void){
+  AT_Command* at = &at_queue[at_queue_rd & AT_QUEUE_MASK];
+  char c;
+  if(!transmitString_UCA3((char*)at->command))
+    return;
+  while(read_UCA3_RX(&c))                       //old chatter isn't the reply,
+    Session_Chatter_Char(c);                    //but a CONNECT in it still counts
+  at_expect_matcher.token = at->expect;
+  at_expect_matcher.index = COUNT_RESET;
+  at_error_matcher.token  = AT_ERROR_TOKEN;
+  at_error_matcher.index  = COUNT_RESET;
+  at_deadline = TA0_tick + at->timeout;
+  at_state = AT_WAITING;
+}
+
+//pop the active command, then let the caller know
+//(the callback is free to AT_Send more commands)
+void AT_Finish(char result){
+  void (*done)(char result) = at_queue[at_queue_rd & AT_QUEUE_MASK].done;
+  at_state = AT_IDLE;
+  at_queue_rd++;
+  if(done)
+    done(result);
+}
+
+//feed one char to a matcher, returns YES when the whole token has gone by
+//on a mismatch it starts over (checking if this char starts the token again)
+char AT_Match(AT_Matcher* matcher, char c){
+  if(c == matcher->token[matcher->index])
+    matcher->index++;
+  else if(c == matcher->token[COUNT_RESET])
+    matcher->index = ADJUST_1;                  //this char is the first one
+  else
+    matcher->index = COUNT_RESET;
+  if(matcher->token[matcher->index] == EMPTY){
+    matcher->index = COUNT_RESET;
+    return YES;
+  }
+  return NO;
+}
+
+
+
+//==============================================================================
+//                      Link Speed
+//==============================================================================
+//try link_rates[fastest] through link_rates[slowest], keep the first that works
+//the command queue waits until it's done
+void Start_Link_Speed(char fastest, char slowest){
+  link_try = fastest;
+  link_slowest = slowest;
+  link_reset = NO;
+  Task_Reset(&link_task);
+  Start_Command_Task(IOT_Link_Task);
+}
+
+char IOT_Link_Task(void){
+  TASK_BEGIN(&link_task);
+  Link_AT("AT\r\n", Link_Done);                 //is anybody there?
+  TASK_WAIT_UNTIL(&link_task, link_result != EMPTY);
+  link_reset = (link_result != AT_RESULT_OK);
+
+  while(link_reset || link_try <= link_slowest){
+    if(link_reset){                             //can't hear it, back to 115200
+      link_reset = NO;
+      P3OUT &= ~IOT_RESET;
+      clear_Sessions();                         //the clients are gone
+      clear_UDP();
+      setBaud_UCA3(BAUD115200);
+      TASK_DELAY(&link_task, TWOHUNDRED_MS);
+      P3OUT |= IOT_RESET;
+      TASK_DELAY(&link_task, LINK_BOOT_TIME);
+      Link_AT("AT\r\n", Link_Done);
+      TASK_WAIT_UNTIL(&link_task, link_result != EMPTY);
+      if(link_result != AT_RESULT_OK)
+        break;                                  //nothing else to try
+      if(link_try > link_slowest)
+        break;
+    }
+    if(link_rates[(unsigned char)link_try] == current_Baud_3)
+      break;                                    //nothing faster worked, stay here
+    if(!Baud_Possible(link_rates[(unsigned char)link_try])){
+      link_try++;                               //SMCLK can't make it, don't ask
+      continue;
+    }
+    Link_AT(link_rate_commands[(unsigned char)link_try], Link_Rate_Done);
+    TASK_WAIT_UNTIL(&link_task, link_result != EMPTY);
+    if(link_result == AT_RESULT_OK){            //UCA3 is at the new rate now
+      TASK_DELAY(&link_task, LINK_SETTLE_TIME); //give the module a moment to follow
+      Link_AT("AT\r\n", Link_Done);
+      TASK_WAIT_UNTIL(&link_task, link_result != EMPTY);
+      if(link_result == AT_RESULT_OK)
+        break;                                  //it took
+      link_reset = YES;                         //it didn't
+    }
+    else if(link_result == AT_RESULT_TIMEOUT)
+      link_reset = YES;                         //switched or not?  can't tell
+    link_try++;                                 //ERROR - it said no, still at the old rate
+  }
+
+  strcpy(display_line[DISPLAY_LINE_4], "link ???  ");
+  if(link_result == AT_RESULT_OK)
+    for(link_try=LINK_FASTEST; link_try<NUM_LINK_RATES; link_try++)
+      if(link_rates[(unsigned char)link_try] == current_Baud_3)
+        strcpy(display_line[DISPLAY_LINE_4], link_rate_names[(unsigned char)link_try]);
+  TASK_END(&link_task);
+}
+
+//send one command for the link task, link_result says how it went
+void Link_AT(const char* command, void (*done)(char result)){
+  link_result = EMPTY;
+  if(!AT_Send(command, NULL, AT_DEFAULT_TIMEOUT, AT_DEFAULT_RETRIES, done))
+    link_result = AT_RESULT_ERROR;              //AT queue is full
+}
+
+void Link_Done(char result){
+  link_result = result;
+}
+
+//the module said OK to ATB, it's switching right now, so UCA3 does too
+void Link_Rate_Done(char result){
+  if(result == AT_RESULT_OK)
+    setBaud_UCA3(link_rates[(unsigned char)link_try]);
+  link_result = result;
+}
@@ -69,7 +69,6 @@ void showRTC200(int line){
   temp /= DECREASE_TEN;
   formatRTC200[SEC_PLACE_H] = (temp % DECREASE_TEN)+MAKE_A_CHAR;
   strcpy(display_line[line], formatRTC200);
-  strcpy((char*)UCA0_Char_Tx, formatRTC200);
 }
 
 void clearDisplay(void) {
@@ -49,11 +49,72 @@ extern void FollowLine_Setup(void);
 extern void FollowLine_Process(void);
 
 
+//commands.c =======================
+extern char Queue_Command_Batch(char* batch, char source, char cid);
+extern char Execute_Binary_Command(char* frame, unsigned int length, char cid);
+extern unsigned int CRC16(char* data, unsigned int length);
+extern void Command_Process(void);
+extern void clear_Command_Queue(void);
+extern void Start_Command_Task(char (*task)(void));
+extern void Execute_Command_FRAM(char letter, int argument);
+
+
+//telemetry.c ======================
+extern void Telemetry_Process(void);
+extern void Set_Telemetry_Period(unsigned int ticks);
+extern void Set_Telemetry_Ports(char ports);
+
+
+//stats.c ==========================
+extern void Stats_RX(char port, unsigned int status);
+extern void Stats_TX(char port, unsigned int count);
+extern void Stats_Bad_Pin(char port);
+extern void Start_Stats_Reply(char source, char cid, char page);
+extern unsigned int put_Stat(char* line, unsigned int index, char label,
+                             unsigned int value, char digits);
+
+
+//mirror.c =========================
+extern void Mirror_RX_Char(char port, char c, char in_frame);
+extern void Mirror_Process(void);
+extern void Set_Mirror_Mode(char mode);
+
+
+//bridge.c =========================
+extern void Bridge_Process(void);
+extern void Bridge_UCA0_Char(char c);
+extern void Bridge_UCA3_Char(char c);
+extern volatile char bridge_active;
+#define BRIDGE_ESCAPE_CHAR      (0x1D)  //Ctrl-]
+#define BRIDGE_ESCAPE_COUNT     (3)     //this many in a row leaves the bridge
+
+
+//iot.c ============================
+extern void AT_Process(void);
+extern char AT_Busy(void);
+extern void AT_Clear(void);
+extern void Start_Link_Speed(char fastest, char slowest);
+
+
+//dma.c ============================
+extern void Init_DMA(void);
+extern void DMA_Transmit_UCA0(void);
+extern void DMA_Transmit_UCA3(void);
+extern void DMA_Stop_UCA0(void);
+extern void DMA_Stop_UCA3(void);
+extern void Init_DMA_ADC(void);
+extern const unsigned int* DMA_ADC_Swap(void);
+
+
 //switch.c =========================
 extern char Check_Button_1(void);
 extern char Check_Button_2(void);
 
 
+//clocks.c =========================
+extern unsigned long get_SMCLK_Frequency(void);
+
+
 //serial.c =========================
 extern void Init_Serial(void);
 extern void IOT_Process(void);
@@ -61,6 +122,14 @@ extern void UART0_Setup(void);
 extern void UART3_Setup(void);
 extern void IOT_Enable_Process(void);
 extern char get_UCA3_RX(void);
+extern char read_UCA3_RX(char *c);
+extern char Command_Reply(char source, char cid, const char* data, unsigned int length);
+extern void Execute_Command(char* command, char source, char cid);
+extern char Command_Pin_OK(char* command);
+extern char setBaud_UCA0(unsigned long baud);
+extern char setBaud_UCA3(unsigned long baud);
+extern char Baud_Possible(unsigned long baud);
+extern unsigned long current_Baud_3;
 
 
 
@@ -76,7 +145,9 @@ extern char get_UCA3_RX(void);
 #define MOTORTEST               (6)
 #define IOT_ENABLE              (7)
 #define SHOW_RTC200_PROCESS     (8)
-#define NUM_EVENTS              (8)
+#define BRIDGE                  (9)
+#define NUM_EVENTS              (9)
+#define THUMB_BITS              (12)            //ADC_Thumb is a 12 bit reading
 
 
 
@@ -104,6 +175,12 @@ extern char next_event;
 #define CSLOCK                  (0x01) // Any incorrect password locks registers
 #define EMPTY                   (0x00)
 #define DIR_ALL_OUT             (0xFF)
+#define NUM_DCOFSEL             (8)             //DCOFSEL is 3 bits
+#define DCOFSEL_SHIFT           (1)             //DCOFSEL starts at bit 1 of CSCTL1
+#define DIVS_SHIFT              (4)             //DIVS starts at bit 4 of CSCTL3
+#define LFXT_FREQUENCY          (32768)         //the watch crystal
+#define VLO_FREQUENCY           (9400)          //typical, it drifts a lot
+#define MODOSC_FREQUENCY        (4800000)       //typical
 
 #define REMOVE_LOWER_8BITS      (8)
 #define REMOVE_LOWER_9BITS      (9)
@@ -193,20 +270,93 @@ extern unsigned volatile int button2_debounce_count;
 extern volatile int ADC_Thumb;
 extern volatile int ADC_Left_Detector;
 extern volatile int ADC_Right_Detector;
+extern volatile int ADC_Temperature;    //slow averages
+extern volatile int ADC_Supply;
+extern unsigned int supply_mv;
+extern void ADC_Block(const unsigned int* block);
+extern const unsigned int* volatile ADC_Last_Block;
+extern volatile unsigned int adc_blocks;
+extern unsigned int adc_rate;
+extern void Set_ADC_Rate(unsigned int hz);
+extern void Set_Emitter_Pulsed(char on);
+extern void Emitter_Pulse_Slot(void);
+extern char emitter_pulsed;
 
 extern float on_threshold;      //calculate
 extern float black_threshold;   //calculate
 extern float white_threshold;   //calculate
+extern float pulse_on_threshold;        //the same, for E1 (off - on readings)
+extern float pulse_black_threshold;
+extern float pulse_white_threshold;
 
 #define DEFAULT_BLACK_THRESHOLD           (2000)
 #define DEFAULT_WHITE_THRESHOLD           (3500)
 #define DEFAULT_ON_THRESHOLD              (4000)
+#define DEFAULT_PULSE_BLACK_THRESHOLD     (400)   //E1, less than this is black
+#define DEFAULT_PULSE_WHITE_THRESHOLD     (1200)  //more than this is white
+#define DEFAULT_PULSE_ON_THRESHOLD        (100)   //less than this, the LED isn't lighting anything
 #define BLACK_MARGIN                      (50)
 #define WHITE_MARGIN                      (100)
 #define NUM_DETECTORS                     (2)
 #define IR_TOGGLE_TIME                    (2)   //200 ms
 #define AVERAGE_2                         (2)
 
+//one DMA block is one ADC sequence, MEM8-MEM23 (see ADC.c)
+#define ADC_SEQUENCE_THUMB                (0)
+#define ADC_SEQUENCE_LEFT                 (1)
+#define ADC_SEQUENCE_RIGHT                (2)
+#define ADC_SEQUENCE_SLOW                 (3)   //temperature in even sequences, supply in odd
+#define ADC_SEQUENCE_LENGTH               (4)
+#define ADC_BLOCK_SEQUENCES               (4)   //MEM8-MEM23, all of SHT1
+#define ADC_BLOCK_LENGTH                  (ADC_BLOCK_SEQUENCES*ADC_SEQUENCE_LENGTH)
+#define ADC_NUM_BLOCKS                    (2)   //ping-pong
+//pulsed emitter (Emitter_Pulse_Slot), counted in conversions over a dark/lit pair
+#define EMITTER_ON_SLOT                   (ADC_SEQUENCE_LENGTH + ADC_SEQUENCE_THUMB)
+#define EMITTER_OFF_SLOT                  (ADC_SEQUENCE_LENGTH + ADC_SEQUENCE_SLOW)
+#define EMITTER_SLOT_MASK                 (2*ADC_SEQUENCE_LENGTH - ADJUST_1)
+
+//temperature and supply (ADC_Slow_Sample)
+#define ADC_SLOW_SHIFT                    (8)   //2^8 pairs per reading
+#define ADC_SLOW_COUNT                    (1 << ADC_SLOW_SHIFT)
+#define ADC_FULL_SCALE                    (4095)
+#define ADC_REF_MILLIVOLTS                (2500)        //REFVSEL_2
+#define SUPPLY_DIVIDER                    (2)   //the channel is 1/2 AVCC
+
+//filter.c - one per channel, run on every block (ADC_Block)
+#define FILTER_NONE                       (0)
+#define FILTER_BOXCAR                     (1)
+#define FILTER_EMA                        (2)
+#define FILTER_MEDIAN                     (3)
+#define FILTER_HISTORY_LENGTH             (8)   //the longest boxcar
+#define FILTER_BOXCAR_MAX_SHIFT           (3)   //2^3 = 8
+#define FILTER_EMA_MAX_SHIFT              (6)   //1/64, about 64 sequences to settle
+#define FILTER_MEDIAN_MAX                 (5)
+//A<tsd> - t = type, s = size, d = decimation, one digit each (A120 = boxcar of 4)
+#define FILTER_CODE_TYPE                  (100)
+#define FILTER_CODE_SIZE                  (10)
+#define DETECTOR_FILTER_DEFAULT           (120)
+#define THUMB_FILTER_TYPE                 (FILTER_EMA)
+#define THUMB_FILTER_SIZE                 (3)   //1/8
+
+typedef struct {
+  char type;                            //FILTER_xxx
+  unsigned char size;                   //shift for boxcar/EMA, window for median
+  unsigned char decimate;               //one output every this many samples
+  unsigned char skip;                   //samples since the last output
+  unsigned char index;                  //where the next sample goes in history
+  unsigned char filled;                 //samples in history so far
+  long sum;                             //boxcar running sum, EMA state << size
+  int history[FILTER_HISTORY_LENGTH];
+  int output;                           //the newest filtered value
+} Filter;
+
+extern void Init_Filter(Filter* f, char type, char size, char decimate);
+extern char Filter_Sample(Filter* f, int sample);
+extern void Set_Detector_Filter(int code);
+extern Filter thumb_filter;
+extern Filter left_filter;
+extern Filter right_filter;
+
 //calibration event colors
 #define CAL_OFF                     (0)
 #define CAL_WHITE                   (1)
@@ -221,23 +371,31 @@ extern float white_threshold;   //calculate
 // ============================================================================
 #define BAUD9600        (9600)
 #define BAUD115200      (115200)
+#define BAUD230400      (230400)
 #define BAUD460800      (460800)
-//UCABRW        prescaler setting for BR generator
-#define PRESCALE_9600           (52)
-#define PRESCALE_115200         (4)
-#define PRESCALE_460800         (17)
-//UCBRF         first modulation stage select
-#define STAGE1_9600             (0x0010)
-#define STAGE1_115200           (0x0050)        //5 = 0b0101 
-#define STAGE1_460800           (0)             //n/a
-//UCBRS         second modulation stage select
-#define STAGE2_9600             (0x4900)
-#define STAGE2_115200           (0x5500)        //0x55 = 0b01010101
-#define STAGE2_460800           (0x4A00)        //0xEE = 0b11101110
-
-#define TOGGLE_9600             (1)
-#define TOGGLE_115200           (2)
-#define TOGGLE_460800           (3)
+#define BAUD921600      (921600)
+//the baud rate settings are worked out from SMCLK (see Compute_Baud)
+#define OVERSAMPLE_MIN_N        (16)            //UCOS16 needs BRCLK/baud >= 16
+#define OVERSAMPLE_SHIFT        (4)             //divide by 16
+#define UCBRF_MASK              (0x000F)        //the 1/16ths left over
+#define UCBRF_SHIFT             (4)             //UCBRFx is bits 4-7 of UCAxMCTLW
+#define UCBRS_SHIFT             (8)             //UCBRSx is bits 8-15 of UCAxMCTLW
+#define NUM_UCBRS_SETTINGS      (36)            //user guide table "UCBRSx Settings for Fractional Portion of N"
+#define BAUD_FRACTION_SCALE     (10000)         //fraction of N in 1/10000ths
+#define BAUD_HALF_SCALE         (100)           //sqrt(BAUD_FRACTION_SCALE), keeps the math in 32 bits
+#define UART_FRAME_BITS         (10)            //start + 8 data + stop
+#define UCBRS_BITS              (8)             //UCBRSx pattern repeats every 8 bits
+#define PERMILLE                (1000)
+#define BAUD_MAX_ERROR          (40)            //permille of a bit, more than this is refused
+#define MIN_BAUD_DIVISOR        (3)             //the eUSCI needs at least 3 BRCLKs per bit
+//one set of baud rate settings
+typedef struct {
+  unsigned int brw;             //UCAxBRW
+  unsigned int mctlw;           //UCAxMCTLW (UCBRSx, UCBRFx, UCOS16)
+  int error;                    //worst bit error in permille, +/- (late/early)
+} Baud_Setting;
+
+#define NUM_BAUD_CHOICES        (4)             //one for each thumb wheel quarter
 
 #define NEW_LINE_CHAR           ('\n')          //0x0A
 #define RETURN_CHAR             ('\r')          //0x0D
@@ -247,69 +405,102 @@ extern float white_threshold;   //calculate
 #define USCI_TX_FLAG            (0x04)
 #define USCI_MAX_FLAG           (8)
 #define BEGINNING               (0)
-#define SMALL_RING_SIZE         (50)    //ring buffer size
-#define LARGE_RING_SIZE         (32)    //idk if we'll need large ring buffers
-
-
-// Ring Buffers
-extern volatile char UCA0_Char_Rx[SMALL_RING_SIZE];     //UCA0 RX Ring Buffer
-extern volatile char UCA0_Char_Tx[SMALL_RING_SIZE];     //UCA0 TX Ring Buffer
-extern volatile char UCA3_Char_Rx[SMALL_RING_SIZE];     //UCA3 RX Ring Buffer
-extern volatile char UCA3_Char_Tx[SMALL_RING_SIZE];     //UCA3 TX Ring Buffer
 
-extern volatile unsigned int UCA0_TX_Index;
-extern volatile unsigned int UCA3_TX_Index;     //transmit index TX_RING_BUF -> TXBUF
 
-extern volatile unsigned int UCA0_rx_ring_wr;   //write index RXBUF -> RING_BUF
-extern volatile unsigned int UCA0_rx_ring_rd;   //read index RING_BUF -> program
-extern volatile unsigned int UCA3_rx_ring_wr;
-extern volatile unsigned int UCA3_rx_ring_rd;
-
-extern volatile unsigned int UCA0_tx_ring_wr;   
-extern volatile unsigned int UCA0_tx_ring_rd;   
-extern volatile unsigned int UCA3_tx_ring_wr;
-extern volatile unsigned int UCA3_tx_ring_rd;
+// Ring Buffers (ring.c)
+// the size has to be a power of two, the indexes get masked instead of reset
+#define RING_SIZE               (128)
+#define RING_MASK               (RING_SIZE-1)
+
+typedef struct {
+  volatile char buffer[RING_SIZE];
+  volatile unsigned int wr;     //free running write index, producer only
+  volatile unsigned int rd;     //free running read index, consumer only
+  unsigned int dropped;         //chars that didn't fit           (producer only)
+  unsigned int rejected;        //all-or-nothing writes turned down (producer only)
+  unsigned int high_water;      //most chars ever waiting at once  (producer only)
+} Ring;
+
+extern void clear_Ring(Ring *ring);
+extern unsigned int ring_Count(Ring *ring);
+extern unsigned int ring_Space(Ring *ring);
+extern char put_Ring_Char(Ring *ring, char c);
+extern char get_Ring_Char(Ring *ring, char *c);
+extern unsigned int ring_Write(Ring *ring, const char *data, unsigned int length);
+extern char ring_Write_All(Ring *ring, const char *data, unsigned int length);
+extern unsigned int ring_Read_Span(Ring *ring, volatile char **span);
+extern void ring_Read_Commit(Ring *ring, unsigned int num);
+
+extern Ring UCA0_Rx_Ring;       //UCA0 RX Ring Buffer - ISR writes, program reads
+extern Ring UCA0_Tx_Ring;       //UCA0 TX Ring Buffer - program writes, ISR reads
+extern Ring UCA3_Rx_Ring;       //UCA3 RX Ring Buffer
+extern Ring UCA3_Tx_Ring;       //UCA3 TX Ring Buffer
 
 extern volatile char test_command[11];  //transmit this to test serial comms
 extern volatile char endChar_found;
 extern volatile char tempChar;
 
 extern volatile char PC_TX_Enable;
-extern unsigned volatile int network_parse_index;
-    
-extern volatile int UCA0_numToTransmit;
-extern volatile int UCA3_numToTransmit;
+extern void StartTransmit_UCA0(void);
+extern void StartTransmit_UCA3(void);
+extern unsigned int write_UCA0(const char *data, unsigned int length);
+extern unsigned int write_UCA3(const char *data, unsigned int length);
+extern char write_All_UCA0(const char *data, unsigned int length);
+extern char write_All_UCA3(const char *data, unsigned int length);
+extern char transmitString_UCA0(char* str);
+extern char transmitString_UCA3(char* str);
+
+
+// DMA Transmit (dma.c)
+// trigger numbers come from the DMA trigger table in the device datasheet
+#define DMA_TRIGGER_UCA0TX      (15)    //UCA0TXIFG on channels 0-2
+#define DMA_TRIGGER_UCA3TX      (17)    //UCA3TXIFG on channels 3-5
+#define DMA_TRIGGER_ADC12       (26)    //ADC12 end of sequence, any channel
+#define DMA_TSEL_ODD_SHIFT      (8)     //odd channels use the high byte of DMACTLx
+#define UCA0_TX_DMA             (YES)   //NO = one TX interrupt per char
+#define UCA3_TX_DMA             (YES)
+
+extern char UCA0_use_DMA;
+extern char UCA3_use_DMA;
+extern volatile unsigned int UCA0_dma_length;
+extern volatile unsigned int UCA3_dma_length;
+extern volatile char UCA3_dma_bulk;
+
 // ============================================================================
 // =======================        Wireless Info         =======================
 // ============================================================================
 #define IP_IDENTITY_LENGTH      9
 #define SSID_IDENTITY_LENGTH    8
 #define IP_COMMAND_LENGTH       11
-#define IP_LENGTH               15
+#define IP_LENGTH               (16)    //xxx.xxx.xxx.xxx and the NUL
 #define NEXT_TO_LAST            1
 #define COMMAND_MAX_LENGTH      (50)
-#define WIRELESS_LENGTH         (300)
 #define IP_TOP_HALF_LENGTH      (8)
 #define IP_BOTTOM_HALF_LENGTH   (8)
 #define NUM_DOTS_TOP_HALF       (2)
 
-#define TCP_LOOK_FOR_START      (0)
-#define TCP_STORE_COMMAND       (1)
-#define TCP_EXECUTE_COMMAND     (2)
+//which part of the AT+NSTAT=? reply NSTAT_Char is reading
+#define NSTAT_LOOKING           (0)     //watching for SSID=" or IP addr=
+#define NSTAT_SSID              (1)
+#define NSTAT_IP                (2)
+
 #define TCP_ESCAPE_CHAR         (0x1B)
+#define TCP_START_CHAR          ('S')   //<ESC>S<n> starts a frame
+#define TCP_END_CHAR            ('E')   //<ESC>E ends it
+#define UDP_START_CHAR          ('u')   //<ESC>u<n> starts a datagram
+#define UDP_ADDRESS_END_CHAR    ('\t')  //<ip> <port><tab>, then the data
+#define BULK_START_CHAR         ('Z')   //<ESC>Z<n><llll> starts a bulk frame
+#define TCP_NO_CID              (EMPTY) //haven't heard from a TCP client yet
+#define TCP_WRAP_LENGTH         (3)     //<ESC>S<cid>
+#define TCP_WRAP_END_LENGTH     (2)     //<ESC>E
 
 #define COMMAND_PIN             (6824)
 #define COMMAND_PIN_INDEX       (0)
 #define COMMAND_DIRECTION_INDEX (4)
 #define COMMAND_LETTER_INDEX    (5)
-#define COMMAND_TIME_INDEX      (6)
 
 #define MOVE_UP_A_TENS_PLACE    (10)
 
-extern char Command_Char[COMMAND_MAX_LENGTH];
-extern volatile char Command_Char_Receive;
-extern volatile char store_wireless_info;
-extern char wireless_info[WIRELESS_LENGTH];
 
 extern char my_IP[IP_LENGTH];
 extern char IP_top_half[NUM_DISPLAY_CHARS];
@@ -321,6 +512,321 @@ extern char WIFI_Command[COMMAND_MAX_LENGTH];
 extern unsigned int WIFI_Command_Index;
 
 
+// ============================================================================
+// =======================         AT Commands          =======================
+// ============================================================================
+//iot.c - AT commands wait in a queue, each one waits for its own reply
+#define AT_QUEUE_SIZE           (8)     //must be a power of two
+#define AT_QUEUE_MASK           (AT_QUEUE_SIZE-1)
+#define AT_OK_TOKEN             ("\nOK\r")      //the module answers \r\nOK\r\n
+#define AT_ERROR_TOKEN          ("ERROR")
+#define AT_DEFAULT_TIMEOUT      (ONE_SECOND)
+#define AT_DEFAULT_RETRIES      (2)
+
+//what the done callback hears
+#define AT_RESULT_OK            (1)     //got the expected token
+#define AT_RESULT_ERROR         (2)     //got ERROR every time
+#define AT_RESULT_TIMEOUT       (3)     //got nothing useful in time
+
+//AT_Process states
+#define AT_IDLE                 (0)     //nothing out
+#define AT_SENDING              (1)     //waiting for room in the TX ring
+#define AT_WAITING              (2)     //sent, waiting for the reply
+
+typedef struct {
+  const char* command;          //what to send, \r and all
+  const char* expect;           //the token that means it worked
+  unsigned int timeout;         //in 100ms ticks
+  char retries;                 //extra tries after the first
+  void (*done)(char result);    //AT_RESULT_xxx, can be NULL
+  void (*on_char)(char c);      //sees every reply char, can be NULL
+} AT_Command;
+
+typedef struct {                //looks for a token one char at a time
+  const char* token;
+  unsigned int index;           //how much of the token has matched so far
+} AT_Matcher;
+
+extern char AT_Send(const char* command, const char* expect, unsigned int timeout,
+                    char retries, void (*done)(char result));
+extern char AT_Send_Hook(const char* command, const char* expect, unsigned int timeout,
+                         char retries, void (*done)(char result), void (*on_char)(char c));
+extern char AT_Match(AT_Matcher* matcher, char c);
+extern unsigned int at_timeouts;
+extern unsigned int at_errors;
+
+//link speed - indexes into link_rates[], fastest first
+#define LINK_FASTEST            (0)     //921600
+#define LINK_SLOWEST_FAST       (3)     //115200, where the module starts out
+#define LINK_9600               (4)
+#define NUM_LINK_RATES          (5)
+#define LINK_SETTLE_TIME        (HUNDRED_MS)    //after ATB, before checking
+#define LINK_BOOT_TIME          (ONE_SECOND)    //after the module is reset
+
+
+// ============================================================================
+// =======================          Telemetry           =======================
+// ============================================================================
+//telemetry.c - see the top of the file for the frame layout
+#define TELEMETRY_MARKER        ((char)0xA6)
+#define TELEMETRY_MARKER_INDEX  (0)
+#define TELEMETRY_SEQ_INDEX     (1)
+#define TELEMETRY_LEFT_INDEX    (2)
+#define TELEMETRY_RIGHT_INDEX   (4)
+#define TELEMETRY_THUMB_INDEX   (6)
+#define TELEMETRY_PWM_INDEX     (8)     //four of them
+#define TELEMETRY_TURN_INDEX    (16)
+#define TELEMETRY_FOLLOW_INDEX  (17)
+#define TELEMETRY_RTC_INDEX     (18)
+#define TELEMETRY_SUPPLY_INDEX  (20)
+#define TELEMETRY_TEMPERATURE_INDEX (22)
+#define TELEMETRY_CRC_INDEX     (24)    //also how many bytes the CRC covers
+#define TELEMETRY_FRAME_LENGTH  (26)
+#define TELEMETRY_INT_SIZE      (2)
+
+//telemetry_ports bits
+#define TELEMETRY_UCA0          (0x01)
+#define TELEMETRY_UCA3          (0x02)
+#define TELEMETRY_ALL_PORTS     (TELEMETRY_UCA0 | TELEMETRY_UCA3)
+#define TELEMETRY_PORT_UCA0     (0)     //index into telemetry_budget
+#define TELEMETRY_PORT_UCA3     (1)
+#define NUM_TELEMETRY_PORTS     (2)
+
+#define TELEMETRY_DEFAULT_PERIOD (0)    //off until somebody asks (P command)
+#define TELEMETRY_DEFAULT_PORTS (TELEMETRY_UCA0)
+#define TELEMETRY_BUDGET_PER_TICK (32)  //bytes per 100ms per port (~320 B/s)
+#define TELEMETRY_BUDGET_MAX    (128)   //how much can pile up
+#define TELEMETRY_TX_RESERVE    (32)    //TX ring space left for everybody else
+
+extern unsigned int telemetry_sent;
+extern unsigned int telemetry_skipped;
+
+
+// ============================================================================
+// =======================        Command Queue         =======================
+// ============================================================================
+//commands.c - parsed commands wait here until the car is ready for them
+#define COMMAND_QUEUE_SIZE      (16)    //must be a power of two
+#define COMMAND_QUEUE_MASK      (COMMAND_QUEUE_SIZE-1)
+#define COMMAND_SEPARATOR       (';')   //6824^f10;r9;f20
+
+//where a command came from (so a reply can go back there)
+#define COMMAND_SOURCE_PC       (0)     //UCA0 terminal
+#define COMMAND_SOURCE_TCP      (1)     //UCA3 TCP frame
+#define NUM_COMMAND_SOURCES     (2)
+
+//how a command got here (latency is kept for each, see stats.c)
+//set command_via/command_arrival before calling Execute_Command
+#define VIA_PC                  (0)     //the terminal
+#define VIA_TCP                 (1)
+#define VIA_UDP                 (2)
+#define NUM_VIAS                (3)
+
+//binary commands (see commands.c for the layout)
+#define BINARY_COMMAND_MARKER   ((char)0xA5)    //never the first char of a text command
+#define BINARY_SEQ_INDEX        (1)
+#define BINARY_OPCODE_INDEX     (2)
+#define BINARY_ARGUMENT_INDEX   (3)
+#define BINARY_PIN_INDEX        (5)
+#define BINARY_CRC_INDEX        (7)     //also how many bytes the CRC covers
+#define BINARY_FRAME_LENGTH     (9)
+#define CRC16_INIT              (0xFFFF)
+#define CRC16_POLY              (0x1021)
+#define CRC16_TOP_BIT           (0x8000)
+#define BITS_PER_BYTE           (8)
+
+typedef struct {
+  char letter;                  //f, b, l, r, B, ...
+  int argument;                 //the number after the letter, 0 if none
+  char source;                  //COMMAND_SOURCE_xxx
+  char cid;                     //which TCP client, TCP_NO_CID for the PC
+  char via;                     //VIA_xxx, for the latency numbers
+  unsigned long arrival;        //Timer_Now() when it got here
+} Command;
+
+//assembler.c - one per command source, see Init_Assembler
+typedef struct {
+  char command[COMMAND_MAX_LENGTH];     //the command being put together
+  unsigned int length;
+  char source;                  //COMMAND_SOURCE_xxx, for Execute_Command
+  char cid;                     //which TCP client, TCP_NO_CID for the PC
+  char line_mode;               //YES once \r or \n has been seen
+  char too_long;                //ran out of room, throw it out at the end
+} Assembler;
+
+extern void Init_Assembler(Assembler* a, char source, char cid, char line_mode);
+extern void Assembler_Char(Assembler* a, char c);
+extern void Assembler_End_Of_Frame(Assembler* a);
+extern unsigned int commands_too_long;
+
+extern unsigned int commands_queued;
+extern unsigned int commands_rejected;
+extern unsigned int binary_crc_errors;
+extern unsigned int binary_duplicates;
+extern char command_source;
+extern char command_cid;
+extern char command_via;
+extern unsigned long command_arrival;
+extern char command_takeover;
+
+
+// ============================================================================
+// =======================          Port Stats          =======================
+// ============================================================================
+//stats.c - counters for both serial ports (Q command)
+#define STATS_UCA0              (COMMAND_SOURCE_PC)     //same index as the command source
+#define STATS_UCA3              (COMMAND_SOURCE_TCP)
+#define NUM_STATS_PORTS         (NUM_COMMAND_SOURCES)
+#define STATS_LINE_LENGTH       (128)   //a full line is 122 chars
+#define STAT_DIGITS             (4)     //16 bits in hex
+#define STAT_SHORT_DIGITS       (2)     //high water, RING_SIZE fits in 2
+#define HEX_DIGIT_MASK          (0x0F)
+#define BITS_PER_HEX_DIGIT      (4)
+#define STATS_REPLY_TIMEOUT     (ONE_SECOND)    //give up if the TX ring stays full
+
+typedef struct {
+  volatile unsigned int rx_bytes;       //ISR
+  volatile unsigned int tx_bytes;       //TX ISR or DMA ISR
+  volatile unsigned int overruns;       //UCOE
+  volatile unsigned int framing;        //UCFE
+  volatile unsigned int parity;         //UCPE
+  unsigned int bad_pins;                //main loop
+} Port_Stats;
+
+extern Port_Stats port_stats[NUM_STATS_PORTS];
+
+//Q1 - command to PWM latency, and what happened to the datagrams
+#define STATS_PAGE_PORTS        (0)     //Q or Q0
+#define STATS_PAGE_LATENCY      (1)     //Q1
+#define LATENCY_COUNTS_PER_UNIT (50)    //Timer_Now() counts (2 us) per 0.1 ms
+#define LATENCY_MAX_UNITS       (0xFFFF)
+
+typedef struct {
+  unsigned int last;                    //0.1 ms
+  unsigned int max;
+  unsigned int count;                   //how many moves were timed
+} Latency;
+
+extern void Stats_Latency(char via, unsigned long arrival);
+
+//mirror.c - what the debug tap copies to the terminal (M command)
+#define MIRROR_OFF              (0)
+#define MIRROR_UCA3             (1)     //everything from the IOT module
+#define MIRROR_FRAMES           (2)     //only TCP frames
+#define MIRROR_ALL              (3)     //UCA3 plus the terminal's echo
+#define MIRROR_DEFAULT_MODE     (MIRROR_ALL)    //what the old raw echo did
+#define MIRROR_TX_RESERVE       (32)    //UCA0 TX ring space the tap never touches
+#define MIRROR_MARKER_LENGTH    (26)    //"\r\n~mirror dropped 0000~\r\n" and the NUL
+#define MIRROR_MARKER_COUNT_INDEX (18)  //where the 0000 goes
+
+
+// ============================================================================
+// =======================         TCP Frames           =======================
+// ============================================================================
+//frames.c - the UCA3 ISR splits <ESC>S<n>...<ESC>E frames into these slots
+//(and UDP datagrams, <ESC>u<n><ip> <port><tab>...<ESC>E, see udp.c)
+#define NUM_FRAME_SLOTS         (4)     //must be a power of two
+#define FRAME_SLOT_MASK         (NUM_FRAME_SLOTS-1)
+#define FRAME_MAX_LENGTH        (COMMAND_MAX_LENGTH)
+
+//frame state machine (runs in USCI_A3_ISR)
+#define FRAME_LOOK_FOR_START    (0)     //outside of a frame
+#define FRAME_START_ESCAPE      (1)     //got <ESC>, hoping for S
+#define FRAME_GET_CID           (2)     //next char is <n>
+#define FRAME_STORE             (3)     //payload chars
+#define FRAME_END_ESCAPE        (4)     //got <ESC> in a frame, hoping for E
+#define FRAME_SKIP_ADDRESS      (5)     //UDP only, <ip> <port> before the tab
+#define FRAME_BULK_LENGTH       (6)     //bulk only, the 4 length digits
+#define FRAME_BULK_DATA         (7)     //bulk only, exactly that many chars
+
+typedef struct {
+  char data[FRAME_MAX_LENGTH];  //the payload, NUL terminated, <n> not included
+  unsigned int length;          //payload length (not counting the NUL)
+  char cid;                     //connection ID <n>
+  char udp;                     //YES for <ESC>u (a datagram), NO for <ESC>S
+  unsigned long arrival;        //Timer_Now() when the <ESC>E came in
+} Frame;
+
+extern void Frame_RX_Char(char c);
+extern Frame* get_Frame(void);
+extern void release_Frame(void);
+extern void clear_Frames(void);
+
+//bulk.c - <ESC>Z<n><llll>DATA, the length in 4 decimal digits
+#define BULK_HEADER_LENGTH      (7)
+#define BULK_CID_INDEX          (2)
+#define BULK_LENGTH_INDEX       (3)
+#define BULK_LENGTH_DIGITS      (4)
+#define BULK_MAX_LENGTH         (1400)  //the module won't take more in one frame
+
+extern char Bulk_Send(char cid, const char* data, unsigned int length);
+extern char Bulk_Busy(void);
+extern void Bulk_Cancel(void);
+extern unsigned int Bulk_TX_Span(const char** span);
+extern void Bulk_TX_Commit(unsigned int count);
+extern unsigned int Bulk_Ring_Clip(unsigned int length);
+extern void Bulk_Ring_Sent(unsigned int count);
+extern unsigned int bulk_frames_sent;
+extern volatile unsigned int bulk_frames_received;
+extern char frame_state;
+
+
+// ============================================================================
+// =======================         TCP Sessions         =======================
+// ============================================================================
+//session.c - one per TCP client, so a few can be connected at once
+#define MAX_TCP_SESSIONS        (4)     //how many slots there are
+#define TCP_SESSION_DEFAULT_LIMIT (2)   //a driver and a watcher (N<n> changes it)
+#define SESSION_LINE_LENGTH     (48)    //module chatter, one line at a time
+#define SESSION_BUSY_REPLY      ("BUSY\r\n")
+#define SESSION_BUSY_LENGTH     (6)
+#define CONNECT_TOKEN           ("CONNECT ")
+#define CONNECT_TOKEN_LENGTH    (8)
+#define CONNECT_CID_INDEX       (10)    //CONNECT <server cid> <cid> ...
+#define DISCONNECT_TOKEN        ("DISCONNECT ")
+#define DISCONNECT_TOKEN_LENGTH (11)    //the cid is right after
+
+typedef struct {
+  char cid;                     //the module's <n>, TCP_NO_CID = free slot
+  Assembler assembler;          //this client's commands
+  char binary_seen;             //got a binary sequence number yet?
+  unsigned char binary_last_seq;
+  char telemetry;               //YES if it asked for telemetry
+} Session;
+
+extern Session tcp_sessions[MAX_TCP_SESSIONS];
+extern void Session_Frame(Frame* frame);
+extern void Session_Chatter_Char(char c);
+extern Session* Find_Session(char cid);
+extern void Set_Session_Limit(int limit);
+extern void Set_Session_Telemetry(char cid, char on);
+extern void clear_Sessions(void);
+extern unsigned int sessions_refused;
+extern volatile unsigned int frames_parsed;
+extern volatile unsigned int frames_rejected;
+
+
+// ============================================================================
+// =======================         UDP Control          =======================
+// ============================================================================
+//udp.c - D1 opens a UDP port next to the TCP one, for driving
+#define UDP_PORT_COMMAND        ("AT+NSUDP=4167\r")
+#define UDP_CLOSE_COMMAND       ("AT+NCLOSE=0\r")
+#define UDP_CLOSE_LENGTH        (13)    //and the NUL
+#define UDP_CLOSE_CID_INDEX     (10)    //where the 0 goes
+#define UDP_SERVER_TOKEN        ("CONNECT ")    //AT+NSUDP says CONNECT <cid>
+#define UDP_SEQ_SEPARATOR       (':')   //<seq>:<pin>^<commands>
+#define UDP_RESYNC_TIME         (ONE_SECOND)    //quiet this long, any seq goes
+
+extern void Start_UDP(char on);
+extern void UDP_Datagram(Frame* frame);
+extern void clear_UDP(void);
+extern unsigned int datagrams_accepted;
+extern unsigned int datagrams_stale;
+extern unsigned int datagrams_malformed;
+extern unsigned int datagrams_bad_pin;
+
+
 
 // ============================================================================
 // ======================           Port Pins            ======================
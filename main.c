@@ -22,5 +22,12 @@ void main(void){
     Timer_Process();    //handles time flags 
     Event_Process();    //handles the menu event
     ADC_Process();      //handles the emitter/detector
+    Motion_Process();   //stops timed movements on time
+    if(!bridge_active){ //the bridge's ISRs own the TX rings (bridge.c)
+      Command_Process();        //runs queued commands
+      AT_Process();             //talks to the IOT module
+      Telemetry_Process();      //streams the car's state
+      Mirror_Process();         //copies what the ports hear to the terminal
+    }
   }
 }
\ No newline at end of file
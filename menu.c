@@ -67,6 +67,9 @@ void Event_Process(void){       //handles execution of an event
     case IOT_ENABLE:            //open the IOT module port
       IOT_Enable_Process();
       break;
+    case BRIDGE:                //the PC talks to the IOT module directly
+      Bridge_Process();
+      break;
     default:                    //no event- MENU process
       Menu_Process();
       break;
@@ -103,15 +106,18 @@ void Preview_Event(void) {
     case IOT_ENABLE:
       strcpy(myNextEvent, "IOT Enable");
       break;
+    case BRIDGE:
+      strcpy(myNextEvent, "PC <-> IOT");
+      break;
   }
   strcpy(display_line[DISPLAY_LINE_2], myNextEvent);
 }
 
 
-//use the top bits of the thumb wheel ADC value to select an event
-//right shift the other bits out of the picture
+//split the thumb wheel's range into NUM_EVENTS+1 equal slices (0 = no select)
+//(the top 3 bits only reach 7, which left the last events out)
 void Wheel_To_Menu_Selection(void){
-  next_event = ADC_Thumb>>REMOVE_LOWER_9BITS;
+  next_event = ((unsigned long)ADC_Thumb * (NUM_EVENTS + ADJUST_1)) >> THUMB_BITS;
 }
 
 //MENU state
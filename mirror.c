@@ -0,0 +1,114 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      mirror.c
+//
+//      the debug tap - shows the PC terminal what the ports are receiving
+//
+//      The RX ISRs used to write every char straight into UCA0TXBUF.  That
+//      stepped on whatever the UCA0 TX ISR was in the middle of sending, and
+//      UCA3 at 460800 can't be squeezed through UCA0 at 115200 anyway.
+//      Now the ISRs put mirrored chars in their own ring (mirror_ring), and
+//      Mirror_Process (OS loop) moves them into the UCA0 TX ring like any
+//      other message, always leaving MIRROR_TX_RESERVE free for replies.
+//      When the tap can't keep up, chars are dropped (never the link) and
+//      the terminal gets a marker with how many:
+//              <CR><LF>~mirror dropped 002A~<CR><LF>           (hex)
+//
+//      mirror_mode (M<n> command):
+//              MIRROR_OFF      nothing
+//              MIRROR_UCA3     everything the IOT module says
+//              MIRROR_FRAMES   only the TCP frames, <ESC>S ... <ESC>E
+//              MIRROR_ALL      UCA3 and the terminal's own chars (echo)
+//
+//      Both RX ISRs write the mirror ring, but MSP430 ISRs don't interrupt
+//      each other, so there is still only ever one producer running.
+//      Nothing is mirrored until the PC has talked (PC_TX_Enable).
+//
+//      global functions
+//              Mirror_RX_Char(char port, char c, char in_frame)        ISR only
+//              Mirror_Process(void)
+//              Set_Mirror_Mode(char mode)
+//
+//      local functions
+//              Mirror_Report_Drops(void)
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include  "functions.h"
+
+char Mirror_Report_Drops(void);
+
+Ring mirror_ring;                               //ISRs write, Mirror_Process reads
+volatile char mirror_mode = MIRROR_DEFAULT_MODE;
+unsigned int mirror_reported = COUNT_RESET;     //mirror_ring.dropped we've told about
+char mirror_marker[MIRROR_MARKER_LENGTH] = "\r\n~mirror dropped 0000~\r\n";
+
+
+
+//==============================================================================
+//one received char, port is STATS_UCAx
+//in_frame says if the char was part of a TCP frame (UCA3 only)
+void Mirror_RX_Char(char port, char c, char in_frame){
+  if(!PC_TX_Enable)                             //nobody's listening
+    return;
+  switch(mirror_mode){
+  case MIRROR_ALL:
+    break;
+  case MIRROR_UCA3:
+    if(port != STATS_UCA3)
+      return;
+    break;
+  case MIRROR_FRAMES:
+    if(port != STATS_UCA3 || !in_frame)
+      return;
+    break;
+  default:                                      //MIRROR_OFF
+    return;
+  }
+  put_Ring_Char(&mirror_ring, c);               //counted in mirror_ring.dropped if full
+}
+
+//M<n> - MIRROR_xxx
+void Set_Mirror_Mode(char mode){
+  mirror_mode = mode;
+}
+
+
+//==============================================================================
+//runs in the OS loop
+//as much as fits in the UCA0 TX ring without eating into the reserve
+void Mirror_Process(void){
+  volatile char* span;
+  unsigned int length;
+  unsigned int room;
+  if(!Mirror_Report_Drops())                    //the marker goes first
+    return;
+  while((length = ring_Read_Span(&mirror_ring, &span))){
+    room = ring_Space(&UCA0_Tx_Ring);
+    if(room <= MIRROR_TX_RESERVE)
+      return;                                   //try again next pass
+    room -= MIRROR_TX_RESERVE;
+    if(length > room)
+      length = room;
+    length = write_UCA0((const char*)span, length);
+    ring_Read_Commit(&mirror_ring, length);
+    if(!length)
+      return;
+  }
+}
+
+//tell the terminal about chars that didn't make it, returns NO if the
+//marker is still waiting for room (so nothing newer jumps ahead of it)
+char Mirror_Report_Drops(void){
+  unsigned int dropped = mirror_ring.dropped - mirror_reported;
+  if(!dropped)
+    return YES;
+  if(ring_Space(&UCA0_Tx_Ring) < MIRROR_MARKER_LENGTH + MIRROR_TX_RESERVE)
+    return NO;
+  put_Stat(mirror_marker, MIRROR_MARKER_COUNT_INDEX, EMPTY, dropped, STAT_DIGITS);
+  write_All_UCA0(mirror_marker, MIRROR_MARKER_LENGTH - ADJUST_1);      //no NUL
+  mirror_reported += dropped;
+  return YES;
+}
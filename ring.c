@@ -0,0 +1,150 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      ring.c
+//
+//      single-producer/single-consumer ring buffers
+//      used by the serial ports, one ring per direction per port
+//
+//      RING_SIZE is a power of two, so the wr/rd indexes are allowed to run
+//      freely and get masked down when they touch the buffer.  That means:
+//              count = wr - rd         (unsigned math handles the wrap)
+//              empty = wr == rd
+//              full  = count == RING_SIZE
+//      no slot ever has to be cleared, so a 0x00 char is just a char
+//
+//      Only the producer writes wr, only the consumer writes rd.
+//      The char goes into the buffer BEFORE wr moves, so by the time the
+//      consumer can see the new wr, the char is already there.  A 16 bit
+//      write is atomic on the MSP430, so the ISR side never sees half an index.
+//
+//      global functions
+//              clear_Ring(Ring*)
+//              ring_Count(Ring*)
+//              ring_Space(Ring*)
+//              put_Ring_Char(Ring*, char)
+//              get_Ring_Char(Ring*, char*)
+//              ring_Read_Span(Ring*, volatile char**)
+//              ring_Read_Commit(Ring*, unsigned int)
+//              ring_Write(Ring*, const char*, unsigned int)
+//              ring_Write_All(Ring*, const char*, unsigned int)
+//
+//      local functions
+//              ring_Check_High_Water(Ring*)
+//
+//      The span functions let the consumer work on a whole chunk at once:
+//      ring_Read_Span gives a pointer to the oldest unread char and how many
+//      unread chars follow it before the end of the buffer, then
+//      ring_Read_Commit hands back however many of them were used.
+//      A wrapped ring takes two spans to empty.
+//
+//      The producer keeps score in the ring itself:
+//              dropped         chars that were turned away because it was full
+//              rejected        ring_Write_All calls that didn't fit (nothing written)
+//              high_water      the fullest the ring has ever been
+//      ring_Write takes what fits and says how much that was.
+//      ring_Write_All takes all of it or none of it, so a whole message either
+//      goes out or is counted as lost - never half of one.
+//
+//==============================================================================
+#include "macros.h"
+
+void ring_Check_High_Water(Ring *ring);
+
+//only call this when neither side of the ring is running (ISR disabled)
+//the counters are left alone, they cover the whole run
+void clear_Ring(Ring *ring){
+  ring->wr = COUNT_RESET;
+  ring->rd = COUNT_RESET;
+}
+
+//producer side bookkeeping after a write
+void ring_Check_High_Water(Ring *ring){
+  unsigned int count = ring_Count(ring);
+  if(count > ring->high_water)
+    ring->high_water = count;
+}
+
+//how many chars are waiting to be read
+unsigned int ring_Count(Ring *ring){
+  unsigned int wr = ring->wr;   //one read of each volatile index
+  unsigned int rd = ring->rd;
+  return (unsigned int)(wr - rd);
+}
+
+//how many chars can still be written
+unsigned int ring_Space(Ring *ring){
+  return RING_SIZE - ring_Count(ring);
+}
+
+//producer side - returns NO if the ring is full (the char is not written)
+char put_Ring_Char(Ring *ring, char c){
+  unsigned int wr = ring->wr;
+  if((unsigned int)(wr - ring->rd) >= RING_SIZE){
+    ring->dropped++;                    //full, don't run over unread chars
+    return NO;
+  }
+  ring->buffer[wr & RING_MASK] = c;     //store the char first
+  wr++;
+  ring->wr = wr;                        //then publish it
+  ring_Check_High_Water(ring);
+  return YES;
+}
+
+//consumer side - returns NO if the ring is empty (*c is left alone)
+char get_Ring_Char(Ring *ring, char *c){
+  unsigned int rd = ring->rd;
+  if(rd == ring->wr)
+    return NO;                          //nothing to read
+  *c = ring->buffer[rd & RING_MASK];    //take the char first
+  rd++;
+  ring->rd = rd;                        //then hand the slot back
+  return YES;
+}
+
+//consumer side - contiguous readable chars starting at *span
+//returns 0 when the ring is empty
+unsigned int ring_Read_Span(Ring *ring, volatile char **span){
+  unsigned int rd = ring->rd;
+  unsigned int count = (unsigned int)(ring->wr - rd);
+  unsigned int to_end = RING_SIZE - (rd & RING_MASK);   //room before the wrap
+  *span = &ring->buffer[rd & RING_MASK];
+  if(count > to_end)
+    count = to_end;
+  return count;
+}
+
+//consumer side - release num chars returned by ring_Read_Span
+void ring_Read_Commit(Ring *ring, unsigned int num){
+  ring->rd += num;
+}
+
+//producer side - copy as much of data as fits, publish it all at once
+//returns how many chars were taken, the rest are counted as dropped
+unsigned int ring_Write(Ring *ring, const char *data, unsigned int length){
+  unsigned int wr = ring->wr;
+  unsigned int space = RING_SIZE - (unsigned int)(wr - ring->rd);
+  unsigned int i;
+  if(length > space){
+    ring->dropped += (length - space);
+    length = space;
+  }
+  for(i=COUNT_RESET; i<length; i++){
+    ring->buffer[wr & RING_MASK] = data[i];
+    wr++;
+  }
+  ring->wr = wr;                        //publish the whole write
+  ring_Check_High_Water(ring);
+  return length;
+}
+
+//producer side - all of data or none of it
+char ring_Write_All(Ring *ring, const char *data, unsigned int length){
+  if(length > ring_Space(ring)){
+    ring->rejected++;
+    ring->dropped += length;
+    return NO;
+  }
+  ring_Write(ring, data, length);
+  return YES;
+}
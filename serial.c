@@ -21,8 +21,8 @@
 //      C               clear LCD display
 //      L               toggle LCD backlight
 //
-//      S               slow baud - 9600
-//      F               fast baud - 115200
+//      S               slow link - 9600 (module and UCA3)
+//      F               fast link - the fastest rate that works
 //
 //      H               use home wifi
 //      U               use UNCA wifi
@@ -38,6 +38,22 @@
 //      Z               intercept and follow line
 //      B               turn motors off
 //
+//      P<n>            telemetry every <n>*100 ms (P0 = off), to this TCP client too
+//      O<n>            telemetry ports: 1 = UCA0, 2 = UCA3, 3 = both
+//      Q               port stats, one line back to whoever asked (stats.c)
+//      Q1              command to PWM latency (PC/TCP/UDP) and UDP datagrams
+//      M<n>            debug tap: 0 = off, 1 = UCA3, 2 = TCP frames, 3 = all
+//      N<n>            how many TCP clients at once (session.c)
+//      D<n>            UDP driving port 4167: 1 = open, 0 = closed (udp.c)
+//      A<tsd>          detector filter: type 0 none/1 boxcar/2 EMA/3 median,
+//                      size, decimation (A120 = boxcar of 4, filter.c)
+//      G<n>            ADC sequences a second, 1000-5000 (G0 = free running)
+//      E<n>            1 = pulse the emitter, detectors read dark - lit, 0 = steady
+//
+//      commands look like <pin>^<letter><n>, and a bunch of them can share
+//      one pin:  <pin>^f10;r9;f20  (see commands.c)
+//      TCP frames can also carry the same commands in binary, with a CRC
+//
 //
 //      global functions:
 //              Init_Serial(void)
@@ -50,29 +66,49 @@
 //      local functions:
 //              Project8_Process(void)
 //              IOT_Communication(void) 
+//              PC_Command_Char(char c)
 //
 //--------------Interact with Baud Rate-----------------------------------------
-//              setBaud_UCA0(int)
-//              setBaud_UCA3(int)
+//              setBaud_UCA0(unsigned long baud)
+//              setBaud_UCA3(unsigned long baud)
+//              Compute_Baud(brclk, baud, Baud_Setting*)
+//              Baud_Possible(unsigned long baud)
+//              Baud_Error(brclk, baud, Baud_Setting*)
+//              UCBRS_Lookup(unsigned int fraction)
 //              toggle_Baud_Rate(void)
 //
 //--------------Interact with Command-------------------------------------------
-//              Execute_Command(void)             
-//              Execute_Command_FRAM(void)  
-//              get_Pin_From_Command_Char(void)
-//              get_Time_From_Command_Char(void)  
+//              Execute_Command(char* command, char source, char cid)
+//              Execute_Command_FRAM(char letter, int argument)
+//              get_Pin_From_Command_Char(char* command)
+//              Command_Pin_OK(char* command)     the pin alone, nothing is run
+//              WiFi_Profile_Task(void)           these three are tasks
+//              IOT_Reset_Task(void)              (see timerMacros.h)
 //              getWirelessInfo(void)
+//              NSTAT_Char(char c)                reads the AT+NSTAT=? reply
+//              Split_IP(void)
+//              WiFi_Profile_Done(char result)    AT callbacks (see iot.c)
+//              Wireless_Info_Done(char result)
+//              AT_Test_Done(char result)
+//              TCP_Server_Done(char result)
 //              showWirelessInfo(void)
 //
 //--------------Interact with Ring Buffers--------------------------------------
 //              get_UCA0_RX(void)                 
-//              get_UCA3_RX(void)  
-//              StartTransmit_UCA0(void)          
+//              get_UCA3_RX(void)
+//              read_UCA0_RX(char* c)
+//              read_UCA3_RX(char* c)
+//              StartTransmit_UCA0(void)
 //              StartTransmit_UCA3(void)          
 //              queue_TX_Char_UCA0(char c)        
 //              queue_TX_Char_UCA3(char c)        
 //              transmitString_UCA0(char* str)    
 //              transmitString_UCA3(char* str) 
+//              write_UCA0(const char* data, unsigned int length)
+//              write_UCA3(const char* data, unsigned int length)
+//              write_All_UCA0(const char* data, unsigned int length)
+//              write_All_UCA3(const char* data, unsigned int length)
+//              Command_Reply(char source, char cid, const char* data, unsigned int length)
 //              clear_UCA0_Ring_Buffers(void)
 //              clear_UCA3_Ring_Buffers(void)
 //
@@ -83,34 +119,29 @@
 #include  "functions.h"
 #include <string.h>
 
-volatile char UCA0_Char_Rx[SMALL_RING_SIZE];    //the ring buffers
-volatile char UCA0_Char_Tx[SMALL_RING_SIZE];    
-volatile char UCA3_Char_Rx[SMALL_RING_SIZE];
-volatile char UCA3_Char_Tx[SMALL_RING_SIZE];
-                                                //Indexes (Indeces?)
-volatile unsigned int UCA0_rx_ring_wr = NO;     //where the newest received char goes
-volatile unsigned int UCA0_rx_ring_rd = NO;     //where the char we read is at
-volatile unsigned int UCA0_tx_ring_wr = NO;     //where the char we submit to tx goes
-volatile unsigned int UCA0_tx_ring_rd = NO;     //the char that is currently being tx'ed
-
-volatile unsigned int UCA3_rx_ring_wr = NO;     //UCA3 indexes
-volatile unsigned int UCA3_rx_ring_rd = NO;     
-volatile unsigned int UCA3_tx_ring_wr = NO;
-volatile unsigned int UCA3_tx_ring_rd = NO;
+Ring UCA0_Rx_Ring;      //the ring buffers (see ring.c)
+Ring UCA0_Tx_Ring;      //the ISRs and these functions are the only ones
+Ring UCA3_Rx_Ring;      //that should ever touch them
+Ring UCA3_Tx_Ring;
 
 // Interact with the ring buffers
 void clear_UCA0_Ring_Buffers(void);     // empty the UCA0 ring buffers
 void clear_UCA3_Ring_Buffers(void);     // empty the UCA3 ring buffers
-char get_UCA0_RX(void);                 // get a char from the ring buffer
-char get_UCA3_RX(void);                 // 
+char get_UCA0_RX(void);                 // get a char from the ring buffer (EMPTY if none)
+char get_UCA3_RX(void);                 //
+char read_UCA0_RX(char* c);             // same, but a 0x00 char is a real char
+char read_UCA3_RX(char* c);             // returns NO when the ring is empty
 void StartTransmit_UCA0(void);          // transmit a char/command to the PC
 void StartTransmit_UCA3(void);          // transmit a char/command to the IOT module
-void queue_TX_Char_UCA0(char c);        // queue characters to be transmitted
-void queue_TX_Char_UCA3(char c);        // a counter increments to know how many chars to transmit
-void transmitString_UCA0(char* str);    // queue and transmit a string
-void transmitString_UCA3(char* str);    //
-volatile int UCA0_numToTransmit = COUNT_RESET;  //increment when char added to tx queue
-volatile int UCA3_numToTransmit = COUNT_RESET;  //decrement in ISR
+char queue_TX_Char_UCA0(char c);        // queue characters to be transmitted
+char queue_TX_Char_UCA3(char c);        // returns NO if the TX ring is full
+char transmitString_UCA0(char* str);    // queue and transmit a whole string (or none of it)
+char transmitString_UCA3(char* str);    //
+unsigned int write_UCA0(const char* data, unsigned int length);   // queue what fits, returns how much
+unsigned int write_UCA3(const char* data, unsigned int length);   //
+char write_All_UCA0(const char* data, unsigned int length);       // all or nothing, returns YES/NO
+char write_All_UCA3(const char* data, unsigned int length);       //
+char Command_Reply(char source, char cid, const char* data, unsigned int length);     // back to whoever sent the command
 
 volatile char test_command[NUM_DISPLAY_CHARS] = "NCSU  #1  ";
 volatile char PC_TX_Enable = NO;       //Don't transmit to PC until a char is received from PC
@@ -119,10 +150,33 @@ volatile char PC_TX_Enable = NO;       //Don't transmit to PC until a char is re
 
 // Baud Rate and Baud Rate Accessories =========================================
 void toggle_Baud_Rate(void);            //scroll through possible baud rates
-void setBaud_UCA0(long baud);           //make sure to use predefined baud rates
-void setBaud_UCA3(long baud);           //(9600, 115200, 460800)
+char setBaud_UCA0(unsigned long baud);  //any baud SMCLK can make, returns NO if
+char setBaud_UCA3(unsigned long baud);  //the error is too high (port is left alone)
+char Compute_Baud(unsigned long brclk, unsigned long baud, Baud_Setting* setting);
+char Baud_Possible(unsigned long baud); //would setBaud take it?
+int Baud_Error(unsigned long brclk, unsigned long baud, Baud_Setting* setting);
+unsigned char UCBRS_Lookup(unsigned int fraction);
 unsigned long current_Baud_0 = EMPTY;
 unsigned long current_Baud_3 = EMPTY;
+int baud_error_0 = EMPTY;               //worst bit error of the current baud, permille
+int baud_error_3 = EMPTY;
+
+//the thumb wheel picks one of these (toggle_Baud_Rate)
+const unsigned long baud_choices[NUM_BAUD_CHOICES] = {BAUD9600, BAUD115200,
+                                                      BAUD460800, BAUD921600};
+const char* baud_choice_names[NUM_BAUD_CHOICES] = {"   9600   ", "  115200  ",
+                                                   "  460800  ", "  921600  "};
+
+//user guide table "UCBRSx Settings for Fractional Portion of N = fBRCLK/Baud Rate"
+//the fraction of N (in 1/10000ths) where each setting starts
+const unsigned int ucbrs_fraction[NUM_UCBRS_SETTINGS] = {
+     0,  529,  715,  835, 1001, 1252, 1430, 1670, 2147, 2224, 2503, 3000,
+  3335, 3575, 3753, 4003, 4286, 4378, 5002, 5715, 6003, 6254, 6432, 6667,
+  7001, 7147, 7503, 7861, 8004, 8333, 8464, 8572, 8751, 9004, 9170, 9288};
+const unsigned char ucbrs_value[NUM_UCBRS_SETTINGS] = {
+  0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x11, 0x21, 0x22, 0x44, 0x25,
+  0x49, 0x4A, 0x52, 0x92, 0x53, 0x55, 0xAA, 0x6B, 0xAD, 0xB5, 0xB6, 0xD6,
+  0xB7, 0xBB, 0xDD, 0xED, 0xEE, 0xBF, 0xDF, 0xEF, 0xF7, 0xFB, 0xFD, 0xFE};
   
 
 // Project 8 Stuffs ============================================================
@@ -136,37 +190,49 @@ unsigned int project8_index = EMPTY;
 // Command-Related Stuffs ======================================================
 // When we connect to the port via TCP, every command we send is framed by the IOT module
 //                              <ESC>S<n>COMMAND<ESC>E
+// the UCA3 ISR pulls those apart itself (frames.c), we just get the COMMAND part
 //
-char Command_Char[COMMAND_MAX_LENGTH] = "";     //the command being entered
-int command_wr = COUNT_RESET;                   //where to write to the command char
-int get_Pin_From_Command_Char(void);            //parse for the pin, as a security measure
-int get_Time_From_Command_Char(void);           //parse for the time to use with timed movement functions
+Assembler pc_assembler;                         //the command being typed on the terminal (assembler.c)
+int get_Pin_From_Command_Char(char* command);   //parse for the pin, as a security measure
 
 void IOT_Communication(void);                   // handles communication between FRAM and IOT
-void Execute_Command(void);                     // routes a command to its appropriate recipient - FRAM or IOT
-void Execute_Command_FRAM(void);                // deciphers and executes a FRAM command
+void PC_Command_Char(char c);                   // one char from the terminal (UCA0)
+void Execute_Command(char* command, char source, char cid);     // routes a command to its appropriate recipient - FRAM or IOT
+
+char WiFi_Profile_Task(void);                   // H/U - pick a wifi profile and reset the module
+char IOT_Reset_Task(void);                      // I - pulse the IOT reset line
+void WiFi_Profile_Done(char result);            // these hear back from the AT engine
+void AT_Test_Done(char result);
+void TCP_Server_Done(char result);
+char* wifi_profile_command = "";                //which AT&Yn WiFi_Profile_Task sends
+char wifi_profile_result = EMPTY;               //EMPTY until the reset is answered
+Task wifi_profile_task;
+Task iot_reset_task;
 
-char TCP_escape_found = NO;             //yes means the <ESC> char has been found - the next char should be S or E
-char TCP_store_command = NO;            //yes means we're writing the command to Command_Char
 char IOT_Enable_OneTime = NO;           //yes means the IOT module port has been enabled - we can now connect via TCP
 char IOT_Setup_oneTime = YES;           //yes means the IOT information needs to be reset (index vars and ring buffers cleared)
 
 
 
 //WIFI INFO CAPTURE ============================================================
-void getWirelessInfo(void);
+char getWirelessInfo(void);                     //a task, TASK_DONE once it's parsed
+void Wireless_Info_Done(char result);           //the AT engine got an answer
+void NSTAT_Char(char c);                        //parses the reply as it comes in
+void Split_IP(void);                            //my_IP -> IP_top_half/IP_bottom_half
+Task wireless_task;
 void showWirelessInfo(void);
 
-extern volatile char store_wireless_info = NO;  //if YES, the incoming string contains network info
-char wireless_info[WIRELESS_LENGTH] = "";       //holds the network info to parse
 char my_SSID[NUM_DISPLAY_CHARS] = "";           //value obtained by parsing
 char my_IP[IP_LENGTH] = "";                     //value obtained by parsing
 char IP_top_half[NUM_DISPLAY_CHARS];            //string format for IP display
 char IP_bottom_half[NUM_DISPLAY_CHARS];         //string format for IP bottom half
 const char SSID_Identifier[SSID_IDENTITY_LENGTH] = " SSID=\"";  //what to parse for
 const char IP_Identifier[IP_IDENTITY_LENGTH] = "IP addr=";      //what to parse for
-
-unsigned volatile int network_parse_index = COUNT_RESET;
+AT_Matcher nstat_ssid_matcher = {SSID_Identifier, COUNT_RESET};
+AT_Matcher nstat_ip_matcher   = {IP_Identifier, COUNT_RESET};
+char nstat_field = NSTAT_LOOKING;               //which value the reply is on
+unsigned int nstat_index = COUNT_RESET;         //where the next char of it goes
+char wireless_result = EMPTY;                   //EMPTY until NSTAT is answered
 
 //==============================================================================
 //-------------
@@ -204,107 +270,159 @@ void UART3_Setup(void) {
   clear_UCA3_Ring_Buffers();
 }
 
+//the transmit interrupt is turned off first so the ISR isn't reading
+//the ring while we reset it
 void clear_UCA0_Ring_Buffers(void){
-  int i;
-  for(i=EMPTY; i<SMALL_RING_SIZE; i++){
-    UCA0_Char_Rx[i] = EMPTY;
-    UCA0_Char_Tx[i] = EMPTY;
-  }
-  UCA0_rx_ring_wr = COUNT_RESET;  //index for received characters
-  UCA0_rx_ring_rd = COUNT_RESET;  
-  UCA0_tx_ring_wr = COUNT_RESET;  //index for received characters
-  UCA0_tx_ring_rd = COUNT_RESET;  
+  UCA0IE &= ~UCTXIE;
+  DMA_Stop_UCA0();
+  clear_Ring(&UCA0_Rx_Ring);
+  clear_Ring(&UCA0_Tx_Ring);
 }
 
 void clear_UCA3_Ring_Buffers(void){
-  int i;
-  for(i=EMPTY; i<SMALL_RING_SIZE; i++){
-    UCA3_Char_Rx[i] = EMPTY;
-    UCA3_Char_Tx[i] = EMPTY;
-  }
-  UCA3_rx_ring_wr = COUNT_RESET;
-  UCA3_rx_ring_rd = COUNT_RESET;
-  UCA3_tx_ring_wr = COUNT_RESET;
-  UCA3_tx_ring_rd = COUNT_RESET;
+  UCA3IE &= ~UCTXIE;
+  DMA_Stop_UCA3();
+  Bulk_Cancel();                //its header was in the ring
+  clear_Ring(&UCA3_Rx_Ring);
+  clear_Ring(&UCA3_Tx_Ring);
 }
 
 
 //==============================================================================
 //gets a character and then increases the read index
-//clears the ring buffer behind it
+//nothing is cleared behind it, the ring indexes know how much is in it
+//get_UCAx_RX returns EMPTY when there is nothing to read, so it can't tell
+//a 0x00 char apart from "no char" - use read_UCAx_RX for binary data
 char get_UCA0_RX(void){
-  char myChar = UCA0_Char_Rx[UCA0_rx_ring_rd];  //the char we pull
-  if(myChar == EMPTY)   return EMPTY;           //don't increment past the write index
-  UCA0_Char_Rx[UCA0_rx_ring_rd] = EMPTY;        //clear for the next go-around
-  UCA0_rx_ring_rd++;                            //next index to read
-  if(UCA0_rx_ring_rd >= SMALL_RING_SIZE)        //keep index in bounds
-    UCA0_rx_ring_rd = COUNT_RESET;
+  char myChar = EMPTY;
+  get_Ring_Char(&UCA0_Rx_Ring, &myChar);
   return myChar;
 }
 
 char get_UCA3_RX(void){
-  char myChar = UCA3_Char_Rx[UCA3_rx_ring_rd];  //the char we pull
-  if(myChar == EMPTY)   return EMPTY;
-  UCA3_Char_Rx[UCA3_rx_ring_rd] = EMPTY;
-  UCA3_rx_ring_rd++;
-  if(UCA3_rx_ring_rd >= SMALL_RING_SIZE)
-    UCA3_rx_ring_rd = COUNT_RESET;
+  char myChar = EMPTY;
+  get_Ring_Char(&UCA3_Rx_Ring, &myChar);
   return myChar;
 }
 
+char read_UCA0_RX(char* c){
+  return get_Ring_Char(&UCA0_Rx_Ring, c);
+}
+
+char read_UCA3_RX(char* c){
+  return get_Ring_Char(&UCA3_Rx_Ring, c);
+}
+
 //==============================================================================
 //these functions handle putting chars onto the TX ring buffers
 //chars that are directly written to TXBUF in an interrupt bypass this
-void queue_TX_Char_UCA0(char c){
-  UCA0_Char_Tx[UCA0_tx_ring_wr] = c;            //copy to the queue
-  UCA0_numToTransmit++;                         //number of chars in queue
-  UCA0_tx_ring_wr++;                            //index of next item in queue
-  if(UCA0_tx_ring_wr >= SMALL_RING_SIZE){       //keep index in bounds
-    UCA0_tx_ring_wr = COUNT_RESET;
-  }
+//if the ring is full the char is dropped instead of running over unsent chars
+char queue_TX_Char_UCA0(char c){
+  return put_Ring_Char(&UCA0_Tx_Ring, c);
 }
 
-void queue_TX_Char_UCA3(char c){
-  UCA3_Char_Tx[UCA3_tx_ring_wr] = c;
-  UCA3_numToTransmit++;
-  UCA3_tx_ring_wr++;
-  if(UCA3_tx_ring_wr >= SMALL_RING_SIZE){
-    UCA3_tx_ring_wr = COUNT_RESET;
-  }
+char queue_TX_Char_UCA3(char c){
+  return put_Ring_Char(&UCA3_Tx_Ring, c);
 }
 
 //==============================================================================
-//basically a loop for transmitting strings using the above functions
-void transmitString_UCA0(char* str){
-  int i;
-  int len = strlen(str);        //doesn't include terminating null char
-  for(i=EMPTY; i<len; i++){
-    if(str[i] == EMPTY) break;
-    queue_TX_Char_UCA0(str[i]);
-  }
-  StartTransmit_UCA0();         //begin transmitting
+//non-blocking writes - nothing here ever waits for the ring to empty
+//write_UCAx takes as much as fits and returns how many chars that was,
+//  the leftover is counted in the TX ring's dropped counter
+//write_All_UCAx takes the whole thing or nothing, use it for complete
+//  messages/commands so the other end never gets half of one
+unsigned int write_UCA0(const char* data, unsigned int length){
+  unsigned int accepted = ring_Write(&UCA0_Tx_Ring, data, length);
+  if(accepted)
+    StartTransmit_UCA0();       //begin transmitting
+  return accepted;
 }
 
-void transmitString_UCA3(char* str){
-  int i;
-  int len = strlen(str);        //doesn't include terminating null char
-  for(i=EMPTY; i<len; i++){
-    if(str[i] == EMPTY) break;
-    queue_TX_Char_UCA3(str[i]);
-  }
+unsigned int write_UCA3(const char* data, unsigned int length){
+  unsigned int accepted = ring_Write(&UCA3_Tx_Ring, data, length);
+  if(accepted)
+    StartTransmit_UCA3();
+  return accepted;
+}
+
+char write_All_UCA0(const char* data, unsigned int length){
+  if(!ring_Write_All(&UCA0_Tx_Ring, data, length))
+    return NO;                  //counted in UCA0_Tx_Ring.rejected
+  StartTransmit_UCA0();
+  return YES;
+}
+
+char write_All_UCA3(const char* data, unsigned int length){
+  if(!ring_Write_All(&UCA3_Tx_Ring, data, length))
+    return NO;
   StartTransmit_UCA3();
+  return YES;
+}
+
+//strings are whole messages (AT commands, responses), so they are all or nothing
+char transmitString_UCA0(char* str){
+  return write_All_UCA0(str, strlen(str));   //doesn't include terminating null char
+}
+
+char transmitString_UCA3(char* str){
+  return write_All_UCA3(str, strlen(str));
+}
+
+//answer a command on the port it came in on, all or nothing
+//TCP answers go to the client that asked (cid), wrapped in <ESC>S<cid>...<ESC>E
+//returns NO if there isn't room yet (nothing is written or counted),
+//so a task can just keep trying
+char Command_Reply(char source, char cid, const char* data, unsigned int length){
+  char wrap[TCP_WRAP_LENGTH];
+  if(source != COMMAND_SOURCE_TCP){
+    if(ring_Space(&UCA0_Tx_Ring) < length)
+      return NO;
+    return write_All_UCA0(data, length);
+  }
+  if(cid == TCP_NO_CID)                         //nobody to answer
+    return YES;
+  if(ring_Space(&UCA3_Tx_Ring) < length + TCP_WRAP_LENGTH + TCP_WRAP_END_LENGTH)
+    return NO;
+  wrap[COUNT_RESET] = TCP_ESCAPE_CHAR;          //we're the only producer, so the
+  wrap[ADJUST_1] = TCP_START_CHAR;              //three pieces go out back to back
+  wrap[TCP_WRAP_LENGTH - ADJUST_1] = cid;
+  write_All_UCA3(wrap, TCP_WRAP_LENGTH);
+  write_All_UCA3(data, length);
+  wrap[ADJUST_1] = TCP_END_CHAR;
+  write_All_UCA3(wrap, TCP_WRAP_END_LENGTH);
+  return YES;
 }
 
 //==============================================================================
 //begin transmission, captain
+//DMA: hand the next chunk of the ring to the DMA if it isn't already busy
+//     interrupts are held off so the DMA ISR can't finish a chunk halfway
+//     through us starting one (this is safe to call from an ISR too)
+//ISR: the ISR leaves UCTXIFG set whenever it goes idle, so enabling the
+//     interrupt is enough to get it going again
+//     (forcing the flag here could run over a char still sitting in TXBUF)
 void StartTransmit_UCA0(void){
-  UCA0IFG |= UCTXIFG;   //set the interrupt flag
-  UCA0IE |= UCTXIE;     //enable the interrupt
+  unsigned short interrupt_state;
+  if(UCA0_use_DMA){
+    interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    DMA_Transmit_UCA0();
+    __set_interrupt_state(interrupt_state);
+  }
+  else
+    UCA0IE |= UCTXIE;     //enable the interrupt
 }
 
-void StartTransmit_UCA3(void){    
-  UCA3IFG |= UCTXIFG;   //set the interrupt flag
-  UCA3IE |= UCTXIE;     //enable the interrupt
+void StartTransmit_UCA3(void){
+  unsigned short interrupt_state;
+  if(UCA3_use_DMA){
+    interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    DMA_Transmit_UCA3();
+    __set_interrupt_state(interrupt_state);
+  }
+  else
+    UCA3IE |= UCTXIE;     //enable the interrupt
 }
 
 
@@ -327,6 +445,7 @@ void IOT_Process(void) {
     clearDisplay();
     UART0_Setup();
     UART3_Setup();
+    clear_Frames();
     IOT_Setup_oneTime = NO;
   }
   //Project8_Process();
@@ -375,8 +494,6 @@ void Project8_Process(void){
   }
   if(project8_received){
     if(Check_Button_1()){
-      UCA3_tx_ring_wr = COUNT_RESET;    //NECESSARY?
-      UCA3_tx_ring_rd = COUNT_RESET;    //?
       transmitString_UCA3(project8_string);
       project8_received = NO;
       project8_index = COUNT_RESET;
@@ -397,84 +514,72 @@ void Project8_Process(void){
 //==============================================================================
 //              SERIAL COMM PROCESS ============================================
 //==============================================================================
+//every pass of the OS drains both RX rings completely
+//the rings are read a span at a time, so there is no per-char ring overhead
+//and nothing piles up while Display_Process and Event_Process are busy
+//TCP commands show up as whole frames, each client's session (session.c)
+//puts its own commands together
 void IOT_Communication(void){
-  int i;
-  char UCA0_Char_In = get_UCA0_RX();    //bring in one char each loop
-  char UCA3_Char_In = get_UCA3_RX();    //so long as there is a char
+  volatile char* span;
+  unsigned int span_length;
+  unsigned int i;
+  Frame* frame;
   //============================================================================
   //    UCA0 RX - messages from terminal
   //============================================================================
-  if(UCA0_Char_In){                             //automatically write to Command_Char
-    Command_Char[command_wr] = UCA0_Char_In;    //Store incoming chars into a command string
-    command_wr++;
-    if(UCA0_Char_In == RETURN_CHAR)             //The user hit Enter
-      Execute_Command();                        //Time to do something with the command
+  while((span_length = ring_Read_Span(&UCA0_Rx_Ring, &span))){
+    for(i=COUNT_RESET; i<span_length; i++)
+      PC_Command_Char(span[i]);
+    ring_Read_Commit(&UCA0_Rx_Ring, span_length);
   }
   //============================================================================
   //    UCA3 RX - messages from IOT module
   //============================================================================
-  if(UCA3_Char_In){
-    switch(UCA3_Char_In){     //commands in the form of <ESC>S<n>...<ESC>E
-    case (TCP_ESCAPE_CHAR):   //indicates a frame char for the command
-        TCP_escape_found = YES;         
-      break;
-    case ('S'):
-        if(TCP_escape_found){           //the 'S' is part of an escape char
-          TCP_store_command = YES;      //marks the beginning of a command
-          command_wr = COUNT_RESET;     //start writing the command from the beginning
-          TCP_escape_found = NO;
-        }
-        else if(TCP_store_command){     //the 'S' is not part of an escape char
-          Command_Char[command_wr] = UCA3_Char_In;      //and can be used in commands
-          command_wr++;
-        }
-      break;
-    case ('E'):
-        if(TCP_escape_found){           //the 'E' is part of an escape char
-          TCP_escape_found = NO;        //marking the end of the command
-          TCP_store_command = NO;       //we are finished storing the command
-          for(i=COUNT_RESET; i<command_wr; i++)   //we don't need the character <n>
-            Command_Char[i] = Command_Char[i+1];  //shift the string to ignore <n>
-          Execute_Command();
-        }
-        else if(TCP_store_command){     //the 'E' is not part of an escape char
-          Command_Char[command_wr] = UCA3_Char_In;      //and can be used in commands
-          command_wr++;
-        }
-      break;
-      default:
-        if(TCP_store_command){          //the char is part of the command
-          Command_Char[command_wr] = UCA3_Char_In;  //store it into the command
-          command_wr++;                             //index for the next character
-        }
-        TCP_escape_found = NO;
-        break;
-    }
+  while((frame = get_Frame())){         //complete <ESC>S<n>...<ESC>E frames
+    Session_Frame(frame);               //to the client's session
+    release_Frame();                    //the ISR can reuse the slot now
   }
+  //everything outside of a frame is module chatter (OK, ERROR, CONNECT...)
+  //if an AT command is out, the AT engine is reading it (iot.c)
+  //otherwise only CONNECT/DISCONNECT matter, don't let it fill up the ring
+  if(!AT_Busy())
+    while((span_length = ring_Read_Span(&UCA3_Rx_Ring, &span))){
+      for(i=COUNT_RESET; i<span_length; i++)
+        Session_Chatter_Char(span[i]);
+      ring_Read_Commit(&UCA3_Rx_Ring, span_length);
+    }
+}
+
+//one char from the terminal, the terminal has its own assembler so
+//nothing coming in over TCP can end up in the middle of it
+void PC_Command_Char(char c){
+  command_via = VIA_PC;                         //close enough to when Enter came in
+  command_arrival = Timer_Now();
+  Assembler_Char(&pc_assembler, c);             //runs Execute_Command when the user hits Enter
 }
 
 
 //After we get a command, we have to execute it
-void Execute_Command(void){
-  int i;
+//command is a NUL terminated string, from the terminal or from a TCP frame
+//the commands themselves aren't run here, they go in the queue (commands.c)
+void Execute_Command(char* command, char source, char cid){
   //we have to verify the pin as per instructions
-  strcpy(display_line[DISPLAY_LINE_1], Command_Char);
-  int my_pin = get_Pin_From_Command_Char();
+  strncpy(display_line[DISPLAY_LINE_1], command, NUM_DISPLAY_CHARS - NEXT_TO_LAST);
+  display_line[DISPLAY_LINE_1][NUM_DISPLAY_CHARS - NEXT_TO_LAST] = EMPTY;   //long commands get cut off
+  int my_pin = get_Pin_From_Command_Char(command);
+  if(my_pin != COMMAND_PIN)
+    Stats_Bad_Pin(source);                      //source is also the port (stats.c)
   if(my_pin == COMMAND_PIN){
-    if(Command_Char[COMMAND_DIRECTION_INDEX] == '^')    //this is the pathway decider
-      Execute_Command_FRAM();    //the command is meant for the MSP430
+    if(command[COMMAND_DIRECTION_INDEX] == '^')    //this is the pathway decider
+      Queue_Command_Batch(&command[COMMAND_LETTER_INDEX], source, cid);  //the command is meant for the MSP430
     //  UNCOMMENT AND/OR WORK THIS OUT IF YOU WANT 
     //  TO CONNECT AND TYPE COMMANDS DIRECTLY TO THE IOT MODULE
     //  
     //  TO SEND COMMANDS TO THE IOT MODULE OTHERWISE
     //  USE TransmitString FUNCTIONS
     //  else
-//      transmitString_UCA3(Command_Char);  //the command is meant for the IOT Module
+//      transmitString_UCA3(command);  //the command is meant for the IOT Module
   }
-
-  for(i=EMPTY; i<COMMAND_MAX_LENGTH; i++)       //clear the command string
-    Command_Char[i] = EMPTY;
-  command_wr = COUNT_RESET;
 }
 
 
@@ -484,7 +589,8 @@ void Execute_Command(void){
 //                  EXECUTE FRAM COMMAND
 //==============================================================================
 //for my own sake, try to keep the commands to a single letter
-//timed movement functions require a number
+//timed movement functions require a number (argument)
+//Command_Process (commands.c) calls this once the last movement is done
 //------------------------------------------------------------
 //COMMAND CHARS           COMMAND
 //------------------------------------------------------------
@@ -493,8 +599,8 @@ void Execute_Command(void){
 //      C               clear LCD display
 //      L               toggle LCD backlight
 //
-//      S               slow baud - 9600
-//      F               fast baud - 115200
+//      S               slow link - 9600 (module and UCA3)
+//      F               fast link - the fastest rate that works
 //
 //      H               use home wifi
 //      U               use UNCA wifi
@@ -509,47 +615,84 @@ void Execute_Command(void){
 //      r<n>            right for     <n>*100 ms
 //      Z               intercept and follow line
 //      B               turn motors off
-
-void Execute_Command_FRAM(void){
-  char CommChar1 = Command_Char[COMMAND_LETTER_INDEX];  //for one-character commands
-    switch(CommChar1){
+//
+//      P<n>            telemetry every <n>*100 ms (P0 = off), to this TCP client too
+//      O<n>            telemetry ports: 1 = UCA0, 2 = UCA3, 3 = both
+//      Q               port stats, one line back to whoever asked (stats.c)
+//      Q1              command to PWM latency (PC/TCP/UDP) and UDP datagrams
+//      M<n>            debug tap: 0 = off, 1 = UCA3, 2 = TCP frames, 3 = all
+//      N<n>            how many TCP clients at once (session.c)
+//      D<n>            UDP driving port 4167: 1 = open, 0 = closed (udp.c)
+//      A<tsd>          detector filter: type 0 none/1 boxcar/2 EMA/3 median,
+//                      size, decimation (A120 = boxcar of 4, filter.c)
+//      G<n>            ADC sequences a second, 1000-5000 (G0 = free running)
+//      E<n>            1 = pulse the emitter, detectors read dark - lit, 0 = steady
+
+void Execute_Command_FRAM(char letter, int argument){
+    switch(letter){
       case '^':         
         strcpy(display_line[DISPLAY_LINE_3], "Hey World!");
         break;
+      case 'A':
+        Set_Detector_Filter(argument);
+        break;
       case 'B':
+        Motion_Stop();
         Motors_Off();
         break;
       case 'C':         
         clearDisplay();
         break;
-      case 'F':
-        setBaud_UCA3(BAUD115200);
-        strcpy(display_line[DISPLAY_LINE_3], "UCA3 BAUD ");
-        strcpy(display_line[DISPLAY_LINE_4], "  115200  ");
+      case 'D':                 //these take a char, anything but 0 is on
+        Start_UDP(argument != EMPTY);
+        break;
+      case 'E':
+        Set_Emitter_Pulsed(argument != EMPTY);
+        break;
+      case 'F':                 //as fast as the module and SMCLK can go
+        Start_Link_Speed(LINK_FASTEST, LINK_SLOWEST_FAST);
         break;
       case 'f':
-        Forward_Timed(get_Time_From_Command_Char());
+        Start_Timed_Move(MOTION_FORWARD, argument);
         break;
       case 'r':
-        Right_Timed(get_Time_From_Command_Char());
+        Start_Timed_Move(MOTION_RIGHT, argument);
         break;
       case 'l':
-        Left_Timed(get_Time_From_Command_Char());
+        Start_Timed_Move(MOTION_LEFT, argument);
         break;
       case 'b':
-        Reverse_Timed(get_Time_From_Command_Char());
+        Start_Timed_Move(MOTION_REVERSE, argument);
+        break;
+      case 'G':
+        Set_ADC_Rate(argument);
         break;
       case 'H':
-        transmitString_UCA3("AT&Y1\r\n");
-        delay_100ms(ONE_SECOND);
-        transmitString_UCA3("AT+RESET=1\r\n");
-        delay_100ms(ONE_SECOND);
+        wifi_profile_command = "AT&Y1\r\n";
+        Start_Command_Task(WiFi_Profile_Task);
         break;
       case 'I':
-        P3OUT &= ~IOT_RESET;
-        delay_100ms(TWOHUNDRED_MS);     //delay for between 100-200 ms
-        P3OUT |= IOT_RESET;
-        strcpy(display_line[DISPLAY_LINE_4], "reset-ed  ");
+        Start_Command_Task(IOT_Reset_Task);
+        break;
+      case 'O':                 //out of range is ignored, not cut down to a char
+        if(argument >= EMPTY && argument <= TELEMETRY_ALL_PORTS)
+          Set_Telemetry_Ports(argument);
+        break;
+      case 'N':
+        Set_Session_Limit(argument);
+        break;
+      case 'P':
+        Set_Telemetry_Period(argument);
+        if(command_source == COMMAND_SOURCE_TCP)        //this client wants it
+          Set_Session_Telemetry(command_cid, argument != EMPTY);
+        break;
+      case 'Q':
+        if(argument >= STATS_PAGE_PORTS && argument <= STATS_PAGE_LATENCY)
+          Start_Stats_Reply(command_source, command_cid, argument);
+        break;
+      case 'M':
+        if(argument >= MIRROR_OFF && argument <= MIRROR_ALL)
+          Set_Mirror_Mode(argument);
         break;
       case 'K':
         strcpy(display_line[DISPLAY_LINE_3], "I <3 KT   ");
@@ -561,19 +704,15 @@ void Execute_Command_FRAM(void){
       case 'R':
         IOT_Setup_oneTime=YES;
         break;
-      case 'S':
-        setBaud_UCA3(BAUD9600);
-        strcpy(display_line[DISPLAY_LINE_3], "UCA3 BAUD ");
-        strcpy(display_line[DISPLAY_LINE_4], "   9600   ");   
+      case 'S':                 //slow it down (the module is told too)
+        Start_Link_Speed(LINK_9600, LINK_9600);
         break;
       case 'T':
-        transmitString_UCA3("AT\r\n");
+        AT_Send("AT\r\n", NULL, AT_DEFAULT_TIMEOUT, EMPTY, AT_Test_Done);
         break; 
       case 'U':
-        transmitString_UCA3("AT&Y0\r\n");
-        delay_100ms(ONE_SECOND);
-        transmitString_UCA3("AT+RESET=1\r\n");
-        delay_100ms(ONE_SECOND);
+        wifi_profile_command = "AT&Y0\r\n";
+        Start_Command_Task(WiFi_Profile_Task);
         break;
       case 'W':
         showWirelessInfo();
@@ -584,13 +723,61 @@ void Execute_Command_FRAM(void){
   }
 }
 
+//the waiting parts of the commands above
+//Command_Process keeps calling these until they're done
+//and the OS loop keeps going the whole time
+//the profile switch is done as soon as the module answers the reset
+char WiFi_Profile_Task(void){
+  TASK_BEGIN(&wifi_profile_task);
+  wifi_profile_result = EMPTY;
+  AT_Send(wifi_profile_command, NULL, AT_DEFAULT_TIMEOUT, AT_DEFAULT_RETRIES, NULL);
+  if(!AT_Send("AT+RESET=1\r\n", NULL, AT_DEFAULT_TIMEOUT, EMPTY, WiFi_Profile_Done))
+    WiFi_Profile_Done(AT_RESULT_ERROR);         //AT queue is full, don't wait forever
+  TASK_WAIT_UNTIL(&wifi_profile_task, wifi_profile_result != EMPTY);
+  TASK_END(&wifi_profile_task);
+}
+
+//AT+RESET=1 is the last one, so this is the end of the profile switch
+void WiFi_Profile_Done(char result){
+  wifi_profile_result = result;
+  if(result == AT_RESULT_OK)
+    strcpy(display_line[DISPLAY_LINE_4], "wifi reset");
+  else
+    strcpy(display_line[DISPLAY_LINE_4], "wifi ???  ");
+}
+
+//T - is anybody out there?
+void AT_Test_Done(char result){
+  if(result == AT_RESULT_OK)
+    strcpy(display_line[DISPLAY_LINE_4], "  AT  OK  ");
+  else
+    strcpy(display_line[DISPLAY_LINE_4], "  AT FAIL ");
+}
+
+//AT+NSTCP - is the port open?
+void TCP_Server_Done(char result){
+  if(result != AT_RESULT_OK)
+    strcpy(display_line[DISPLAY_LINE_2], "TCP FAILED");
+}
+
+char IOT_Reset_Task(void){
+  TASK_BEGIN(&iot_reset_task);
+  P3OUT &= ~IOT_RESET;
+  clear_Sessions();                     //the clients are gone
+  clear_UDP();
+  TASK_DELAY(&iot_reset_task, TWOHUNDRED_MS);   //delay for between 100-200 ms
+  P3OUT |= IOT_RESET;
+  strcpy(display_line[DISPLAY_LINE_4], "reset-ed  ");
+  TASK_END(&iot_reset_task);
+}
+
 //if the pin is incorrect, don't run the command
-int get_Pin_From_Command_Char(void){
+int get_Pin_From_Command_Char(char* command){
   int i = COMMAND_PIN_INDEX;
   int parse_num = EMPTY;
-  while(Command_Char[i] != '^'){
+  while(command[i] != '^' && command[i] != EMPTY){
     parse_num*=MOVE_UP_A_TENS_PLACE;
-    parse_num+=(Command_Char[i]-MAKE_A_CHAR);
+    parse_num+=(command[i]-MAKE_A_CHAR);
     i++;
     if(i==COMMAND_DIRECTION_INDEX){
       break;
@@ -599,21 +786,11 @@ int get_Pin_From_Command_Char(void){
   return parse_num;
 }
 
-//get the time to run a timed movement function for
-//command comes in the form <pin><^><letter><number>
-int get_Time_From_Command_Char(void){
-  int i = COMMAND_TIME_INDEX;   //where to begin looking for the time
-  int parse_num = EMPTY;        //the time value thus far
-  while(Command_Char[i] != RETURN_CHAR && Command_Char[i] != TCP_ESCAPE_CHAR && Command_Char[i] != EMPTY){        //keep going until the number ends
-    parse_num*=MOVE_UP_A_TENS_PLACE;            //what a great macro!
-    parse_num+=(Command_Char[i]-MAKE_A_CHAR);   //add it to the total time value
-    i++;
-  }
-  return parse_num;
+//does the command carry the right pin? (UDP checks before it takes the seq)
+char Command_Pin_OK(char* command){
+  return (get_Pin_From_Command_Char(command) == COMMAND_PIN);
 }
 
-
-
 //==============================================================================
 //              IOT / TCP Communication Enable
 //==============================================================================
@@ -621,68 +798,110 @@ int get_Time_From_Command_Char(void){
 //this function enables the TCP communications so we can send it commands via wifi
 void IOT_Enable_Process(void){
   if(!IOT_Enable_OneTime){      //only enable the port one time
-    IOT_Enable_OneTime = YES; 
-    getWirelessInfo();    //connect and obtain an IP address
-    showWirelessInfo();   //show relevant data 
-    transmitString_UCA3("AT+NSTCP=4166,1\r");   //enable port 4166
+    if(getWirelessInfo() == TASK_DONE){ //connect and obtain an IP address
+      IOT_Enable_OneTime = YES; 
+      showWirelessInfo();   //show relevant data 
+      AT_Send("AT+NSTCP=4166,1\r", NULL, AT_DEFAULT_TIMEOUT,      //enable port 4166
+              AT_DEFAULT_RETRIES, TCP_Server_Done);
+    }
   }
   
   if(Check_Button_2()){
     endEvent();
     IOT_Enable_OneTime = NO;
+    Task_Reset(&wireless_task);         //start over next time
   }
 }
 
 
 
-void getWirelessInfo(void){
-  int i;
-  int bottom_half_index = COUNT_RESET;
-  char* SSID_location = NULL;
-  char* IP_location = NULL;
-  int dot_counter = COUNT_RESET;
-  network_parse_index = COUNT_RESET;           
-  store_wireless_info = YES;            //tells the ISR to save the entire response
-  transmitString_UCA3("AT+NSTAT=?\r");  //send command to IOT module, retrieves network info
-
-  //next, we should receive a response from the IOT Module
-  //the ISR should store the entire response in a BOS (Big Ol' String)          
-  delay_100ms(ONE_SECOND);      //wait a second
-  store_wireless_info = NO;     //now we (should) have it
-  
-  SSID_location = strstr(wireless_info, SSID_Identifier);   //pointer to where SSID identifier begins
-  SSID_location += (SSID_IDENTITY_LENGTH - NEXT_TO_LAST);   //offset the identifier size, to get to the data
-  IP_location = strstr(wireless_info, IP_Identifier);
-  IP_location += (IP_IDENTITY_LENGTH - NEXT_TO_LAST);
-  
-  for(i=COUNT_RESET; i<NUM_DISPLAY_CHARS; i++){   //store the SSID to a string
-    if (*(SSID_location+i) == '\"')               //the SSID data ends with a quotation mark
-      break;
-    my_SSID[i] = *(SSID_location+i);
-  }
-  
-  for(i=COUNT_RESET; i<IP_LENGTH; i++){           //store the IP into a single string
-    my_IP[i] = *(IP_location+i);
-    if(my_IP[i] == ' ')
-      break;
+//ask the module for its network info (AT+NSTAT=?)
+//NSTAT_Char picks the SSID and IP out of the reply as it goes by,
+//so this is done as soon as the module says OK
+char getWirelessInfo(void){
+  TASK_BEGIN(&wireless_task);
+  nstat_field = NSTAT_LOOKING;
+  nstat_ssid_matcher.index = COUNT_RESET;
+  nstat_ip_matcher.index = COUNT_RESET;
+  wireless_result = EMPTY;
+  if(!AT_Send_Hook("AT+NSTAT=?\r", NULL, AT_DEFAULT_TIMEOUT, AT_DEFAULT_RETRIES,
+                   Wireless_Info_Done, NSTAT_Char))
+    wireless_result = AT_RESULT_ERROR;          //AT queue is full
+  TASK_WAIT_UNTIL(&wireless_task, wireless_result != EMPTY);
+  TASK_END(&wireless_task);
+}
+
+void Wireless_Info_Done(char result){
+  wireless_result = result;
+}
+
+//one char of the NSTAT reply
+//        ... SSID="ncsu"  CHANNEL=6 ...
+//        IP addr=10.154.1.5   SubNet=255.255.0.0 ...
+//once a token goes by, the chars after it are the value we want
+void NSTAT_Char(char c){
+  switch(nstat_field){
+  case NSTAT_LOOKING:
+    if(AT_Match(&nstat_ssid_matcher, c)){
+      nstat_field = NSTAT_SSID;
+      nstat_index = COUNT_RESET;
+    }
+    else if(AT_Match(&nstat_ip_matcher, c)){
+      nstat_field = NSTAT_IP;
+      nstat_index = COUNT_RESET;
+    }
+    break;
+  case NSTAT_SSID:                      //the SSID ends with a quotation mark
+    if(c == '\"' || nstat_index >= (NUM_DISPLAY_CHARS - NEXT_TO_LAST)){
+      my_SSID[nstat_index] = EMPTY;     //long ones get cut off to fit the LCD
+      nstat_field = NSTAT_LOOKING;
+    }
+    else{
+      my_SSID[nstat_index] = c;
+      nstat_index++;
+    }
+    break;
+  case NSTAT_IP:                        //there are no spaces in an IP
+    if(c == ' ' || c == RETURN_CHAR || c == NEW_LINE_CHAR
+       || nstat_index >= (IP_LENGTH - NEXT_TO_LAST)){
+      my_IP[nstat_index] = EMPTY;
+      Split_IP();
+      nstat_field = NSTAT_LOOKING;
+    }
+    else{
+      my_IP[nstat_index] = c;
+      nstat_index++;
+    }
+    break;
+  default:
+    nstat_field = NSTAT_LOOKING;
+    break;
   }
+}
 
-  for(i=COUNT_RESET; i<NUM_DISPLAY_CHARS; i++){   //break the IP to two strings
-    if(my_IP[i] == '.') {
+//break my_IP into two strings at the second dot so it fits on the LCD
+//        10.154        top half
+//        .1.5          bottom half
+void Split_IP(void){
+  int i = COUNT_RESET;
+  int j = COUNT_RESET;
+  int dot_counter = COUNT_RESET;
+  while(my_IP[i] != EMPTY && i < (NUM_DISPLAY_CHARS - NEXT_TO_LAST)){
+    if(my_IP[i] == '.'){
       dot_counter++;
-      if(dot_counter>=NUM_DOTS_TOP_HALF) {
-        bottom_half_index = i;
+      if(dot_counter >= NUM_DOTS_TOP_HALF)
         break;
-      }
     }
     IP_top_half[i] = my_IP[i];
+    i++;
   }
-
-  for(i=COUNT_RESET; i<NUM_DISPLAY_CHARS; i++){   //begins at the second dot
-    IP_bottom_half[i] = my_IP[(i+bottom_half_index)];
-    if(my_IP[i+bottom_half_index] == ' ')       //there are no spaces in an IP
-      break;
+  IP_top_half[i] = EMPTY;
+  while(my_IP[i] != EMPTY && j < (NUM_DISPLAY_CHARS - NEXT_TO_LAST)){
+    IP_bottom_half[j] = my_IP[i];       //begins at the second dot
+    i++;
+    j++;
   }
+  IP_bottom_half[j] = EMPTY;
 }
 
 //display SSID and IP address on the LCD
@@ -700,29 +919,13 @@ void showWirelessInfo(void){
 //==============================================================================
 //converts the analog wheel into a baud rate
 void toggle_Baud_Rate(void){
-  switch((ADC_Thumb>>REMOVE_LOWER_10BITS)){
-  case TOGGLE_9600:
-    setBaud_UCA0(BAUD9600);
-    setBaud_UCA3(BAUD9600);
-    strcpy(display_line[DISPLAY_LINE_3], "   9600   ");
-    break;
-  case TOGGLE_115200:
-    setBaud_UCA0(BAUD115200);
-    setBaud_UCA3(BAUD115200);
-    strcpy(display_line[DISPLAY_LINE_3], "  115200  ");
-    break;
-  case TOGGLE_460800:
-    setBaud_UCA0(BAUD460800);
-    setBaud_UCA3(BAUD460800);
-    strcpy(display_line[DISPLAY_LINE_3], "  460800  ");
-    break;
-  default:
-    setBaud_UCA0(BAUD9600);
-    setBaud_UCA3(BAUD9600);
-    break;
-  }
-  UCA0IE |= UCRXIE;
-  UCA3IE |= UCRXIE;
+  unsigned int choice = ADC_Thumb >> REMOVE_LOWER_10BITS;       //0-3
+  if(choice >= NUM_BAUD_CHOICES)
+    choice = NUM_BAUD_CHOICES - ADJUST_1;
+  if(setBaud_UCA0(baud_choices[choice]) && setBaud_UCA3(baud_choices[choice]))
+    strcpy(display_line[DISPLAY_LINE_3], baud_choice_names[choice]);
+  else
+    strcpy(display_line[DISPLAY_LINE_3], "  REFUSED ");
 }
 
 
@@ -736,63 +939,117 @@ void toggle_Baud_Rate(void){
 //            UCBRFx  First modulation stage select (UCOS16 == 1 only)
 //            UCOS16  Oversampling mode enable
 //
-//All values are obtained from the user guide (no math for me, no sir)
-void setBaud_UCA0(long baud){
-  UCA0CTLW0 |= UCSWRST; //software reset enable
-  switch (baud) {
-  case BAUD9600:
-    UCA0BRW = PRESCALE_9600;
-    UCA0MCTLW = UCOS16;
-    UCA0MCTLW |= STAGE1_9600;
-    UCA0MCTLW |= STAGE2_9600;
-    current_Baud_0 = BAUD9600;
-    break;
-  case BAUD115200:
-    UCA0BRW = PRESCALE_115200;
-    UCA0MCTLW = UCOS16;
-    UCA0MCTLW |= STAGE1_115200;
-    UCA0MCTLW |= STAGE2_115200;
-    current_Baud_0 = BAUD115200;
-    break;
-  case BAUD460800:
-    UCA0BRW = PRESCALE_460800;
-    UCA0MCTLW = EMPTY;
-    UCA0MCTLW |= STAGE1_460800;
-    UCA0MCTLW |= STAGE2_460800;
-    current_Baud_0 = BAUD460800;
-    break;
-  }
-  UCA0CTL1 &= ~UCSWRST; //disable the reset
+//The values used to come out of the user guide table for 8MHz.  Now they are
+//worked out the same way the user guide does it, from whatever SMCLK really is
+char setBaud_UCA0(unsigned long baud){
+  Baud_Setting setting;
+  if(!Compute_Baud(get_SMCLK_Frequency(), baud, &setting))
+    return NO;                  //too far off, keep what we had
+  UCA0CTLW0 |= UCSWRST;         //software reset enable
+  UCA0BRW = setting.brw;
+  UCA0MCTLW = setting.mctlw;
+  UCA0CTLW0 &= ~UCSWRST;        //disable the reset
+  UCA0IE |= UCRXIE;             //the reset turned the interrupts off
+  if(ring_Count(&UCA0_Tx_Ring))
+    StartTransmit_UCA0();
+  current_Baud_0 = baud;
+  baud_error_0 = setting.error;
+  return YES;
 }
 
 
 
-void setBaud_UCA3(long baud){
-  UCA3CTLW0 |= UCSWRST; //software reset enable
-  switch (baud) {
-  case BAUD9600:
-    UCA3BRW = PRESCALE_9600;
-    UCA3MCTLW = UCOS16;
-    UCA3MCTLW |= STAGE1_9600;
-    UCA3MCTLW |= STAGE2_9600;
-    current_Baud_3 = BAUD9600;
-    break;
-  case BAUD115200:
-    UCA3BRW = PRESCALE_115200;
-    UCA3MCTLW = UCOS16;
-    UCA3MCTLW |= STAGE1_115200;
-    UCA3MCTLW |= STAGE2_115200;
-    current_Baud_3 = BAUD115200;
-    break;
-  case BAUD460800:
-    UCA3BRW = PRESCALE_460800;
-    UCA3MCTLW = EMPTY;
-    UCA3MCTLW |= STAGE1_460800;
-    UCA3MCTLW |= STAGE2_460800;
-    current_Baud_3 = BAUD460800;
-    break;
+char setBaud_UCA3(unsigned long baud){
+  Baud_Setting setting;
+  if(!Compute_Baud(get_SMCLK_Frequency(), baud, &setting))
+    return NO;
+  UCA3CTLW0 |= UCSWRST;
+  UCA3BRW = setting.brw;
+  UCA3MCTLW = setting.mctlw;
+  UCA3CTLW0 &= ~UCSWRST;
+  UCA3IE |= UCRXIE;
+  if(ring_Count(&UCA3_Tx_Ring))
+    StartTransmit_UCA3();
+  current_Baud_3 = baud;
+  baud_error_3 = setting.error;
+  return YES;
+}
+
+
+//the user guide recipe ("Baud-Rate Settings Quick Set Up")
+//      N = brclk / baud
+//      N >= 16:  UCOS16 = 1, UCBRx = INT(N/16), UCBRFx = INT(frac(N/16) * 16)
+//      N <  16:  UCOS16 = 0, UCBRx = INT(N)
+//      UCBRSx comes from the fraction of N (table above)
+//returns NO if the bit error would be more than BAUD_MAX_ERROR
+char Compute_Baud(unsigned long brclk, unsigned long baud, Baud_Setting* setting){
+  unsigned long n;
+  unsigned long remainder;
+  unsigned int fraction;
+  if(baud == EMPTY || brclk / baud < MIN_BAUD_DIVISOR)
+    return NO;                  //SMCLK can't go that fast
+  n = brclk / baud;
+  remainder = brclk % baud;
+  //frac(N) in 1/10000ths, in two steps of 100 so nothing overflows 32 bits
+  fraction = (unsigned int)((remainder * BAUD_HALF_SCALE / baud) * BAUD_HALF_SCALE
+           + ((remainder * BAUD_HALF_SCALE) % baud) * BAUD_HALF_SCALE / baud);
+  if(n >= OVERSAMPLE_MIN_N){
+    setting->brw = (unsigned int)(n >> OVERSAMPLE_SHIFT);
+    setting->mctlw = UCOS16 | ((unsigned int)(n & UCBRF_MASK) << UCBRF_SHIFT);
+  }
+  else{
+    setting->brw = (unsigned int)n;
+    setting->mctlw = EMPTY;
   }
-  UCA3CTL1 &= ~UCSWRST; //disable the reset
+  setting->mctlw |= (unsigned int)UCBRS_Lookup(fraction) << UCBRS_SHIFT;
+  setting->error = Baud_Error(brclk, baud, setting);
+  if(setting->error > BAUD_MAX_ERROR || setting->error < -BAUD_MAX_ERROR)
+    return NO;
+  return YES;
+}
+
+//would setBaud_UCAx take this rate? (nothing is changed)
+char Baud_Possible(unsigned long baud){
+  Baud_Setting setting;
+  return Compute_Baud(get_SMCLK_Frequency(), baud, &setting);
+}
+
+//walk through one frame and see how far each bit edge lands from where
+//it should be, returns the worst one in permille of a bit
+//UCBRSx adds one BRCLK to a bit whenever its bit is set (LSB first)
+int Baud_Error(unsigned long brclk, unsigned long baud, Baud_Setting* setting){
+  unsigned long per_bit;
+  unsigned long elapsed = COUNT_RESET;          //BRCLKs since the start bit
+  unsigned char ucbrs = (unsigned char)(setting->mctlw >> UCBRS_SHIFT);
+  long clocks_per_permille = (long)(brclk / PERMILLE);
+  long error;
+  int worst = EMPTY;
+  char bit;
+  if(setting->mctlw & UCOS16)
+    per_bit = ((unsigned long)setting->brw << OVERSAMPLE_SHIFT)
+            + ((setting->mctlw >> UCBRF_SHIFT) & UCBRF_MASK);
+  else
+    per_bit = setting->brw;
+  if(clocks_per_permille == EMPTY)              //really slow clock, just round up
+    clocks_per_permille = ADJUST_1;
+  for(bit=COUNT_RESET; bit<UART_FRAME_BITS; bit++){
+    elapsed += per_bit;
+    if(ucbrs & (ADJUST_1 << (bit % UCBRS_BITS)))
+      elapsed++;
+    //(actual - ideal) in bit times = (elapsed*baud - (bit+1)*brclk) / brclk
+    error = ((long)(elapsed * baud) - (long)((bit + ADJUST_1) * brclk)) / clocks_per_permille;
+    if((error < EMPTY ? -error : error) > (worst < EMPTY ? -worst : worst))
+      worst = (int)error;                       //keep the sign, early or late
+  }
+  return worst;
+}
+
+//UCBRSx for a fraction of N (1/10000ths), the last setting that starts at or below it
+unsigned char UCBRS_Lookup(unsigned int fraction){
+  unsigned int i = NUM_UCBRS_SETTINGS - ADJUST_1;
+  while(i && ucbrs_fraction[i] > fraction)
+    i--;
+  return ucbrs_value[i];
 }
 
 
@@ -812,6 +1069,7 @@ void Init_Serial(void){
   setBaud_UCA0(BAUD115200);
   UCA0IE |= UCRXIE;             //enable RX interrupt
   PC_TX_Enable = NO;            //disable TX until RX occurs
+  Init_Assembler(&pc_assembler, COMMAND_SOURCE_PC, TCP_NO_CID, YES);  //the terminal always sends Enter
   
   
   //UCA3 initialization --------------------------------------------------------
@@ -0,0 +1,177 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      session.c
+//
+//      one session per TCP client (the IOT module's connection ID, the <n>
+//      in <ESC>S<n>...<ESC>E)
+//
+//      Up to tcp_session_limit clients (N<n>, at most MAX_TCP_SESSIONS) can
+//      be on port 4166 at once, e.g. a controller app driving the car and a
+//      laptop watching telemetry.  Each session has its own:
+//              command assembler (assembler.c), so half a command from one
+//              client never gets glued onto a command from another, or
+//              onto whatever is being typed on the terminal
+//              binary sequence number (the resend check in commands.c)
+//              replies - they go back framed to its own <n>
+//              telemetry switch - only clients that sent P<n> get frames
+//
+//      A session starts with the module's CONNECT message, or with the first
+//      frame from a <n> we don't know (in case the CONNECT went by while
+//      nobody was reading), and ends with DISCONNECT.  A client over the
+//      limit gets BUSY back and its frames are thrown out.
+//
+//              CONNECT <server cid> <cid> <ip> <port>
+//              DISCONNECT <cid>
+//
+//      Commands end with \r or \n.  Clients that never send either get one
+//      command per frame, same as always.  A session switches to line mode
+//      the first time it sends \r or \n, and from then on a command can be
+//      split across frames (that part is the assembler's job).
+//
+//      global functions
+//              Session_Frame(Frame* frame)
+//              Session_Chatter_Char(char c)
+//              Find_Session(char cid)
+//              Set_Session_Limit(int limit)
+//              Set_Session_Telemetry(char cid, char on)
+//              clear_Sessions(void)
+//
+//      local functions
+//              Open_Session(char cid)
+//              Close_Session(char cid)
+//              Session_Line(void)
+//
+//==============================================================================
+#include "macros.h"
+#include  "functions.h"
+#include <string.h>
+
+Session* Open_Session(char cid);
+void Close_Session(char cid);
+void Session_Line(void);
+
+Session tcp_sessions[MAX_TCP_SESSIONS];         //cid == TCP_NO_CID means the slot is free
+unsigned int tcp_session_limit = TCP_SESSION_DEFAULT_LIMIT;
+unsigned int sessions_opened  = COUNT_RESET;
+unsigned int sessions_refused = COUNT_RESET;    //frames from clients over the limit
+
+char session_line[SESSION_LINE_LENGTH];         //one line of module chatter
+unsigned int session_line_length = COUNT_RESET;
+
+
+
+//==============================================================================
+//a frame from the module, hand its contents to the client's session
+//UDP datagrams come through here too, they're udp.c's
+void Session_Frame(Frame* frame){
+  Session* session;
+  unsigned int i;
+  if(frame->udp){                               //not a client, a datagram (udp.c)
+    UDP_Datagram(frame);
+    return;
+  }
+  command_via = VIA_TCP;                        //for the latency numbers
+  command_arrival = frame->arrival;
+  session = Open_Session(frame->cid);
+  if(!session){                                 //one too many
+    sessions_refused++;
+    Command_Reply(COMMAND_SOURCE_TCP, frame->cid, SESSION_BUSY_REPLY, SESSION_BUSY_LENGTH);
+    return;
+  }
+  if(!session->assembler.length && frame->length
+     && frame->data[COUNT_RESET] == BINARY_COMMAND_MARKER){
+    Execute_Binary_Command(frame->data, frame->length, session->cid);
+    return;
+  }
+  for(i=COUNT_RESET; i<frame->length; i++)
+    Assembler_Char(&session->assembler, frame->data[i]);
+  Assembler_End_Of_Frame(&session->assembler);
+}
+
+
+//==============================================================================
+//the session for cid, NULL if there isn't one
+Session* Find_Session(char cid){
+  unsigned int i;
+  for(i=COUNT_RESET; i<MAX_TCP_SESSIONS; i++)
+    if(tcp_sessions[i].cid == cid)
+      return &tcp_sessions[i];
+  return NULL;
+}
+
+//the session for cid, a new one if there's room, NULL if there isn't
+Session* Open_Session(char cid){
+  Session* session = Find_Session(cid);
+  unsigned int open = COUNT_RESET;
+  unsigned int i;
+  if(session || cid == TCP_NO_CID)
+    return session;
+  for(i=COUNT_RESET; i<MAX_TCP_SESSIONS; i++)
+    if(tcp_sessions[i].cid != TCP_NO_CID)
+      open++;
+  if(open >= tcp_session_limit)
+    return NULL;
+  session = Find_Session(TCP_NO_CID);           //a free slot
+  session->cid = cid;
+  Init_Assembler(&session->assembler, COMMAND_SOURCE_TCP, cid, NO);
+  session->binary_seen = NO;
+  session->telemetry = NO;
+  sessions_opened++;
+  return session;
+}
+
+void Close_Session(char cid){
+  Session* session = Find_Session(cid);
+  if(session && cid != TCP_NO_CID)
+    session->cid = TCP_NO_CID;
+}
+
+//forget every client (the module was reset, so they're gone anyway)
+void clear_Sessions(void){
+  unsigned int i;
+  for(i=COUNT_RESET; i<MAX_TCP_SESSIONS; i++)
+    tcp_sessions[i].cid = TCP_NO_CID;
+  session_line_length = COUNT_RESET;
+}
+
+//N<n> - how many clients at once, 1 to MAX_TCP_SESSIONS
+//clients already connected stay connected
+void Set_Session_Limit(int limit){
+  if(limit < ADJUST_1)
+    limit = ADJUST_1;
+  if(limit > MAX_TCP_SESSIONS)
+    limit = MAX_TCP_SESSIONS;
+  tcp_session_limit = limit;
+}
+
+//P<n> from a client turns its telemetry on (P0 off)
+void Set_Session_Telemetry(char cid, char on){
+  Session* session = Find_Session(cid);
+  if(session && cid != TCP_NO_CID)
+    session->telemetry = on;
+}
+
+
+//==============================================================================
+//module chatter (everything outside of a frame), one char at a time
+//only CONNECT and DISCONNECT lines matter here
+void Session_Chatter_Char(char c){
+  if(c == RETURN_CHAR || c == NEW_LINE_CHAR){
+    session_line[session_line_length] = EMPTY;
+    Session_Line();
+    session_line_length = COUNT_RESET;
+  }
+  else if(session_line_length < (SESSION_LINE_LENGTH - NEXT_TO_LAST)){
+    session_line[session_line_length] = c;
+    session_line_length++;
+  }
+}
+
+void Session_Line(void){
+  if(!strncmp(session_line, DISCONNECT_TOKEN, DISCONNECT_TOKEN_LENGTH))
+    Close_Session(session_line[DISCONNECT_TOKEN_LENGTH]);
+  else if(!strncmp(session_line, CONNECT_TOKEN, CONNECT_TOKEN_LENGTH)
+          && session_line_length > CONNECT_CID_INDEX)     //skip the server's cid
+    Open_Session(session_line[CONNECT_CID_INDEX]);
+}
@@ -28,6 +28,16 @@ extern void Reverse_Timed(int num_ms);
 extern void Left_Timed(int num_ms);
 extern void Right_Timed(int num_ms);
 
+extern void Start_Timed_Move(char direction, int num_ms);
+extern void Motion_Process(void);
+extern void Motion_Stop(void);
+extern char Motion_Busy(void);
+#define MOTION_NONE             (0)
+#define MOTION_FORWARD          (1)
+#define MOTION_REVERSE          (2)
+#define MOTION_LEFT             (3)
+#define MOTION_RIGHT            (4)
+
 extern void Turn_Right(void);
 extern void Turn_Left(void);
 extern void Turn_180(void);
@@ -35,6 +45,7 @@ extern void Turn_180(void);
 extern char followingLine;
 
 extern char TURN_STATE;
+extern char followLine_State;
 #define NO_TURN                 (0)
 #define TURN_LEFT               (1)
 #define TURN_RIGHT              (2)
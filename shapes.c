@@ -36,10 +36,18 @@
 //              Left_Timed(int num_ms)          ONE_SECOND = ONE_SECOND_TA0CCR0
 //              Right_Timed(int num_ms)         TA0CCR0 is a 100ms timer
 //
+//              Start_Timed_Move(char, int)     what the *_Timed functions use
+//              Motion_Process(void)            stops a timed movement on time
+//              Motion_Busy(void)               YES while a timed movement runs
+//              Motion_Stop(void)               cut a timed movement short
+//
 //              Turn_Right(void)                turn 90 degrees CW
 //              Turn_Left(void)                 turn 90 degrees CCW
 //              Turn_180(void)                  turn 180 degrees
 //
+//              timed movements and turns return right away, wait for them
+//              in a task with TASK_WAIT_UNTIL(&task, !Motion_Busy())
+//
 //              MotorTest_Setup(void)    
 //              MotorTest_Process(void)         test motor functionality
 //              FindLine_Setup(void)     
@@ -56,6 +64,11 @@
 //              MotorTest1(void)
 //              SpeedAdjust(void)
 //              Detector_On_Line(int)
+//              Detector_White(int)
+//              Detector_Black(int)
+//              FindLine_Found_Task(void)
+//              FollowLine_Setup_Task(void)
+//              FollowLine_Exit_Task(void)
 //==============================================================================
 
 #include "macros.h"
@@ -73,10 +86,15 @@ void Right_Reverse(void);
 void MotorTest1(void);                          //test all the wheel functionality
 void SpeedAdjust(void);                         //line following controller
 char Detector_On_Line(int detector_value);      //line detection function
+char Detector_White(int detector_value);        //off the line
+char Detector_Black(int detector_value);        //on the line for sure
+char FindLine_Found_Task(void);                 //turn onto the line, wait a bit
+char FollowLine_Setup_Task(void);               //get ready, wait a bit, go
+char FollowLine_Exit_Task(void);                //turn off of the line and park
 
 // Variables-------------------------------------------------------------------
-extern volatile unsigned char test_state = NO;
-extern volatile char MotorTest_OneTime = NO;
+volatile unsigned char test_state = NO;
+volatile char MotorTest_OneTime = NO;
 
 char findLine_oneTime   = YES;          //these variables are used to 
 char followLine_oneTime = YES;          //run the setup function one time
@@ -85,6 +103,11 @@ char findLine_State     = EMPTY;        //state machine for finding a line
 char followLine_State   = EMPTY;        //state machine for following a line
 char switched_turn_state = YES;         //indicates a fresh change of direction
 char TURN_STATE         = NO_TURN;      //the current turning direction for line following
+char followLine_exit_turn = MOTION_LEFT;        //which way FollowLine_Exit_Task turns
+Task findLine_task;                     //these run the waiting parts
+Task followLine_task;                   //of FindLine and FollowLine
+char motion_direction   = MOTION_NONE;  //what Start_Timed_Move is doing
+unsigned int motion_deadline = COUNT_RESET;     //TA0_tick when it's done
 
 
 //==============================================================================
@@ -231,27 +254,65 @@ void MotorTest_Process(void) {
 //==============================================================================
 //                   timed movement
 //==============================================================================
+//these start the wheels and return right away (nothing waits in delay_100ms)
+//Motion_Process stops them when the time is up
 void Forward_Timed(int num_ms){
-  Forward_Move();
-  delay_100ms(num_ms);
-  Brake_All();
+  Start_Timed_Move(MOTION_FORWARD, num_ms);
 }
 void Left_Timed(int num_ms){
-  Right_Forward();
-  Left_Reverse();
-  delay_100ms(num_ms);
-  Motors_Off();
+  Start_Timed_Move(MOTION_LEFT, num_ms);
 }
 void Right_Timed(int num_ms){
-  Left_Forward();
-  Right_Reverse();
-  delay_100ms(num_ms);
-  Motors_Off();
+  Start_Timed_Move(MOTION_RIGHT, num_ms);
 }
 void Reverse_Timed(int num_ms){
-  Reverse_Move();
-  delay_100ms(num_ms);
-  Motors_Off();
+  Start_Timed_Move(MOTION_REVERSE, num_ms);
+}
+
+//starts the wheels, notes when to stop, and returns
+//Motion_Process (OS loop) stops the wheels once TA0_tick gets there
+void Start_Timed_Move(char direction, int num_ms){
+  switch(direction){
+    case MOTION_FORWARD:
+      Forward_Move();
+      break;
+    case MOTION_REVERSE:
+      Reverse_Move();
+      break;
+    case MOTION_LEFT:
+      Right_Forward();
+      Left_Reverse();
+      break;
+    case MOTION_RIGHT:
+      Left_Forward();
+      Right_Reverse();
+      break;
+    default:
+      return;
+  }
+  motion_direction = direction;
+  motion_deadline = TA0_tick + num_ms;
+}
+
+void Motion_Process(void){
+  if(motion_direction == MOTION_NONE)
+    return;
+  if((int)(TA0_tick - motion_deadline) < EMPTY)  //signed, so the wrap is fine
+    return;
+  Motion_Stop();
+}
+
+//stop the same way the blocking versions do
+void Motion_Stop(void){
+  if(motion_direction == MOTION_FORWARD)
+    Brake_All();
+  else
+    Motors_Off();
+  motion_direction = MOTION_NONE;
+}
+
+char Motion_Busy(void){
+  return (motion_direction != MOTION_NONE);
 }
 
 //==============================================================================
@@ -262,6 +323,7 @@ void Reverse_Timed(int num_ms){
 // Afterwards, turn right and begin following the line
 void FindLine_Setup(void) {
     foundLine = NO;             //can't find the line before looking for it!
+    Task_Reset(&findLine_task);
     clearDisplay();
     strcpy(display_line[DISPLAY_LINE_1], "Find Line ");
     strcpy(display_line[DISPLAY_LINE_4], "B2 to Menu");
@@ -286,31 +348,59 @@ void FindLine_Process(void){
     break;
     
     case (FINDLINE_FOUND):      //written with project 7 in mind
-      Disable_Emitter();        //don't need this until we start following the line
-      Brake_All();              //stop
-      Turn_Right();              //turn left to align car with circle
-      strcpy(display_line[DISPLAY_LINE_2], "Found Line");
-      findLine_State = FINDLINE_SETUP;  //reset for next time
-      event = FOLLOW_LINE;              //next thing to do
-      delay_100ms(ONE_SECOND);
+      if(FindLine_Found_Task() == TASK_DONE){
+        findLine_State = FINDLINE_SETUP;  //reset for next time
+        event = FOLLOW_LINE;              //next thing to do
+      }
       break;
   }
 
   showRTC200(DISPLAY_LINE_3);   //show the millisecond clock
   if(Check_Button_2()) {
     endEvent();
+    Motion_Stop();
     findLine_State = FINDLINE_SETUP;
   }
 }
 
+//stop, turn to line up with the circle, then sit for a second
+char FindLine_Found_Task(void){
+  TASK_BEGIN(&findLine_task);
+  Disable_Emitter();            //don't need this until we start following the line
+  Brake_All();                  //stop
+  Turn_Right();                 //turn left to align car with circle
+  strcpy(display_line[DISPLAY_LINE_2], "Found Line");
+  TASK_WAIT_UNTIL(&findLine_task, !Motion_Busy());
+  TASK_DELAY(&findLine_task, ONE_SECOND);
+  TASK_END(&findLine_task);
+}
+
 //returns YES if the detector value is at least grey
 //but makes sure the emitter is actually on (if not, everything looks black)
+//pulsed (E1) it's off - on, so white is high, black is low, and a reading
+//near 0 means the emitter isn't lighting anything
 char Detector_On_Line(int detector_value){
+  if(emitter_pulsed)
+    return (detector_value < pulse_white_threshold
+            && detector_value > pulse_on_threshold);
   if(detector_value > white_threshold && detector_value < on_threshold) 
     return YES;
   return NO;
 }
 
+//SpeedAdjust's colors, steady or pulsed (see Detector_On_Line)
+char Detector_White(int detector_value){
+  if(emitter_pulsed)
+    return (detector_value > pulse_white_threshold);
+  return (detector_value < white_threshold);
+}
+
+char Detector_Black(int detector_value){
+  if(emitter_pulsed)
+    return (detector_value < pulse_black_threshold);
+  return (detector_value > black_threshold);
+}
+
 
 
 
@@ -321,15 +411,35 @@ char Detector_On_Line(int detector_value){
 //the car will follow a black line on a white background
 
 void FollowLine_Setup(void){
+  if(FollowLine_Setup_Task() == TASK_DONE)
+    followLine_State = FOLLOWLINE_RUN;
+}
+
+char FollowLine_Setup_Task(void){
+  TASK_BEGIN(&followLine_task);
   if(!foundLine)        //did we come from the FindLine_Process()?
     resetRTC200();      //if not, might as well start RTC200 over
   
   strcpy(display_line[DISPLAY_LINE_1], "Track Line");
   strcpy(display_line[DISPLAY_LINE_4], "B2 to Menu");
   Enable_Emitter();
-  delay_100ms(VHUNDRED_MS);     //delay 500 ms
+  TASK_DELAY(&followLine_task, VHUNDRED_MS);    //delay 500 ms
   Forward_Move();               //start moving forward
-  followLine_State = FOLLOWLINE_RUN; 
+  TASK_END(&followLine_task);
+}
+
+//turn off of the line (followLine_exit_turn), drive in, and park
+char FollowLine_Exit_Task(void){
+  TASK_BEGIN(&followLine_task);
+  if(followLine_exit_turn == MOTION_RIGHT)
+    Turn_Right();
+  else
+    Turn_Left();
+  TASK_WAIT_UNTIL(&followLine_task, !Motion_Busy());
+  Forward_Timed(ONE_SECOND);
+  TASK_WAIT_UNTIL(&followLine_task, !Motion_Busy());
+  Brake_All();
+  TASK_END(&followLine_task);
 }
 
 
@@ -338,18 +448,11 @@ void FollowLine_Setup(void){
 //Display the clock/how much time has passed
 void FollowLine_Process(void){
   char tempChar = get_UCA3_RX();
-  if(tempChar == 'L'){
-    Turn_Left();
-    Forward_Timed(ONE_SECOND);
+  if(followLine_State == FOLLOWLINE_RUN && (tempChar == 'L' || tempChar == 'R')){
     Brake_All();
-    followLine_State = FOLLOWLINE_COMPLETE;
-  }
-  if(tempChar == 'R'){
-    Turn_Right();
-    Forward_Timed(ONE_SECOND);
-    Brake_All();
-    followLine_State = FOLLOWLINE_COMPLETE;
-
+    followLine_exit_turn = (tempChar == 'L') ? MOTION_LEFT : MOTION_RIGHT;
+    Task_Reset(&followLine_task);
+    followLine_State = FOLLOWLINE_INTO_CIRCLE;
   }
   switch(followLine_State){
     case(FOLLOWLINE_SETUP):     //get everything ready to run
@@ -360,15 +463,16 @@ void FollowLine_Process(void){
       SpeedAdjust();                    //adjust speeds to stay on the line
       if(RTC200 >= RTC200_CIRCLE){      //experimentally determine this time
         followLine_State = FOLLOWLINE_INTO_CIRCLE;
+        followLine_exit_turn = MOTION_LEFT;     //this should be the right direction
+        Task_Reset(&followLine_task);
+        runTimer = NO;
         Brake_All();
       }
       break;
       
     case(FOLLOWLINE_INTO_CIRCLE):       //go into the circle
-      Turn_Left();                     //this should be the right direction
-      Forward_Timed(ONE_SECOND);        //go into the circle, actually
-      followLine_State = FOLLOWLINE_COMPLETE;   //indicate completion of the program
-      runTimer = NO;
+      if(FollowLine_Exit_Task() == TASK_DONE)
+        followLine_State = FOLLOWLINE_COMPLETE;   //indicate completion of the program
       break;
       
     case(FOLLOWLINE_COMPLETE):  //do nothing
@@ -379,7 +483,9 @@ void FollowLine_Process(void){
 
   if(Check_Button_2()) {
     endEvent();
+    Motion_Stop();
     Brake_All();
+    Task_Reset(&followLine_task);
     followLine_State = FOLLOWLINE_SETUP;
   }
 }
@@ -395,10 +501,10 @@ void FollowLine_Process(void){
 void SpeedAdjust(void){
   switch(TURN_STATE){
     case NO_TURN:                                       //GOING STRAIGHT
-      if(ADC_Left_Detector < white_threshold){          //left detector sees white
+      if(Detector_White(ADC_Left_Detector)){            //left detector sees white
         TURN_STATE = TURN_RIGHT;                        //time to turn right
       }
-      else if(ADC_Right_Detector < white_threshold){    //right detector sees white
+      else if(Detector_White(ADC_Right_Detector)){      //right detector sees white
         TURN_STATE = TURN_LEFT;                         //time to turn left
       }
       else if(switched_turn_state){                     //just finished turning, reset speed values
@@ -413,11 +519,11 @@ void SpeedAdjust(void){
       if(RIGHT_FORWARD_SPEED >= RIGHT_MAX_SPEED) //bound the speed
         RIGHT_FORWARD_SPEED = RIGHT_MAX_SPEED;
  
-      if(ADC_Right_Detector > black_threshold){  //right detector is back on line
+      if(Detector_Black(ADC_Right_Detector)){    //right detector is back on line
         TURN_STATE = NO_TURN;
         switched_turn_state=YES;
       }
-      if(ADC_Left_Detector < white_threshold){   //left detector sees white also
+      if(Detector_White(ADC_Left_Detector)){     //left detector sees white also
         Brake_Left();
       }
       else{
@@ -432,11 +538,11 @@ void SpeedAdjust(void){
       LEFT_FORWARD_SPEED += SPEED_INCREMENT;    //increase left wheel speed to turn right
       if(LEFT_FORWARD_SPEED >= LEFT_MAX_SPEED)  //bound the speed
         LEFT_FORWARD_SPEED = LEFT_MAX_SPEED;    //this is the fastest allowable speed
-      if(ADC_Left_Detector > black_threshold){  // left detector is back on line
+      if(Detector_Black(ADC_Left_Detector)){    // left detector is back on line
         TURN_STATE = NO_TURN;
         switched_turn_state=YES;
       }
-      if(ADC_Right_Detector < white_threshold){ // right detector sees white also
+      if(Detector_White(ADC_Right_Detector)){   // right detector sees white also
         Brake_Right();                          // right wheel stops entirely in this case
       }
       else{
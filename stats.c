@@ -0,0 +1,216 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      stats.c
+//
+//      keeps score on both serial ports, so when a command goes missing we
+//      can tell whether it was the Wi-Fi, the UART or one of our own buffers
+//
+//      The ISRs count every char in and out, and look at UCAxSTATW for
+//      each char before RXBUF is read (reading RXBUF clears the error flags):
+//              UCOE    overrun - a char came in before the last one was read
+//              UCFE    framing - the stop bit wasn't there (wrong baud, noise)
+//              UCPE    parity  - only if parity is ever turned on
+//      The rings (ring.c) and the frame parser (frames.c) keep their own
+//      score already, this just collects all of it in one place.
+//
+//      Q sends it all back to whoever asked, as one line, every number in hex:
+//
+//      A0 r0123 t0456 o0000 f0000 p0000 v0000 x0000 n0000 h1A A3 ... g0012/0001
+//
+//              r       RX bytes
+//              t       TX bytes (actually sent, by the ISR or the DMA)
+//              o f p   overrun, framing, parity errors
+//              v       RX ring overflows (chars dropped)
+//              x       TX ring overflows (chars dropped + writes turned down)
+//              n       commands with a bad pin
+//              h       most chars ever waiting in the RX ring
+//              g       UCA3 only - TCP frames parsed/rejected
+//      the counters are 16 bits and just roll over
+//
+//      Q1 is how long commands take to start the wheels, from the moment they
+//      got here (the end of the frame, or Enter) to the PWM being set, in
+//      0.1 ms, for each way in (terminal, TCP, UDP), plus the datagrams:
+//
+//      L p0003/0011/0004 t0015/0240/0012 u0014/0030/0100 d0100/0007/0000/0000 z0040/0000
+//
+//              p t u   last/worst/how many moves
+//              d       UDP datagrams run/stale/malformed/bad pin (udp.c)
+//              z       bulk frames sent/received (bulk.c)
+//      a command that had to wait in line behind a movement counts the wait,
+//      so drive with single commands when measuring
+//
+//      global functions
+//              Stats_RX(char port, unsigned int status)        ISR only
+//              Stats_TX(char port, unsigned int count)         ISR only
+//              Stats_Bad_Pin(char port)
+//              Start_Stats_Reply(char source, char cid, char page)
+//              Stats_Latency(char via, unsigned long arrival)
+//              put_Stat(char* line, unsigned int index, char label,
+//                       unsigned int value, char digits)
+//
+//      local functions
+//              Stats_Reply_Task(void)            a task (see timerMacros.h)
+//              Stats_Line(char* line)
+//              Stats_Port(char* line, unsigned int index, char port)
+//              Latency_Line(char* line)
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include  "functions.h"
+
+char Stats_Reply_Task(void);
+unsigned int Stats_Line(char* line);
+unsigned int Stats_Port(char* line, unsigned int index, char port);
+unsigned int Latency_Line(char* line);
+
+Port_Stats port_stats[NUM_STATS_PORTS];         //STATS_UCAx picks one
+Latency latency[NUM_VIAS];                      //VIA_xxx picks one
+const char latency_labels[NUM_VIAS] = {'p', 't', 'u'};
+const char hex_digits[] = "0123456789ABCDEF";
+
+char stats_line[STATS_LINE_LENGTH];
+unsigned int stats_length = COUNT_RESET;
+char stats_source = COMMAND_SOURCE_PC;          //who gets the reply
+char stats_cid = TCP_NO_CID;
+char stats_page = STATS_PAGE_PORTS;
+Task stats_task;
+
+
+
+//==============================================================================
+//one char came in, status is UCAxSTATW from before RXBUF was read
+void Stats_RX(char port, unsigned int status){
+  Port_Stats* stats = &port_stats[(unsigned char)port];
+  stats->rx_bytes++;
+  if(status & UCOE)
+    stats->overruns++;
+  if(status & UCFE)
+    stats->framing++;
+  if(status & UCPE)
+    stats->parity++;
+}
+
+//count chars went out (1 from the TX ISR, a whole chunk from the DMA)
+void Stats_TX(char port, unsigned int count){
+  port_stats[(unsigned char)port].tx_bytes += count;
+}
+
+//a command showed up with the wrong pin
+void Stats_Bad_Pin(char port){
+  port_stats[(unsigned char)port].bad_pins++;
+}
+
+//a command that came in at arrival (Timer_Now()) just started the wheels
+void Stats_Latency(char via, unsigned long arrival){
+  Latency* l = &latency[(unsigned char)via];
+  unsigned long units = Timer_Since(arrival) / LATENCY_COUNTS_PER_UNIT;
+  if(units > LATENCY_MAX_UNITS)
+    units = LATENCY_MAX_UNITS;
+  l->last = units;
+  if(l->last > l->max)
+    l->max = l->last;
+  l->count++;
+}
+
+
+//==============================================================================
+//Q - the line is built right away, then the command queue waits until
+//it's been sent (or there's been no room for STATS_REPLY_TIMEOUT)
+void Start_Stats_Reply(char source, char cid, char page){
+  stats_source = source;
+  stats_cid = cid;
+  stats_page = page;
+  Task_Reset(&stats_task);
+  Start_Command_Task(Stats_Reply_Task);
+}
+
+char Stats_Reply_Task(void){
+  TASK_BEGIN(&stats_task);
+  if(stats_page == STATS_PAGE_LATENCY)
+    stats_length = Latency_Line(stats_line);
+  else
+    stats_length = Stats_Line(stats_line);
+  stats_task.deadline = TA0_tick + STATS_REPLY_TIMEOUT;
+  TASK_WAIT_UNTIL(&stats_task, Command_Reply(stats_source, stats_cid, stats_line, stats_length)
+                               || Task_Time_Up(&stats_task));
+  TASK_END(&stats_task);
+}
+
+//both ports, returns the length (no NUL needed, Command_Reply takes a length)
+unsigned int Stats_Line(char* line){
+  unsigned int index;
+  index = Stats_Port(line, COUNT_RESET, STATS_UCA0);
+  line[index++] = ' ';
+  index = Stats_Port(line, index, STATS_UCA3);
+  index = put_Stat(line, index, 'g', frames_parsed, STAT_DIGITS);
+  line[index++] = '/';
+  index = put_Stat(line, index, EMPTY, frames_rejected, STAT_DIGITS);
+  line[index++] = RETURN_CHAR;
+  line[index++] = NEW_LINE_CHAR;
+  return index;
+}
+
+//one port's worth, starting at line[index]
+unsigned int Stats_Port(char* line, unsigned int index, char port){
+  Port_Stats* stats = &port_stats[(unsigned char)port];
+  Ring* rx = (port == STATS_UCA0) ? &UCA0_Rx_Ring : &UCA3_Rx_Ring;
+  Ring* tx = (port == STATS_UCA0) ? &UCA0_Tx_Ring : &UCA3_Tx_Ring;
+  line[index++] = 'A';
+  line[index++] = (port == STATS_UCA0) ? '0' : '3';
+  index = put_Stat(line, index, 'r', stats->rx_bytes, STAT_DIGITS);
+  index = put_Stat(line, index, 't', stats->tx_bytes, STAT_DIGITS);
+  index = put_Stat(line, index, 'o', stats->overruns, STAT_DIGITS);
+  index = put_Stat(line, index, 'f', stats->framing, STAT_DIGITS);
+  index = put_Stat(line, index, 'p', stats->parity, STAT_DIGITS);
+  index = put_Stat(line, index, 'v', rx->dropped, STAT_DIGITS);
+  index = put_Stat(line, index, 'x', tx->dropped + tx->rejected, STAT_DIGITS);
+  index = put_Stat(line, index, 'n', stats->bad_pins, STAT_DIGITS);
+  index = put_Stat(line, index, 'h', rx->high_water, STAT_SHORT_DIGITS);
+  return index;
+}
+
+//Q1, returns the length
+unsigned int Latency_Line(char* line){
+  unsigned int index = COUNT_RESET;
+  char via;
+  line[index++] = 'L';
+  for(via=COUNT_RESET; via<NUM_VIAS; via++){
+    index = put_Stat(line, index, latency_labels[(unsigned char)via],
+                     latency[(unsigned char)via].last, STAT_DIGITS);
+    line[index++] = '/';
+    index = put_Stat(line, index, EMPTY, latency[(unsigned char)via].max, STAT_DIGITS);
+    line[index++] = '/';
+    index = put_Stat(line, index, EMPTY, latency[(unsigned char)via].count, STAT_DIGITS);
+  }
+  index = put_Stat(line, index, 'd', datagrams_accepted, STAT_DIGITS);
+  line[index++] = '/';
+  index = put_Stat(line, index, EMPTY, datagrams_stale, STAT_DIGITS);
+  line[index++] = '/';
+  index = put_Stat(line, index, EMPTY, datagrams_malformed, STAT_DIGITS);
+  line[index++] = '/';
+  index = put_Stat(line, index, EMPTY, datagrams_bad_pin, STAT_DIGITS);
+  index = put_Stat(line, index, 'z', bulk_frames_sent, STAT_DIGITS);
+  line[index++] = '/';
+  index = put_Stat(line, index, EMPTY, bulk_frames_received, STAT_DIGITS);
+  line[index++] = RETURN_CHAR;
+  line[index++] = NEW_LINE_CHAR;
+  return index;
+}
+
+//" <label><value>", the value in hex, always digits wide
+//an EMPTY label means no space and no label (for a/b pairs)
+unsigned int put_Stat(char* line, unsigned int index, char label,
+                      unsigned int value, char digits){
+  char digit;
+  if(label != EMPTY){
+    line[index++] = ' ';
+    line[index++] = label;
+  }
+  for(digit=digits; digit>COUNT_RESET; digit--){        //lowest digit goes last
+    line[index + digit - ADJUST_1] = hex_digits[value & HEX_DIGIT_MASK];
+    value >>= BITS_PER_HEX_DIGIT;
+  }
+  return index + digits;
+}
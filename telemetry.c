@@ -0,0 +1,192 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      telemetry.c
+//
+//      streams what the car is thinking, so line following can be tuned
+//      from a terminal instead of squinting at four 10 char LCD lines
+//
+//      Every telemetry_period (in 100ms ticks, 0 = off) a binary frame is
+//      packed and queued on the ports in telemetry_ports:
+//
+//              byte 0          TELEMETRY_MARKER
+//              byte 1          sequence number (counts up, a gap = a lost frame)
+//              byte 2-3        ADC_Left_Detector
+//              byte 4-5        ADC_Right_Detector
+//              byte 6-7        ADC_Thumb
+//              byte 8-15       TB0CCR3-6 (L reverse, L forward, R reverse, R forward)
+//              byte 16         TURN_STATE
+//              byte 17         followLine_State
+//              byte 18-19      RTC200
+//              byte 20-21      supply (AVCC) in mV, 0 until the first reading
+//              byte 22-23      ADC_Temperature (raw, 2.5V reference)
+//              byte 24-25      CRC-16/CCITT of bytes 0-23 (same one as commands.c)
+//      every 16 bit value goes low byte first
+//
+//      UCA3 frames go to every TCP client that turned telemetry on (P<n> from
+//      that client, see session.c), as bulk frames (<ESC>Z<cid>0026...,
+//      bulk.c), so a 0x1B 'E' in the data can't cut a frame short.  The
+//      payload goes straight out of telemetry_frame, one client at a time,
+//      so a new frame isn't packed until every client has had the last one.
+//      UCA0 frames only go out once the PC has talked.
+//
+//      Telemetry never gets in the way of command responses:
+//              each port has a byte budget that refills every tick
+//              a frame only goes out if it leaves TELEMETRY_TX_RESERVE bytes free
+//              in the TX ring
+//      a frame that can't go out is skipped (and counted), never half sent.
+//
+//      global functions
+//              Telemetry_Process(void)
+//              Set_Telemetry_Period(unsigned int ticks)
+//              Set_Telemetry_Ports(char ports)
+//
+//      local functions
+//              Pack_Telemetry(char* frame)
+//              put_Telemetry_Int(char* frame, unsigned int index, unsigned int value)
+//              Send_Telemetry_UCA0(void)
+//              Send_Telemetry_Clients(void)
+//              Refill_Telemetry_Budget(void)
+//
+//==============================================================================
+#include "macros.h"
+#include  "msp430.h"
+#include  "functions.h"
+#include <string.h>
+
+void Pack_Telemetry(char* frame);
+void put_Telemetry_Int(char* frame, unsigned int index, unsigned int value);
+void Send_Telemetry_UCA0(void);
+void Send_Telemetry_Clients(void);
+void Refill_Telemetry_Budget(void);
+
+unsigned int telemetry_period = TELEMETRY_DEFAULT_PERIOD;       //0 = off
+char telemetry_ports = TELEMETRY_DEFAULT_PORTS;                 //TELEMETRY_UCAx bits
+unsigned int telemetry_next = COUNT_RESET;      //TA0_tick for the next frame
+unsigned int telemetry_refilled = COUNT_RESET;  //TA0_tick of the last budget refill
+unsigned int telemetry_budget[NUM_TELEMETRY_PORTS];     //bytes each port can still use
+unsigned char telemetry_seq = COUNT_RESET;
+unsigned int telemetry_sent    = COUNT_RESET;
+unsigned int telemetry_skipped = COUNT_RESET;   //no budget or no room
+unsigned int telemetry_client = MAX_TCP_SESSIONS;       //next tcp_sessions[] to get the frame
+
+char telemetry_frame[TELEMETRY_FRAME_LENGTH];   //UCA3 sends it from right here
+
+
+
+//==============================================================================
+//runs in the OS loop
+void Telemetry_Process(void){
+  Refill_Telemetry_Budget();
+  Send_Telemetry_Clients();                     //the last frame, if it isn't done
+  if(!telemetry_period)                         //off
+    return;
+  if((int)(TA0_tick - telemetry_next) < EMPTY)  //not yet
+    return;
+  telemetry_next = TA0_tick + telemetry_period;
+  if(telemetry_client < MAX_TCP_SESSIONS || Bulk_Busy()){      //still sending from
+    telemetry_skipped++;                                        //telemetry_frame
+    return;
+  }
+
+  Pack_Telemetry(telemetry_frame);
+  telemetry_seq++;
+  if(telemetry_ports & TELEMETRY_UCA0)
+    Send_Telemetry_UCA0();
+  if(telemetry_ports & TELEMETRY_UCA3){
+    telemetry_client = COUNT_RESET;             //go around the clients again
+    Send_Telemetry_Clients();
+  }
+}
+
+//ticks between frames, 0 turns it off
+void Set_Telemetry_Period(unsigned int ticks){
+  telemetry_period = ticks;
+  telemetry_next = TA0_tick;                    //start right away
+}
+
+//TELEMETRY_UCA0 and/or TELEMETRY_UCA3
+void Set_Telemetry_Ports(char ports){
+  telemetry_ports = ports & TELEMETRY_ALL_PORTS;
+}
+
+
+//==============================================================================
+//take a snapshot of everything
+void Pack_Telemetry(char* frame){
+  frame[TELEMETRY_MARKER_INDEX] = TELEMETRY_MARKER;
+  frame[TELEMETRY_SEQ_INDEX] = telemetry_seq;
+  put_Telemetry_Int(frame, TELEMETRY_LEFT_INDEX,  ADC_Left_Detector);
+  put_Telemetry_Int(frame, TELEMETRY_RIGHT_INDEX, ADC_Right_Detector);
+  put_Telemetry_Int(frame, TELEMETRY_THUMB_INDEX, ADC_Thumb);
+  put_Telemetry_Int(frame, TELEMETRY_PWM_INDEX,   LEFT_REVERSE_SPEED);
+  put_Telemetry_Int(frame, TELEMETRY_PWM_INDEX + TELEMETRY_INT_SIZE,   LEFT_FORWARD_SPEED);
+  put_Telemetry_Int(frame, TELEMETRY_PWM_INDEX + TELEMETRY_INT_SIZE*2, RIGHT_REVERSE_SPEED);
+  put_Telemetry_Int(frame, TELEMETRY_PWM_INDEX + TELEMETRY_INT_SIZE*3, RIGHT_FORWARD_SPEED);
+  frame[TELEMETRY_TURN_INDEX] = TURN_STATE;
+  frame[TELEMETRY_FOLLOW_INDEX] = followLine_State;
+  put_Telemetry_Int(frame, TELEMETRY_RTC_INDEX, RTC200);
+  put_Telemetry_Int(frame, TELEMETRY_SUPPLY_INDEX, supply_mv);
+  put_Telemetry_Int(frame, TELEMETRY_TEMPERATURE_INDEX, ADC_Temperature);
+  put_Telemetry_Int(frame, TELEMETRY_CRC_INDEX, CRC16(frame, TELEMETRY_CRC_INDEX));
+}
+
+//low byte first
+void put_Telemetry_Int(char* frame, unsigned int index, unsigned int value){
+  frame[index] = (char)value;
+  frame[index + ADJUST_1] = (char)(value >> REMOVE_LOWER_8BITS);
+}
+
+//queue the frame on UCA0 if the budget and the TX ring can take it
+void Send_Telemetry_UCA0(void){
+  if(!PC_TX_Enable)                             //the PC hasn't talked yet
+    return;
+  if(telemetry_budget[TELEMETRY_PORT_UCA0] < TELEMETRY_FRAME_LENGTH
+     || ring_Space(&UCA0_Tx_Ring) < TELEMETRY_FRAME_LENGTH + TELEMETRY_TX_RESERVE
+     || !write_All_UCA0(telemetry_frame, TELEMETRY_FRAME_LENGTH)){
+    telemetry_skipped++;
+    return;
+  }
+  telemetry_budget[TELEMETRY_PORT_UCA0] -= TELEMETRY_FRAME_LENGTH;
+  telemetry_sent++;
+}
+
+//UCA3 - one bulk frame per client that wants one, as fast as bulk.c takes them
+//picks up where it left off every pass of the OS loop
+void Send_Telemetry_Clients(void){
+  Session* session;
+  while(telemetry_client < MAX_TCP_SESSIONS){
+    if(Bulk_Busy())                             //the last client's is still going
+      return;
+    session = &tcp_sessions[telemetry_client];
+    telemetry_client++;
+    if(session->cid == TCP_NO_CID || !session->telemetry)
+      continue;
+    if(telemetry_budget[TELEMETRY_PORT_UCA3] < BULK_HEADER_LENGTH + TELEMETRY_FRAME_LENGTH
+       || ring_Space(&UCA3_Tx_Ring) < BULK_HEADER_LENGTH + TELEMETRY_TX_RESERVE
+       || !Bulk_Send(session->cid, telemetry_frame, TELEMETRY_FRAME_LENGTH)){
+      telemetry_skipped++;
+      continue;
+    }
+    telemetry_budget[TELEMETRY_PORT_UCA3] -= BULK_HEADER_LENGTH + TELEMETRY_FRAME_LENGTH;
+    telemetry_sent++;
+  }
+}
+
+//every tick each port gets TELEMETRY_BUDGET_PER_TICK more bytes, up to a max
+void Refill_Telemetry_Budget(void){
+  unsigned int ticks = TA0_tick - telemetry_refilled;
+  unsigned int add;
+  char port;
+  if(!ticks)
+    return;
+  telemetry_refilled += ticks;
+  if(ticks > TELEMETRY_BUDGET_MAX)              //been a while, don't overflow
+    ticks = TELEMETRY_BUDGET_MAX;
+  add = ticks * TELEMETRY_BUDGET_PER_TICK;
+  for(port=COUNT_RESET; port<NUM_TELEMETRY_PORTS; port++){
+    telemetry_budget[(unsigned char)port] += add;
+    if(telemetry_budget[(unsigned char)port] > TELEMETRY_BUDGET_MAX)
+      telemetry_budget[(unsigned char)port] = TELEMETRY_BUDGET_MAX;
+  }
+}
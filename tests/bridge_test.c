@@ -0,0 +1,282 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      bridge_test.c
+//
+//      host throughput test for the PC <-> IOT bridge (bridge.c)
+//      bridge.c and ring.c are the real ones, the two UARTs are played by
+//      this file
+//
+//      from the top of the repo:
+//              gcc -O2 -I. -Itests tests/bridge_test.c bridge.c ring.c -o bridge_test && ./bridge_test
+//
+//      Both ends talk flat out at the same time, STREAM_CHARS each way.  A
+//      char from the PC lands every 10 bit times at pc_baud and goes through
+//      Bridge_UCA0_Char like the UCA0 RX ISR does it, one from the module
+//      the same at module_baud through Bridge_UCA3_Char.  The TX side of
+//      each port takes a char off its ring every 10 bit times of its own
+//      rate (what the DMA or the TX ISR does).  Everything is in simulated
+//      time, in ns, so host speed doesn't matter.
+//
+//      For each pair of rates it prints how many chars got through and
+//      were dropped each way, and the rate they came out the other side.
+//      The data is every byte value in turn, so single Ctrl-]s go through
+//      (they only count three in a row).
+//
+//      The old way (Project8_Process, one char from the UCA0 RX ring to
+//      the UCA3 TX ring per OS loop pass) is run the PC -> module way too.
+//
+//      then the escape sequence:  bridge_exit goes up on exactly the
+//      BRIDGE_ESCAPE_COUNT'th Ctrl-] in a row and not before, anything in
+//      between starts the count over, and Bridge_Process takes it down
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <string.h>
+#include "macros.h"
+
+#define STREAM_CHARS            (100000UL)
+#define BITS_PER_CHAR           (10)            //start, 8 data, stop
+#define NS_PER_SECOND           (1000000000ULL)
+#define OLD_LOOP_NS             (1000000ULL)    //one OS loop pass, 1 ms
+
+typedef struct {
+  unsigned long pc;
+  unsigned long module;
+} Rates;
+
+const Rates rates[] = {{BAUD115200, BAUD115200}, {BAUD460800, BAUD460800},
+                       {BAUD921600, BAUD921600}, {BAUD115200, BAUD460800}};
+#define NUM_RATES               (sizeof(rates) / sizeof(rates[0]))
+
+//what the rest of the car would have given bridge.c
+Ring UCA0_Tx_Ring;
+Ring UCA3_Tx_Ring;
+Ring UCA0_Rx_Ring;                              //the old way only
+char display_line[NUM_DISPLAY_LINES][NUM_DISPLAY_CHARS];
+char button_2 = NO;
+unsigned int events_ended = COUNT_RESET;
+char Check_Button_2(void){ return button_2; }
+void endEvent(void){ events_ended++; }
+void clearDisplay(void){}
+void StartTransmit_UCA0(void){}                 //the drains below are always on
+void StartTransmit_UCA3(void){}
+
+extern volatile char bridge_exit;               //bridge.c
+extern volatile char bridge_escape_count;
+
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//one direction: chars arrive at one rate, drain at the other
+typedef struct {
+  unsigned long long next_in;           //ns, when the next char lands
+  unsigned long long next_out;          //ns, when the TX side is free again
+  unsigned long long char_in;           //ns per char
+  unsigned long long char_out;
+  unsigned long sent;                   //into the RX side
+  unsigned long came_out;               //out of the TX side
+  unsigned long wrong;                  //came out, but not the char it should be
+  unsigned long long last_out;          //ns, the last char out
+  Ring* ring;                           //the TX ring it goes through
+  unsigned int dropped;                 //when it was over
+} Direction;
+
+unsigned long long Char_NS(unsigned long baud){
+  return BITS_PER_CHAR * NS_PER_SECOND / baud;
+}
+
+char Stream_Char(unsigned long n){
+  return (char)(n & 0xFF);
+}
+
+void Init_Direction(Direction* d, Ring* ring, unsigned long in, unsigned long out){
+  memset(d, 0, sizeof(*d));
+  d->ring = ring;
+  d->char_in = Char_NS(in);
+  d->char_out = Char_NS(out);
+  clear_Ring(ring);
+  ring->dropped = COUNT_RESET;
+}
+
+//the TX side takes a char if it's free and there is one
+//and checks it against the stream, as long as nothing has been dropped
+void Drain(Direction* d, unsigned long long now){
+  char c;
+  if(now < d->next_out || !get_Ring_Char(d->ring, &c))
+    return;
+  if(c != Stream_Char(d->came_out + d->ring->dropped) && !d->ring->dropped)
+    d->wrong++;
+  d->came_out++;
+  d->last_out = now + d->char_out;
+  d->next_out = now + d->char_out;
+}
+
+//the next thing that happens after now (one that's already passed doesn't count)
+unsigned long long Earliest(unsigned long long now, unsigned long long a,
+                            unsigned long long b){
+  if(a <= now)
+    return b;
+  if(b <= now)
+    return a;
+  return a < b ? a : b;
+}
+
+//both ways at once, flat out
+void Run_Bridge(const Rates* r, Direction* to_module, Direction* to_pc){
+  unsigned long long now = COUNT_RESET;
+  unsigned long long next;
+  Init_Direction(to_module, &UCA3_Tx_Ring, r->pc, r->module);
+  Init_Direction(to_pc, &UCA0_Tx_Ring, r->module, r->pc);
+  bridge_escape_count = COUNT_RESET;
+  bridge_exit = NO;
+  while(to_module->sent < STREAM_CHARS || to_pc->sent < STREAM_CHARS
+        || ring_Count(&UCA3_Tx_Ring) || ring_Count(&UCA0_Tx_Ring)){
+    if(to_module->sent < STREAM_CHARS && to_module->next_in <= now){
+      Bridge_UCA0_Char(Stream_Char(to_module->sent++));
+      to_module->next_in += to_module->char_in;
+    }
+    if(to_pc->sent < STREAM_CHARS && to_pc->next_in <= now){
+      Bridge_UCA3_Char(Stream_Char(to_pc->sent++));
+      to_pc->next_in += to_pc->char_in;
+    }
+    Drain(to_module, now);
+    Drain(to_pc, now);
+    next = Earliest(now, to_module->next_out, to_pc->next_out);
+    if(to_module->sent < STREAM_CHARS)
+      next = Earliest(now, next, to_module->next_in);
+    if(to_pc->sent < STREAM_CHARS)
+      next = Earliest(now, next, to_pc->next_in);
+    now = next > now ? next : now + ADJUST_1;
+  }
+  to_module->dropped = UCA3_Tx_Ring.dropped;
+  to_pc->dropped = UCA0_Tx_Ring.dropped;
+}
+
+//Project8_Process: one char a pass, UCA0 RX ring to UCA3 TX ring
+void Run_Old(const Rates* r, Direction* d){
+  unsigned long long now = COUNT_RESET;
+  unsigned long long next_pass = OLD_LOOP_NS;
+  unsigned long long next;
+  char c;
+  Init_Direction(d, &UCA3_Tx_Ring, r->pc, r->module);
+  clear_Ring(&UCA0_Rx_Ring);
+  UCA0_Rx_Ring.dropped = COUNT_RESET;
+  while(d->sent < STREAM_CHARS || ring_Count(&UCA0_Rx_Ring) || ring_Count(&UCA3_Tx_Ring)){
+    if(d->sent < STREAM_CHARS && d->next_in <= now){
+      put_Ring_Char(&UCA0_Rx_Ring, Stream_Char(d->sent++));
+      d->next_in += d->char_in;
+    }
+    if(next_pass <= now){
+      if(get_Ring_Char(&UCA0_Rx_Ring, &c))
+        put_Ring_Char(&UCA3_Tx_Ring, c);
+      next_pass += OLD_LOOP_NS;
+    }
+    Drain(d, now);
+    next = Earliest(now, d->next_out, next_pass);
+    if(d->sent < STREAM_CHARS)
+      next = Earliest(now, next, d->next_in);
+    now = next > now ? next : now + ADJUST_1;
+  }
+  d->dropped = UCA0_Rx_Ring.dropped + UCA3_Tx_Ring.dropped;     //in or out
+}
+
+double Rate(const Direction* d){
+  return d->last_out ? (double)d->came_out * NS_PER_SECOND / d->last_out : 0;
+}
+
+//==============================================================================
+void Test_Throughput(void){
+  Direction to_module;
+  Direction to_pc;
+  Direction old;
+  unsigned int i;
+  const Rates* r;
+
+  printf("%lu chars each way at once, chars/s out the other side (dropped)\n",
+         STREAM_CHARS);
+  printf("%8s %8s  %20s %20s %20s\n", "PC", "module", "PC -> module",
+         "module -> PC", "old PC -> module");
+  for(i=COUNT_RESET; i<NUM_RATES; i++){
+    r = &rates[i];
+    Run_Bridge(r, &to_module, &to_pc);
+    CHECK(!bridge_exit);                        //single Ctrl-]s don't count
+    Run_Old(r, &old);
+    printf("%8lu %8lu  %11.0f (%6u) %11.0f (%6u) %11.0f (%6u)\n", r->pc, r->module,
+           Rate(&to_module), to_module.dropped, Rate(&to_pc), to_pc.dropped,
+           Rate(&old), old.dropped);
+    CHECK(to_module.came_out + to_module.dropped == STREAM_CHARS);
+    CHECK(to_pc.came_out + to_pc.dropped == STREAM_CHARS);
+    CHECK(old.came_out + old.dropped == STREAM_CHARS);
+    CHECK(to_module.wrong == EMPTY);
+    CHECK(to_pc.wrong == EMPTY);
+    if(r->pc == r->module){                     //keeps up with the line both ways
+      CHECK(to_module.dropped == EMPTY);
+      CHECK(to_pc.dropped == EMPTY);
+      CHECK(Rate(&to_module) > 0.99 * r->pc / BITS_PER_CHAR);
+      CHECK(Rate(&to_pc) > 0.99 * r->module / BITS_PER_CHAR);
+      CHECK(old.dropped > EMPTY);               //what user-016 was about
+    }
+    else{                                       //the documented catch:
+      CHECK(to_module.dropped == EMPTY);        //slow into fast is fine,
+      CHECK(to_pc.dropped > EMPTY);             //fast into slow can't be
+    }
+  }
+}
+
+//Ctrl-] three in a row, exactly
+void Test_Escape(void){
+  unsigned int i;
+  Bridge_Process();                             //the menu event starts it
+  CHECK(bridge_active);
+  for(i=COUNT_RESET; i<BRIDGE_ESCAPE_COUNT; i++)       //from the module they're
+    Bridge_UCA3_Char(BRIDGE_ESCAPE_CHAR);               //just chars
+  CHECK(!bridge_exit);
+  clear_Ring(&UCA3_Tx_Ring);
+
+  Bridge_UCA0_Char(BRIDGE_ESCAPE_CHAR);         //two, then something else
+  Bridge_UCA0_Char(BRIDGE_ESCAPE_CHAR);
+  CHECK(!bridge_exit);
+  Bridge_UCA0_Char('x');
+  for(i=ADJUST_1; i<BRIDGE_ESCAPE_COUNT; i++){  //the count started over
+    Bridge_UCA0_Char(BRIDGE_ESCAPE_CHAR);
+    CHECK(!bridge_exit);
+  }
+  Bridge_UCA0_Char(BRIDGE_ESCAPE_CHAR);         //that's the one
+  CHECK(bridge_exit);
+  CHECK(ring_Count(&UCA3_Tx_Ring) == 3 + BRIDGE_ESCAPE_COUNT);  //they're passed on
+
+  events_ended = COUNT_RESET;                   //and the menu event takes it down
+  Bridge_Process();
+  CHECK(!bridge_active);
+  CHECK(!bridge_exit);
+  CHECK(events_ended == 1);
+
+  Bridge_Process();                             //the next time it comes back up
+  CHECK(bridge_active);
+  CHECK(bridge_escape_count == EMPTY);
+  CHECK(events_ended == 1);
+  button_2 = YES;                               //button 2 works too
+  Bridge_Process();
+  CHECK(!bridge_active);
+  CHECK(events_ended == 2);
+  button_2 = NO;
+}
+
+//==============================================================================
+int main(void){
+  Test_Throughput();
+  Test_Escape();
+  if(failures){
+    printf("bridge_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("bridge_test: passed\n");
+  return 0;
+}
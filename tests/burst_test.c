@@ -0,0 +1,263 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      burst_test.c
+//
+//      host benchmark for the RX side of IOT_Communication: a burst of
+//      commands comes in back to back, how many of them make it?
+//      ring.c, frames.c and assembler.c are the real ones, the ISRs and the
+//      main loop are played by this file
+//
+//      from the top of the repo:
+//              gcc -O2 -I. -Itests tests/burst_test.c ring.c frames.c assembler.c -o burst_test && ./burst_test
+//
+//      A char lands every 10 bit times (8N1).  The main loop gets to the
+//      serial ports once a pass, and a pass takes loops[] us (the display
+//      and the menu events are most of that).  Two ways of reading:
+//
+//      old     the 50 slot ring from before ring.c, 0x00 for empty, the ISR
+//              writes over whatever is there, one char per port per pass,
+//              and the frames are picked apart in the main loop
+//      new     what IOT_Communication does now: the terminal's 128 char
+//              ring is emptied span by span every pass, and the UCA3 ISR
+//              splits frames into the NUM_FRAME_SLOTS slots itself, every
+//              finished frame is taken every pass
+//
+//      terminal commands are ^1234F0nnn\r, TCP ones <ESC>S0^1234F0nnn<ESC>E,
+//      every one different, so a command only counts if it comes out of
+//      the assembler exactly as it went in.  Host numbers for the loop
+//      itself don't matter, it's all in simulated time.
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <string.h>
+#include "macros.h"
+
+#define BURST_COMMANDS          (100)
+#define OLD_RING_SIZE           (50)            //SMALL_RING_SIZE before ring.c
+#define BITS_PER_CHAR           (10)            //start, 8 data, stop
+#define MICROSECONDS            (1000000UL)
+#define BURST_MAX               (BURST_COMMANDS * 20)
+#define PATH_PC                 (0)
+#define PATH_TCP                (1)
+#define WAY_OLD                 (0)
+#define WAY_NEW                 (1)
+
+const unsigned long bauds[] = {9600, 115200, 460800};
+const unsigned long loops[] = {1000, 5000};     //one pass of the main loop, us
+#define NUM_BAUDS               (sizeof(bauds) / sizeof(bauds[0]))
+#define NUM_LOOPS               (sizeof(loops) / sizeof(loops[0]))
+
+//what the rest of the car would have given ring.c/frames.c/assembler.c
+Ring UCA0_Rx_Ring;
+Ring UCA3_Rx_Ring;
+volatile unsigned int bulk_frames_received = COUNT_RESET;
+unsigned long Timer_Now(void){ return COUNT_RESET; }
+
+char received[BURST_COMMANDS];                  //which ones came out right
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//the end of the line, a command out of an assembler
+void Make_Command(char* command, int n){
+  sprintf(command, "^1234F0%03d", n);
+}
+
+void Execute_Command(char* command, char source, char cid){
+  char expected[COMMAND_MAX_LENGTH];
+  int n;
+  (void)source;                                 //one path per run, it's known
+  (void)cid;
+  if(sscanf(command, "^1234F0%3d", &n) != 1 || n < 0 || n >= BURST_COMMANDS)
+    return;
+  Make_Command(expected, n);
+  if(!strcmp(command, expected))
+    received[n] = YES;
+}
+
+int Received(void){
+  int count = COUNT_RESET;
+  int i;
+  for(i=COUNT_RESET; i<BURST_COMMANDS; i++)
+    count += received[i];
+  return count;
+}
+
+//the whole burst, as chars on the wire
+unsigned int Make_Burst(char* burst, char path){
+  char command[COMMAND_MAX_LENGTH];
+  unsigned int length = COUNT_RESET;
+  int i;
+  for(i=COUNT_RESET; i<BURST_COMMANDS; i++){
+    Make_Command(command, i);
+    if(path == PATH_TCP){
+      burst[length++] = TCP_ESCAPE_CHAR;
+      burst[length++] = TCP_START_CHAR;
+      burst[length++] = '0';
+    }
+    strcpy(&burst[length], command);
+    length += strlen(command);
+    if(path == PATH_TCP){
+      burst[length++] = TCP_ESCAPE_CHAR;
+      burst[length++] = TCP_END_CHAR;
+    }
+    else
+      burst[length++] = RETURN_CHAR;
+  }
+  return length;
+}
+
+//==============================================================================
+//the old ring, copied from the serial.c/interrupts_serial.c before ring.c
+volatile char old_ring[OLD_RING_SIZE];
+unsigned int old_wr = COUNT_RESET;
+unsigned int old_rd = COUNT_RESET;
+
+void Old_ISR(char c){
+  old_ring[old_wr] = c;                         //no check, it writes over
+  old_wr++;
+  if(old_wr >= OLD_RING_SIZE)
+    old_wr = COUNT_RESET;
+}
+
+char Old_Get(void){
+  char myChar = old_ring[old_rd];
+  if(myChar == EMPTY)   return EMPTY;
+  old_ring[old_rd] = EMPTY;
+  old_rd++;
+  if(old_rd >= OLD_RING_SIZE)
+    old_rd = COUNT_RESET;
+  return myChar;
+}
+
+//==============================================================================
+//a finished frame goes to the client's assembler, like Session_Frame
+void Take_Frames(Assembler* a){
+  Frame* frame;
+  unsigned int i;
+  while((frame = get_Frame())){
+    for(i=COUNT_RESET; i<frame->length; i++)
+      Assembler_Char(a, frame->data[i]);
+    Assembler_End_Of_Frame(a);
+    release_Frame();
+  }
+}
+
+//one pass of the main loop's serial part
+void Loop_Pass(Assembler* a, char path, char way){
+  volatile char* span;
+  unsigned int span_length;
+  unsigned int i;
+  char c;
+  if(way == WAY_OLD){                           //one char, wherever it goes
+    c = Old_Get();
+    if(!c)
+      return;
+    if(path == PATH_TCP){
+      Frame_RX_Char(c);
+      Take_Frames(a);
+    }
+    else
+      Assembler_Char(a, c);
+    return;
+  }
+  if(path == PATH_TCP){                         //the ISR did the frames already
+    Take_Frames(a);
+    return;
+  }
+  while((span_length = ring_Read_Span(&UCA0_Rx_Ring, &span))){
+    for(i=COUNT_RESET; i<span_length; i++)
+      Assembler_Char(a, span[i]);
+    ring_Read_Commit(&UCA0_Rx_Ring, span_length);
+  }
+}
+
+void RX_ISR(char c, char path, char way){
+  if(way == WAY_OLD)
+    Old_ISR(c);
+  else if(path == PATH_TCP)
+    Frame_RX_Char(c);
+  else
+    put_Ring_Char(&UCA0_Rx_Ring, c);
+}
+
+//send the burst at baud, with the main loop taking loop_us a pass
+int Run(char path, char way, unsigned long baud, unsigned long loop_us){
+  char burst[BURST_MAX];
+  unsigned int length = Make_Burst(burst, path);
+  unsigned int sent = COUNT_RESET;
+  unsigned long next_pass = loop_us;
+  unsigned long next_char = COUNT_RESET;
+  unsigned long char_us_x1000 = BITS_PER_CHAR * MICROSECONDS * 1000UL / baud;
+  unsigned long idle = COUNT_RESET;
+  Assembler a;
+
+  memset(received, NO, sizeof(received));
+  memset((void*)old_ring, EMPTY, sizeof(old_ring));
+  old_wr = COUNT_RESET;
+  old_rd = COUNT_RESET;
+  clear_Ring(&UCA0_Rx_Ring);
+  Frame_RX_Char(TCP_ESCAPE_CHAR);               //leave whatever frame was open
+  Frame_RX_Char(TCP_END_CHAR);
+  clear_Frames();
+  clear_Ring(&UCA3_Rx_Ring);
+  Init_Assembler(&a, path == PATH_TCP ? COMMAND_SOURCE_TCP : COMMAND_SOURCE_PC,
+                 path == PATH_TCP ? '0' : TCP_NO_CID, path == PATH_PC);
+
+  while(idle < OLD_RING_SIZE * 2){              //till well after the last char
+    if(sent < length && next_char / 1000 <= next_pass){
+      RX_ISR(burst[sent++], path, way);
+      next_char += char_us_x1000;
+      continue;
+    }
+    Loop_Pass(&a, path, way);
+    next_pass += loop_us;
+    if(sent >= length)
+      idle++;
+  }
+  return Received();
+}
+
+//==============================================================================
+int main(void){
+  int got[2][2][NUM_LOOPS][NUM_BAUDS];          //path, way, loop, baud
+  const char* path_name[] = {"terminal", "TCP"};
+  char path;
+  char way;
+  unsigned int l;
+  unsigned int b;
+
+  printf("%d commands back to back, how many came out right\n", BURST_COMMANDS);
+  printf("%-9s %6s %8s %8s %8s\n", "", "pass", "baud", "old", "new");
+  for(path=PATH_PC; path<=PATH_TCP; path++)
+    for(l=COUNT_RESET; l<NUM_LOOPS; l++)
+      for(b=COUNT_RESET; b<NUM_BAUDS; b++){
+        for(way=WAY_OLD; way<=WAY_NEW; way++)
+          got[(int)path][(int)way][l][b] = Run(path, way, bauds[b], loops[l]);
+        printf("%-9s %4lums %8lu %8d %8d\n", path_name[(int)path],
+               loops[l] / 1000, bauds[b],
+               got[(int)path][WAY_OLD][l][b], got[(int)path][WAY_NEW][l][b]);
+        CHECK(got[(int)path][WAY_NEW][l][b] >= got[(int)path][WAY_OLD][l][b]);
+      }
+
+  //terminal: 128 chars a pass is 22 ms at 57600 and 5.5 ms at 230400
+  CHECK(got[PATH_PC][WAY_NEW][1][1] == BURST_COMMANDS);  //115200, 5 ms pass
+  CHECK(got[PATH_PC][WAY_NEW][0][2] == BURST_COMMANDS);  //460800, 1 ms pass
+  CHECK(got[PATH_PC][WAY_OLD][1][1] < BURST_COMMANDS);   //what user-002 was about
+  //TCP: 4 slots of 15 char frames, 60 chars a pass
+  CHECK(got[PATH_TCP][WAY_NEW][0][1] == BURST_COMMANDS); //115200, 1 ms pass
+  CHECK(got[PATH_TCP][WAY_NEW][1][0] == BURST_COMMANDS); //9600, 5 ms pass
+
+  if(failures){
+    printf("burst_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("burst_test: passed\n");
+  return 0;
+}
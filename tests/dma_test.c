@@ -0,0 +1,410 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      dma_test.c
+//
+//      host test for the DMA TX engine (dma.c) and the DMA ISR
+//      (interrupts_DMA.c), run against a register mock of the DMA channels
+//      and the eUSCI TX side they feed
+//      dma.c, interrupts_DMA.c, ring.c and bulk.c are the real ones
+//
+//      from the top of the repo:
+//              gcc -O2 -I. -Itests tests/dma_test.c dma.c interrupts_DMA.c ring.c bulk.c -o dma_test && ./dma_test
+//
+//      The mock moves one char time at a time.  Each port has TXBUF and a
+//      shift register:  when the shift register takes TXBUF, UCTXIFG goes
+//      high, and if the channel is on the DMA writes the next char of the
+//      chunk into TXBUF (which clears UCTXIFG again).  The last char of a
+//      chunk clears DMAEN and runs DMA_ISR with DMAIV set, the way the
+//      board does it.  The pulse dma.c makes on an idle port can't be seen
+//      in a plain variable, so UCTXIFG high with DMAEN on counts as the edge.
+//
+//      the test part covers
+//              a chunk that would go past the end of the ring is cut there,
+//              the rest goes out as the next chunk, from buffer[0]
+//              chars queued while a chunk is moving go out right after it
+//              nothing goes to the PC before PC_TX_Enable
+//              UCA3 with a bulk payload: ring chars ahead of it, the
+//              payload out of the caller's buffer, then the ring again
+//              Stats_TX gets exactly what went out the wire, per port
+//              DMA_Stop, and channel 1 swapping the ADC blocks
+//
+//      then it streams lines to UCA0 and counts interrupts per char, which
+//      is what the DMA engine was for (the old TX ISR took one per char)
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <string.h>
+#include "macros.h"
+#include "msp430.h"
+
+#define WIRE_MAX                (20000)
+#define MAX_CHUNKS              (2000)
+#define STREAM_CHARS            (10000)
+#define STREAM_LINE             (40)            //about a telemetry line
+#define IDLE_CHAR_TIMES         (4)             //this many with nothing sent is done
+#define BAUD_FAST               (460800UL)
+#define BITS_PER_CHAR           (10)            //start, 8 data, stop
+
+//the registers
+volatile unsigned int DMACTL0;
+volatile unsigned int DMACTL1;
+volatile unsigned int DMACTL4;
+volatile unsigned int DMAIV;
+volatile unsigned int DMA0CTL;
+volatile unsigned int DMA1CTL;
+volatile unsigned int DMA3CTL;
+volatile unsigned int DMA0SZ;
+volatile unsigned int DMA1SZ;
+volatile unsigned int DMA3SZ;
+volatile unsigned long DMA0SA;
+volatile unsigned long DMA0DA;
+volatile unsigned long DMA1SA;
+volatile unsigned long DMA1DA;
+volatile unsigned long DMA3SA;
+volatile unsigned long DMA3DA;
+volatile unsigned int UCA0IFG;
+volatile unsigned int UCA3IFG;
+volatile unsigned int UCA0TXBUF;
+volatile unsigned int UCA3TXBUF;
+volatile unsigned int ADC12MEM8;
+
+void Mock_Write_Addr(const char* address, unsigned long value){
+  if(strstr(address, "DMA0SA"))         DMA0SA = value;
+  else if(strstr(address, "DMA0DA"))    DMA0DA = value;
+  else if(strstr(address, "DMA1SA"))    DMA1SA = value;
+  else if(strstr(address, "DMA1DA"))    DMA1DA = value;
+  else if(strstr(address, "DMA3SA"))    DMA3SA = value;
+  else if(strstr(address, "DMA3DA"))    DMA3DA = value;
+  else printf("Mock_Write_Addr: what's %s?\n", address);
+}
+
+//what the rest of the car would have given dma.c/interrupts_DMA.c/bulk.c
+Ring UCA0_Tx_Ring;
+Ring UCA3_Tx_Ring;
+volatile char PC_TX_Enable = YES;
+unsigned long stats_tx[NUM_STATS_PORTS];        //what Stats_TX was told
+const unsigned int* adc_handed = NULL;          //the last block ADC_Block got
+void Stats_TX(char port, unsigned int count){ stats_tx[(unsigned char)port] += count; }
+void ADC_Block(const unsigned int* block){ adc_handed = block; }
+void StartTransmit_UCA3(void);
+void DMA_ISR(void);                             //interrupts_DMA.c
+extern unsigned int adc_block[ADC_NUM_BLOCKS][ADC_BLOCK_LENGTH];        //dma.c
+
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//one port: a DMA channel, TXBUF, the shift register and the wire
+typedef struct {
+  volatile unsigned int* ctl;
+  volatile unsigned int* sz;
+  volatile unsigned long* sa;
+  volatile unsigned int* ifg;
+  volatile unsigned int* txbuf;
+  unsigned int iv;                      //DMAIV for this channel
+  char armed;                           //SA/SZ latched, like the chip's temp registers
+  unsigned long at;                     //where the channel is reading
+  unsigned int left;                    //chars to go in the chunk
+  char txbuf_full;
+  char shifting;
+  char shift;
+  char wire[WIRE_MAX];                  //everything that went out
+  unsigned int wire_length;
+  unsigned int chunk[MAX_CHUNKS];       //the length of each chunk, in order
+  unsigned int chunks;
+} Port;
+
+Port uca0 = {.ctl = &DMA0CTL, .sz = &DMA0SZ, .sa = &DMA0SA, .ifg = &UCA0IFG,
+             .txbuf = &UCA0TXBUF, .iv = DMAIV__DMA0IFG};
+Port uca3 = {.ctl = &DMA3CTL, .sz = &DMA3SZ, .sa = &DMA3SA, .ifg = &UCA3IFG,
+             .txbuf = &UCA3TXBUF, .iv = DMAIV__DMA3IFG};
+unsigned long dma_interrupts = COUNT_RESET;
+
+void Reset_Port(Port* p){
+  p->armed = NO;
+  p->txbuf_full = NO;
+  p->shifting = NO;
+  p->wire_length = COUNT_RESET;
+  p->chunks = COUNT_RESET;
+  *p->ifg = UCTXIFG;                    //an idle eUSCI has TXBUF empty
+}
+
+//UCTXIFG went high: the DMA writes a char if the channel is on
+void DMA_Trigger(Port* p){
+  if(!(*p->ctl & DMAEN)){
+    p->armed = NO;
+    return;
+  }
+  if(!p->armed){                        //first trigger since DMAEN went on
+    p->at = *p->sa;
+    p->left = *p->sz;
+    p->armed = YES;
+    if(p->chunks < MAX_CHUNKS)
+      p->chunk[p->chunks++] = p->left;
+  }
+  *p->txbuf = *(volatile char*)p->at;
+  p->at++;
+  p->txbuf_full = YES;
+  *p->ifg &= ~UCTXIFG;                  //writing TXBUF clears it
+  if(--p->left)
+    return;
+  p->armed = NO;                        //the chunk is done
+  *p->ctl &= ~DMAEN;
+  DMAIV = p->iv;
+  dma_interrupts++;
+  DMA_ISR();
+  DMAIV = DMAIV__NONE;
+}
+
+//after the code had a go at the port (UCTXIFG high with DMAEN on)
+void Poll(Port* p){
+  if((*p->ifg & UCTXIFG) && !p->txbuf_full && (*p->ctl & DMAEN))
+    DMA_Trigger(p);
+}
+
+//one char time on the wire, returns YES if anything was going on
+char Char_Time(Port* p){
+  char busy = p->shifting || p->txbuf_full;
+  if(p->shifting && p->wire_length < WIRE_MAX)
+    p->wire[p->wire_length++] = p->shift;
+  p->shifting = NO;
+  if(p->txbuf_full){                    //TXBUF to the shift register
+    p->shift = (char)*p->txbuf;
+    p->shifting = YES;
+    p->txbuf_full = NO;
+    *p->ifg |= UCTXIFG;                 //the edge
+    DMA_Trigger(p);
+  }
+  return busy;
+}
+
+//run the port until it's been quiet for a bit
+void Drain(Port* p){
+  unsigned int idle = COUNT_RESET;
+  while(idle < IDLE_CHAR_TIMES)
+    idle = Char_Time(p) ? COUNT_RESET : idle + ADJUST_1;
+}
+
+//what StartTransmit does, less the interrupt juggling
+void Start_UCA0(void){
+  DMA_Transmit_UCA0();
+  Poll(&uca0);
+}
+
+void StartTransmit_UCA3(void){
+  DMA_Transmit_UCA3();
+  Poll(&uca3);
+}
+
+void Fill(char* data, unsigned int length, char first){
+  unsigned int i;
+  for(i=COUNT_RESET; i<length; i++)
+    data[i] = first + (i % 26);
+}
+
+//==============================================================================
+//50 chars starting 20 before the end of the ring: two chunks, in order
+void Test_Wrap(void){
+  char data[50];
+  Fill(data, sizeof(data), 'a');
+  Reset_Port(&uca0);
+  clear_Ring(&UCA0_Tx_Ring);
+  UCA0_Tx_Ring.wr = RING_SIZE - 20;
+  UCA0_Tx_Ring.rd = RING_SIZE - 20;
+  stats_tx[STATS_UCA0] = COUNT_RESET;
+  ring_Write(&UCA0_Tx_Ring, data, sizeof(data));
+  Start_UCA0();
+  CHECK(UCA0_dma_length == 20);                 //up to the buffer end
+  CHECK(DMA0SA == (unsigned long)&UCA0_Tx_Ring.buffer[RING_SIZE - 20]);
+  CHECK(DMA0DA == (unsigned long)&UCA0TXBUF);
+  Drain(&uca0);
+  CHECK(uca0.chunks == 2);
+  CHECK(uca0.chunk[0] == 20);
+  CHECK(uca0.chunk[1] == 30);                   //the wrapped piece
+  CHECK(DMA0SA == (unsigned long)&UCA0_Tx_Ring.buffer[COUNT_RESET]);
+  CHECK(uca0.wire_length == sizeof(data));
+  CHECK(!memcmp(uca0.wire, data, sizeof(data)));
+  CHECK(stats_tx[STATS_UCA0] == sizeof(data));
+  CHECK(ring_Count(&UCA0_Tx_Ring) == EMPTY);
+  CHECK(UCA0_dma_length == EMPTY);              //idle again
+}
+
+//more gets queued while a chunk is going, the ISR starts it
+void Test_Queue_While_Moving(void){
+  char data[100];
+  unsigned int i;
+  Fill(data, sizeof(data), 'A');
+  Reset_Port(&uca0);
+  clear_Ring(&UCA0_Tx_Ring);
+  stats_tx[STATS_UCA0] = COUNT_RESET;
+  ring_Write(&UCA0_Tx_Ring, data, 10);
+  Start_UCA0();
+  for(i=COUNT_RESET; i<3; i++)
+    Char_Time(&uca0);
+  ring_Write(&UCA0_Tx_Ring, &data[10], 90);     //the ring wraps under it
+  Start_UCA0();                                 //busy, this does nothing
+  CHECK(uca0.chunks == 1);
+  Drain(&uca0);
+  CHECK(uca0.wire_length == sizeof(data));
+  CHECK(!memcmp(uca0.wire, data, sizeof(data)));
+  CHECK(stats_tx[STATS_UCA0] == sizeof(data));
+  CHECK(uca0.chunks >= 2);
+}
+
+//nothing for the PC until it's said something
+void Test_PC_TX_Enable(void){
+  char data[10];
+  Fill(data, sizeof(data), '0');
+  Reset_Port(&uca0);
+  clear_Ring(&UCA0_Tx_Ring);
+  PC_TX_Enable = NO;
+  ring_Write(&UCA0_Tx_Ring, data, sizeof(data));
+  Start_UCA0();
+  Drain(&uca0);
+  CHECK(uca0.wire_length == EMPTY);
+  CHECK(ring_Count(&UCA0_Tx_Ring) == sizeof(data));
+  PC_TX_Enable = YES;
+  Start_UCA0();
+  Drain(&uca0);
+  CHECK(uca0.wire_length == sizeof(data));
+}
+
+//UCA3: ring chars, a bulk frame, more ring chars, all in the order queued
+void Test_Bulk(void){
+  char payload[300];
+  char expected[400];
+  unsigned int length = COUNT_RESET;
+  unsigned int i;
+  Fill(payload, sizeof(payload), 'a');
+  Reset_Port(&uca3);
+  clear_Ring(&UCA3_Tx_Ring);
+  stats_tx[STATS_UCA3] = COUNT_RESET;
+
+  ring_Write(&UCA3_Tx_Ring, "abc", 3);
+  memcpy(&expected[length], "abc", 3);
+  length += 3;
+  CHECK(Bulk_Send('1', payload, sizeof(payload)));  //StartTransmit_UCA3 too
+  memcpy(&expected[length], "\x1BZ10300", BULK_HEADER_LENGTH);
+  length += BULK_HEADER_LENGTH;
+  CHECK(UCA3_dma_length == 3 + BULK_HEADER_LENGTH); //clipped at the payload
+  memcpy(&expected[length], payload, sizeof(payload));
+  length += sizeof(payload);
+  for(i=COUNT_RESET; i<5; i++)
+    Char_Time(&uca3);
+  ring_Write(&UCA3_Tx_Ring, "xyz", 3);          //queued behind the payload
+  memcpy(&expected[length], "xyz", 3);
+  length += 3;
+  Drain(&uca3);
+
+  CHECK(uca3.chunks == 3);
+  CHECK(uca3.chunk[1] == sizeof(payload));      //straight out of the buffer
+  CHECK(uca3.wire_length == length);
+  CHECK(!memcmp(uca3.wire, expected, length));
+  CHECK(stats_tx[STATS_UCA3] == length);
+  CHECK(!Bulk_Busy());
+  CHECK(UCA3_dma_length == EMPTY);
+}
+
+//the ring is about to be cleared, the chunk in flight is dropped
+void Test_Stop(void){
+  char data[30];
+  unsigned long interrupts;
+  Fill(data, sizeof(data), 'a');
+  Reset_Port(&uca0);
+  clear_Ring(&UCA0_Tx_Ring);
+  ring_Write(&UCA0_Tx_Ring, data, sizeof(data));
+  Start_UCA0();
+  Char_Time(&uca0);
+  Char_Time(&uca0);
+  interrupts = dma_interrupts;
+  DMA_Stop_UCA0();
+  clear_Ring(&UCA0_Tx_Ring);
+  CHECK(!(DMA0CTL & DMAEN));
+  CHECK(UCA0_dma_length == EMPTY);
+  Drain(&uca0);
+  CHECK(uca0.wire_length <= 3);                 //what was already in the UART
+  CHECK(dma_interrupts == interrupts);          //no chunk done for a stopped chunk
+  ring_Write(&UCA0_Tx_Ring, data, 5);           //and it starts again fine
+  Start_UCA0();
+  Drain(&uca0);
+  CHECK(!memcmp(&uca0.wire[uca0.wire_length - 5], data, 5));
+}
+
+//channel 1 takes turns between the two ADC blocks
+void Test_ADC_Swap(void){
+  Init_DMA_ADC();
+  CHECK(DMA1SA == (unsigned long)&ADC12MEM8);
+  CHECK(DMA1DA == (unsigned long)adc_block[0]);
+  CHECK(DMA1SZ == ADC_BLOCK_LENGTH);
+  CHECK(DMA1CTL & DMAEN);
+  DMA1CTL &= ~DMAEN;                            //the block is in
+  DMAIV = DMAIV__DMA1IFG;
+  DMA_ISR();
+  CHECK(adc_handed == adc_block[0]);
+  CHECK(DMA1DA == (unsigned long)adc_block[1]);
+  CHECK(DMA1CTL & DMAEN);
+  DMA1CTL &= ~DMAEN;
+  DMA_ISR();
+  CHECK(adc_handed == adc_block[1]);
+  CHECK(DMA1DA == (unsigned long)adc_block[0]);
+  DMAIV = DMAIV__NONE;
+}
+
+//lines into UCA0 whenever they fit, how many interrupts does it take?
+void Stream(void){
+  char line[STREAM_LINE];
+  unsigned int queued = COUNT_RESET;
+  unsigned long interrupts = dma_interrupts;
+  unsigned long per_second;
+  Fill(line, sizeof(line), 'a');
+  line[STREAM_LINE - ADJUST_1] = '\n';
+  Reset_Port(&uca0);
+  clear_Ring(&UCA0_Tx_Ring);
+  stats_tx[STATS_UCA0] = COUNT_RESET;
+  while(queued < STREAM_CHARS){
+    if(ring_Space(&UCA0_Tx_Ring) >= STREAM_LINE){
+      ring_Write_All(&UCA0_Tx_Ring, line, STREAM_LINE);
+      queued += STREAM_LINE;
+      Start_UCA0();
+    }
+    Char_Time(&uca0);
+  }
+  Drain(&uca0);
+  interrupts = dma_interrupts - interrupts;
+  per_second = BAUD_FAST / BITS_PER_CHAR * interrupts / uca0.wire_length;
+  printf("stream: %u chars in %u byte lines, %lu DMA interrupts (%.1f chars each)\n",
+         uca0.wire_length, STREAM_LINE, interrupts,
+         (double)uca0.wire_length / interrupts);
+  printf("        at %lu baud that's %lu interrupts/s, one per char was %lu\n",
+         BAUD_FAST, per_second, BAUD_FAST / BITS_PER_CHAR);
+  CHECK(uca0.wire_length == queued);
+  CHECK(stats_tx[STATS_UCA0] == queued);
+  CHECK(interrupts * 10 < queued);              //an order of magnitude at least
+}
+
+//==============================================================================
+int main(void){
+  Init_DMA();
+  CHECK((DMACTL0 & DMA0TSEL) == DMA_TRIGGER_UCA0TX);
+  CHECK((DMACTL1 & DMA3TSEL) == (DMA_TRIGGER_UCA3TX << DMA_TSEL_ODD_SHIFT));
+  CHECK(DMA3DA == (unsigned long)&UCA3TXBUF);
+  Test_Wrap();
+  Test_Queue_While_Moving();
+  Test_PC_TX_Enable();
+  Test_Bulk();
+  Test_Stop();
+  Test_ADC_Swap();
+  Stream();
+  if(failures){
+    printf("dma_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("dma_test: passed\n");
+  return 0;
+}
@@ -0,0 +1,232 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      filter_test.c
+//
+//      host test for filter.c - noise and step latency of every filter type
+//      filter.c is integer-only C, so it builds on the PC
+//
+//      from the top of the repo:
+//              gcc -O2 -I. -Itests tests/filter_test.c filter.c -lm -o filter_test && ./filter_test
+//
+//      The trace is made up, but shaped like a detector going from the
+//      floor onto the line:  TRACE_LOW, then a step to TRACE_HIGH, with
+//      noise from a fixed seed (so every run is the same).  A second copy
+//      has big one-sample spikes in it (a reflection, a bad conversion).
+//
+//      for each filter it measures
+//              noise           standard deviation of the output on the
+//                              flat parts, compared to the raw trace
+//              50% / 90%       how many input samples after the step the
+//                              output gets halfway / 90% of the way there
+//              spike           the worst the spiky trace gets the output
+//                              away from where it should be
+//      and checks them against what the top of filter.c says they are.
+//      The times are in samples, ms is at ADC_RATE_DEFAULT sequences/sec.
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "macros.h"
+
+#define TRACE_LENGTH            (4000)
+#define TRACE_STEP              (2000)          //first sample at TRACE_HIGH
+#define TRACE_LOW               (300)
+#define TRACE_HIGH              (700)
+#define TRACE_SETTLE            (600)           //left out of the noise numbers,
+                                                //about 9 time constants of EMA 1/64
+#define SPIKE_EVERY             (37)
+#define SPIKE_SIZE              (1500)
+#define MS_PER_SECOND           (1000.0)
+
+typedef struct {
+  const char* name;
+  int code;                             //A<tsd>
+  double noise_limit;                   //what noise should be at most
+  int late_limit;                       //what late_50 should be at most
+  double noise;                         //output sd / raw sd
+  int late_50;                          //samples
+  int late_90;
+  int spike;                            //worst output error, spiky trace
+  int outputs;                          //how many results came out
+} Result;
+
+int trace[TRACE_LENGTH];
+int spiky[TRACE_LENGTH];
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//same numbers every run
+unsigned long seed = 12345;
+int Noise(void){
+  int sum = COUNT_RESET;
+  char i;
+  for(i=COUNT_RESET; i<4; i++){                 //4 uniforms, near enough gaussian
+    seed = seed * 1103515245UL + 12345;
+    if(i & ADJUST_1)                            //+ and - in turn, so it averages 0
+      sum -= (int)((seed >> 16) & 0x1F);
+    else
+      sum += (int)((seed >> 16) & 0x1F);
+  }
+  return sum;
+}
+
+int Level(int i){
+  return (i < TRACE_STEP) ? TRACE_LOW : TRACE_HIGH;
+}
+
+void Make_Traces(void){
+  int i;
+  for(i=COUNT_RESET; i<TRACE_LENGTH; i++){
+    trace[i] = Level(i) + Noise();
+    spiky[i] = trace[i];
+    if(i % SPIKE_EVERY == SPIKE_EVERY - ADJUST_1)
+      spiky[i] += SPIKE_SIZE;
+  }
+}
+
+//flat parts only: after TRACE_SETTLE, and not near the step
+char Flat(int i){
+  if(i < TRACE_SETTLE)
+    return NO;
+  if(i >= TRACE_STEP - TRACE_SETTLE && i < TRACE_STEP + TRACE_SETTLE)
+    return NO;
+  return YES;
+}
+
+//standard deviation around the true level, on the flat parts
+//out[i] is the output that came out at input sample i, has[i] says if one did
+double Noise_SD(const int* out, const char* has){
+  double sum = 0;
+  double error;
+  int n = COUNT_RESET;
+  int i;
+  for(i=COUNT_RESET; i<TRACE_LENGTH; i++){
+    if(!has[i] || !Flat(i))
+      continue;
+    error = out[i] - Level(i);
+    sum += error * error;
+    n++;
+  }
+  return n ? sqrt(sum / n) : 0;
+}
+
+//first output at least fraction of the way up, in samples after the step
+int Step_Latency(const int* out, const char* has, double fraction){
+  double target = TRACE_LOW + fraction * (TRACE_HIGH - TRACE_LOW);
+  int i;
+  for(i=TRACE_STEP; i<TRACE_LENGTH; i++)
+    if(has[i] && out[i] >= target)
+      return i - TRACE_STEP;
+  return TRACE_LENGTH;
+}
+
+//run one A<tsd> over a trace
+int Run(int code, const int* in, int* out, char* has){
+  Filter f;
+  int outputs = COUNT_RESET;
+  int i;
+  Init_Filter(&f, code / FILTER_CODE_TYPE,
+              (code / FILTER_CODE_SIZE) % MOVE_UP_A_TENS_PLACE,
+              code % MOVE_UP_A_TENS_PLACE);
+  for(i=COUNT_RESET; i<TRACE_LENGTH; i++){
+    has[i] = Filter_Sample(&f, in[i]);
+    out[i] = f.output;
+    if(has[i])
+      outputs++;
+  }
+  return outputs;
+}
+
+void Measure(Result* r, double raw_sd){
+  int out[TRACE_LENGTH];
+  char has[TRACE_LENGTH];
+  int i;
+  int error;
+  r->outputs = Run(r->code, trace, out, has);
+  r->noise = Noise_SD(out, has) / raw_sd;
+  r->late_50 = Step_Latency(out, has, 0.5);
+  r->late_90 = Step_Latency(out, has, 0.9);
+  Run(r->code, spiky, out, has);
+  r->spike = COUNT_RESET;
+  for(i=COUNT_RESET; i<TRACE_LENGTH; i++){
+    if(!has[i] || !Flat(i))
+      continue;
+    error = abs(out[i] - Level(i));
+    if(error > r->spike)
+      r->spike = error;
+  }
+}
+
+//==============================================================================
+int main(void){
+  //the measured fields start out 0, Measure fills them in
+  //boxcar of N:  noise 1/sqrt(N),  halfway (N-1)/2 + 1 samples late at most
+  //EMA 1/2^s:    noise 1/sqrt(2^(s+1) - 1), 90% in about 2.3 * 2^s
+  //median of N:  below 1 (about 0.7 for 3, 0.55 for 5), (N-1)/2 late
+  Result results[] = {
+    {.name = "none",             .code = 0,   .noise_limit = 1.01,            .late_limit = 0},
+    {.name = "boxcar 2",         .code = 110, .noise_limit = 1.10 / sqrt(2),  .late_limit = 1},
+    {.name = "boxcar 4 (A120)",  .code = 120, .noise_limit = 1.10 / sqrt(4),  .late_limit = 2},
+    {.name = "boxcar 8",         .code = 130, .noise_limit = 1.10 / sqrt(8),  .late_limit = 4},
+    {.name = "EMA 1/8 (thumb)",  .code = 230, .noise_limit = 1.15 / sqrt(15), .late_limit = 6},
+    {.name = "EMA 1/64",         .code = 260, .noise_limit = 1.15 / sqrt(127), .late_limit = 45},
+    {.name = "median 3",         .code = 330, .noise_limit = 0.90,            .late_limit = 1},
+    {.name = "median 5",         .code = 350, .noise_limit = 0.75,            .late_limit = 2},
+    {.name = "boxcar 4, 1 in 4", .code = 124, .noise_limit = 1.10 / sqrt(4),  .late_limit = 4},
+    {.name = "median 5, 1 in 2", .code = 352, .noise_limit = 0.75,            .late_limit = 3},
+  };
+  int count = sizeof(results) / sizeof(results[0]);
+  int out[TRACE_LENGTH];
+  char has[TRACE_LENGTH];
+  double raw_sd;
+  int i;
+  Result* r;
+
+  Make_Traces();
+  Run(0, trace, out, has);
+  raw_sd = Noise_SD(out, has);
+
+  printf("step %d -> %d, raw noise sd %.1f, spikes +%d every %d, ms at %d/s\n",
+         TRACE_LOW, TRACE_HIGH, raw_sd, SPIKE_SIZE, SPIKE_EVERY, ADC_RATE_DEFAULT);
+  printf("%-18s %6s %6s %8s %8s %8s %6s\n",
+         "filter", "A<tsd>", "noise", "50%", "90%", "50% ms", "spike");
+  for(i=COUNT_RESET; i<count; i++){
+    r = &results[i];
+    Measure(r, raw_sd);
+    printf("%-18s %6d %6.2f %8d %8d %8.2f %6d\n", r->name, r->code, r->noise,
+           r->late_50, r->late_90,
+           r->late_50 * MS_PER_SECOND / ADC_RATE_DEFAULT, r->spike);
+    CHECK(r->noise <= r->noise_limit);
+    CHECK(r->late_50 <= r->late_limit);
+  }
+
+  //the things the top of filter.c promises beyond noise and latency
+  CHECK(results[0].late_50 == EMPTY);                    //none is none
+  CHECK(results[0].spike >= SPIKE_SIZE - 100);           //spikes go straight through
+  CHECK(results[2].spike >= SPIKE_SIZE / 4 - 100);       //a boxcar smears them out
+  CHECK(results[6].spike < 100);                         //a median throws them out
+  CHECK(results[7].spike < 100);
+  CHECK(results[4].late_90 <= 24);                       //EMA 1/8: 2.3 * 8 + noise
+  CHECK(results[5].late_90 <= 190);                      //EMA 1/64
+  CHECK(results[1].noise > results[2].noise);            //longer is quieter
+  CHECK(results[2].noise > results[3].noise);
+  CHECK(results[1].outputs == TRACE_LENGTH);             //decimate 0 is every one
+  CHECK(results[8].outputs == TRACE_LENGTH / 4);         //1 in 4
+  CHECK(results[9].outputs == TRACE_LENGTH / 2);         //1 in 2
+  CHECK(fabs(results[8].noise - results[2].noise) < 0.05); //decimating doesn't add noise
+
+  if(failures){
+    printf("filter_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("filter_test: passed\n");
+  return 0;
+}
@@ -0,0 +1,8 @@
+//==============================================================================
+//      functions.h stand in for the host tests
+//
+//      the real one comes with the IAR project and isn't in the repo.
+//      Everything the tested files use is already in macros.h, so this is
+//      only here so #include "functions.h" finds something.
+//
+//==============================================================================
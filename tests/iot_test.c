@@ -0,0 +1,499 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      iot_test.c
+//
+//      host test for the AT command engine and the link speed task (iot.c),
+//      against a scripted IOT module
+//      iot.c and ring.c are the real ones, the module and the rest of the
+//      car are played by this file
+//
+//      from the top of the repo:
+//              gcc -O2 -I. -Itests tests/iot_test.c iot.c ring.c -o iot_test && ./iot_test
+//
+//      The module hears whatever transmitString_UCA3 sends, one line at a
+//      time, and answers MODULE_LATENCY passes later through the UCA3 RX
+//      ring the way the ISR fills it:
+//              AT, AT&Yn, AT+RESET=1           OK
+//              ATB=<rate>                      OK and switches after it, or
+//                                              ERROR above module_max_baud
+//              AT+NSTCP=...                    CONNECT <cid> then OK
+//              AT+NSTAT=?                      a few lines then OK
+//      module_errors / module_silent make it answer ERROR / nothing for
+//      that many commands.  If UCA3 and the module aren't at the same
+//      rate, it can't make out what it's sent and what it sends back
+//      comes in as junk.  IOT_RESET low puts it back at 115200.
+//
+//      Every pass of the make-believe main loop is PASS_MS, and TA0_tick
+//      goes up every 100 ms like the TA0 CCR0 interrupt does it.
+//
+//      the test part covers
+//              AT_Match on the tokens the car uses
+//              OK right away, ERROR then OK (retries), ERROR every time,
+//              nothing (timeouts), a custom token, AT_Send_Hook
+//              chatter from before the command never counts as its reply
+//              a full TX ring, a full queue, AT_Clear
+//              IOT_Link_Task: a rate the module turns down, one it says OK
+//              to and then can't do (reset, back to 115200, next rate),
+//              rates SMCLK can't make, a dead module, S (9600)
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macros.h"
+
+#define PASS_MS                 (10)
+#define PASSES_PER_TICK         (100 / PASS_MS) //TA0_tick is 100 ms
+#define MODULE_LATENCY          (2)             //passes before the reply comes in
+#define MODULE_REPLY_MAX        (80)
+#define MODULE_LOG_MAX          (40)            //lines it heard
+#define RUN_PASSES_MAX          (6000)          //a minute, nothing takes that long
+#define OLD_PROFILE_MS          (2000)          //AT&Y and AT+RESET, a second each
+#define GARBLED                 ('?')           //what a char at the wrong rate turns into
+#define NO_BAUD                 (0)             //the module can't be reached at any rate
+
+//what the rest of the car would have given iot.c
+unsigned volatile int TA0_tick = COUNT_RESET;
+volatile unsigned int P3OUT = IOT_RESET;        //out of reset
+unsigned long current_Baud_3 = BAUD115200;
+unsigned long smclk_max_baud = BAUD921600;      //what Baud_Possible lets through
+char display_line[NUM_DISPLAY_LINES][NUM_DISPLAY_CHARS];
+Ring UCA3_Rx_Ring;
+char tx_full = NO;                              //transmitString_UCA3 turns it down
+char (*command_task)(void) = NULL;
+unsigned int sessions_cleared = COUNT_RESET;
+char chatter[MODULE_REPLY_MAX * 2];             //what Session_Chatter_Char got
+unsigned int chatter_length = COUNT_RESET;
+
+char read_UCA3_RX(char* c){ return get_Ring_Char(&UCA3_Rx_Ring, c); }
+char setBaud_UCA3(unsigned long baud){ current_Baud_3 = baud; return YES; }
+char Baud_Possible(unsigned long baud){ return baud <= smclk_max_baud; }
+void Start_Command_Task(char (*task)(void)){ command_task = task; }
+void clear_Sessions(void){ sessions_cleared++; }
+void clear_UDP(void){}
+void Session_Chatter_Char(char c){
+  if(chatter_length < sizeof(chatter) - ADJUST_1)
+    chatter[chatter_length++] = c;
+}
+char transmitString_UCA3(char* str);
+
+//copied from timers.c
+char Task_Time_Up(Task* task){
+  if((int)(TA0_tick - task->deadline) < EMPTY)
+    return NO;
+  return YES;
+}
+
+void Task_Reset(Task* task){
+  task->resume = TASK_START;
+}
+
+extern unsigned int at_timeouts;             //iot.c
+extern unsigned int at_errors;
+
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//the module
+unsigned long module_baud = BAUD115200;
+unsigned long module_max_baud = BAUD921600;     //ATB above this is an ERROR
+unsigned long module_broken_baud = NO_BAUD;     //says OK to this one, then it's gone
+unsigned int module_errors = COUNT_RESET;       //ERROR for this many commands
+unsigned int module_silent = COUNT_RESET;       //nothing for this many
+char module_dead = NO;                          //nothing ever
+char module_in_reset = NO;
+unsigned int module_resets = COUNT_RESET;
+unsigned int module_garbled = COUNT_RESET;      //lines it couldn't make out
+
+char module_reply[MODULE_REPLY_MAX];            //on its way back
+unsigned long module_reply_baud;                //what it's sent at
+unsigned long module_baud_after;                //what it switches to once it's out
+unsigned int module_reply_due = COUNT_RESET;
+char module_replying = NO;
+
+char module_log[MODULE_LOG_MAX][MODULE_REPLY_MAX];      //lines it understood
+unsigned int module_heard = COUNT_RESET;
+unsigned int pass_count = COUNT_RESET;
+
+void Module_Reset(void){
+  module_baud = BAUD115200;
+  module_max_baud = BAUD921600;
+  module_broken_baud = NO_BAUD;
+  module_errors = COUNT_RESET;
+  module_silent = COUNT_RESET;
+  module_dead = NO;
+  module_resets = COUNT_RESET;
+  module_garbled = COUNT_RESET;
+  module_replying = NO;
+  module_heard = COUNT_RESET;
+  current_Baud_3 = BAUD115200;
+  smclk_max_baud = BAUD921600;
+  chatter_length = COUNT_RESET;
+  sessions_cleared = COUNT_RESET;
+  clear_Ring(&UCA3_Rx_Ring);
+}
+
+void Module_Answer(const char* reply, unsigned long baud_after){
+  strcpy(module_reply, reply);
+  module_reply_baud = module_baud;
+  module_baud_after = baud_after;
+  module_reply_due = pass_count + MODULE_LATENCY;
+  module_replying = YES;
+}
+
+//one line from the car, \r\n and all
+void Module_Hear(const char* line){
+  char command[MODULE_REPLY_MAX];
+  unsigned long rate;
+  if(module_dead || module_in_reset)
+    return;
+  if(current_Baud_3 != module_baud){            //junk at this end
+    module_garbled++;
+    return;
+  }
+  strcpy(command, line);
+  command[strcspn(command, "\r\n")] = EMPTY;
+  if(module_heard < MODULE_LOG_MAX)
+    strcpy(module_log[module_heard++], command);
+  if(module_silent){
+    module_silent--;
+    return;
+  }
+  if(module_errors){
+    module_errors--;
+    Module_Answer("\r\nERROR\r\n", module_baud);
+    return;
+  }
+  if(!strncmp(command, "ATB=", 4)){
+    rate = strtoul(&command[4], NULL, 10);
+    if(rate > module_max_baud)
+      Module_Answer("\r\nERROR\r\n", module_baud);
+    else
+      Module_Answer("\r\nOK\r\n", rate == module_broken_baud ? NO_BAUD : rate);
+  }
+  else if(!strncmp(command, "AT+NSTCP=", 9))
+    Module_Answer("\r\nCONNECT 1\r\n\r\nOK\r\n", module_baud);
+  else if(!strcmp(command, "AT+NSTAT=?"))
+    Module_Answer("\r\nMAC=00:1d:c9:01:02:03\r\nSSID=\"home\"\r\nIP addr=10.0.0.2\r\n"
+                  "\r\nOK\r\n", module_baud);
+  else if(!strcmp(command, "AT") || !strncmp(command, "AT&Y", 4)
+          || !strcmp(command, "AT+RESET=1"))
+    Module_Answer("\r\nOK\r\n", module_baud);
+  else
+    Module_Answer("\r\nERROR\r\n", module_baud);
+}
+
+//unasked for, straight into the ring
+void Module_Chatter(const char* text){
+  while(*text)
+    put_Ring_Char(&UCA3_Rx_Ring, *text++);
+}
+
+//once a pass: the reply goes out when it's due, IOT_RESET is watched
+void Module_Pass(void){
+  const char* c;
+  if(!(P3OUT & IOT_RESET)){
+    if(!module_in_reset)
+      module_resets++;
+    module_in_reset = YES;
+    module_replying = NO;
+    module_baud = BAUD115200;                   //where it comes out of reset
+    return;
+  }
+  module_in_reset = NO;
+  if(!module_replying || pass_count < module_reply_due)
+    return;
+  for(c=module_reply; *c; c++)
+    put_Ring_Char(&UCA3_Rx_Ring, current_Baud_3 == module_reply_baud ? *c : GARBLED);
+  module_baud = module_baud_after;
+  module_replying = NO;
+}
+
+char transmitString_UCA3(char* str){
+  if(tx_full)
+    return NO;
+  Module_Hear(str);
+  return YES;
+}
+
+//==============================================================================
+//the car's side
+char results[AT_QUEUE_SIZE * 2];                //every done, in order
+unsigned int num_results = COUNT_RESET;
+char hooked[MODULE_REPLY_MAX * 2];              //what the on_char hook saw
+unsigned int hooked_length = COUNT_RESET;
+
+void Done(char result){
+  if(num_results < sizeof(results))
+    results[num_results++] = result;
+}
+
+void Hook(char c){
+  if(hooked_length < sizeof(hooked) - ADJUST_1)
+    hooked[hooked_length++] = c;
+}
+
+//a callback that queues the next one, like WiFi_Profile_Task used to
+void Done_Then_Send(char result){
+  Done(result);
+  AT_Send("AT+RESET=1\r\n", NULL, ONE_SECOND, EMPTY, Done);
+}
+
+//one pass of the OS loop, the parts that matter here
+void Pass(void){
+  Module_Pass();
+  AT_Process();
+  if(command_task && command_task() == TASK_DONE)
+    command_task = NULL;
+  pass_count++;
+  if(!(pass_count % PASSES_PER_TICK))
+    TA0_tick++;
+}
+
+//until the engine and the command task are both done, returns ms
+unsigned int Run(void){
+  unsigned int start = pass_count;
+  while((AT_Busy() || command_task) && pass_count - start < RUN_PASSES_MAX)
+    Pass();
+  CHECK(pass_count - start < RUN_PASSES_MAX);   //it has to end
+  return (pass_count - start) * PASS_MS;
+}
+
+void Fresh(void){
+  Module_Reset();
+  AT_Clear();
+  num_results = COUNT_RESET;
+  hooked_length = COUNT_RESET;
+}
+
+//==============================================================================
+char Feed(AT_Matcher* m, const char* token, const char* text){
+  char matched = NO;
+  m->token = token;
+  m->index = COUNT_RESET;
+  while(*text)
+    if(AT_Match(m, *text++))
+      matched++;
+  return matched;
+}
+
+void Test_Match(void){
+  AT_Matcher m;
+  CHECK(Feed(&m, AT_OK_TOKEN, "\r\nOK\r\n") == 1);
+  CHECK(Feed(&m, AT_OK_TOKEN, "\r\nO\r\nOK\r\n") == 1);  //starts over on the \n
+  CHECK(Feed(&m, AT_OK_TOKEN, "\r\nNOK\r\n") == EMPTY);
+  CHECK(Feed(&m, AT_OK_TOKEN, "BLOCK\r\n") == EMPTY);   //OK has to start a line
+  CHECK(Feed(&m, AT_OK_TOKEN, "\r\nOK\r\n\r\nOK\r\n") == 2);
+  CHECK(Feed(&m, AT_ERROR_TOKEN, "\r\nERRERROR\r\n") == 1);
+  CHECK(Feed(&m, "CONNECT ", "\r\nCONNECT 1\r\n") == 1);
+}
+
+void Test_Replies(void){
+  unsigned int ms;
+  unsigned int before;
+
+  Fresh();                                      //OK, right away
+  AT_Send("AT\r\n", NULL, ONE_SECOND, AT_DEFAULT_RETRIES, Done);
+  ms = Run();
+  printf("AT, OK:                %5u ms (timeout %d ms)\n", ms, ONE_SECOND * 100);
+  CHECK(num_results == 1 && results[0] == AT_RESULT_OK);
+  CHECK(module_heard == 1);
+  CHECK(ms <= (MODULE_LATENCY + 2) * PASS_MS);
+
+  Fresh();                                      //ERROR twice, then OK
+  before = at_errors;
+  module_errors = 2;
+  AT_Send("AT\r\n", NULL, ONE_SECOND, 2, Done);
+  ms = Run();
+  printf("ERROR, ERROR, OK:      %5u ms\n", ms);
+  CHECK(num_results == 1 && results[0] == AT_RESULT_OK);
+  CHECK(module_heard == 3);
+  CHECK(at_errors == before + 2);
+
+  Fresh();                                      //ERROR every time
+  module_errors = 5;
+  AT_Send("AT\r\n", NULL, ONE_SECOND, 2, Done);
+  Run();
+  CHECK(num_results == 1 && results[0] == AT_RESULT_ERROR);
+  CHECK(module_heard == 3);                     //1 and 2 retries
+
+  Fresh();                                      //nothing, twice
+  before = at_timeouts;
+  module_silent = 5;
+  AT_Send("AT\r\n", NULL, ONE_SECOND, 1, Done);
+  ms = Run();
+  printf("nothing, nothing:      %5u ms\n", ms);
+  CHECK(num_results == 1 && results[0] == AT_RESULT_TIMEOUT);
+  CHECK(module_heard == 2);
+  CHECK(at_timeouts == before + 2);
+  CHECK(ms >= 2 * ONE_SECOND * 100 - PASSES_PER_TICK * PASS_MS);
+  CHECK(ms <= 2 * ONE_SECOND * 100 + PASSES_PER_TICK * PASS_MS * 2);
+
+  Fresh();                                      //nothing, then OK on the retry
+  module_silent = 1;
+  AT_Send("AT\r\n", NULL, ONE_SECOND, 1, Done);
+  ms = Run();
+  printf("nothing, OK:           %5u ms\n", ms);
+  CHECK(num_results == 1 && results[0] == AT_RESULT_OK);
+  CHECK(ms < 2 * ONE_SECOND * 100);
+
+  Fresh();                                      //a token of its own
+  AT_Send("AT+NSTAT=?\r\n", "IP addr=", ONE_SECOND, EMPTY, Done);
+  Run();
+  CHECK(num_results == 1 && results[0] == AT_RESULT_OK);
+  CHECK(ring_Count(&UCA3_Rx_Ring) > EMPTY);     //the rest is left for whoever wants it
+
+  Fresh();                                      //the hook sees the reply go by
+  AT_Send_Hook("AT+NSTCP=4166,1\r\n", NULL, ONE_SECOND, EMPTY, Done, Hook);
+  Run();
+  hooked[hooked_length] = EMPTY;
+  CHECK(num_results == 1 && results[0] == AT_RESULT_OK);
+  CHECK(strstr(hooked, "CONNECT 1") != NULL);
+  CHECK(strstr(hooked, "\nOK\r") != NULL);      //right up to the token
+}
+
+//an OK that was already in the ring isn't the answer to this one
+void Test_Chatter(void){
+  Fresh();
+  Module_Chatter("\r\nCONNECT 2 1 10.0.0.5 5000\r\n\r\nOK\r\n");
+  module_silent = 1;
+  AT_Send("AT\r\n", NULL, ONE_SECOND, EMPTY, Done);
+  Run();
+  chatter[chatter_length] = EMPTY;
+  CHECK(num_results == 1 && results[0] == AT_RESULT_TIMEOUT);
+  CHECK(strstr(chatter, "CONNECT 2 1") != NULL);        //session.c still got it
+}
+
+void Test_Queue(void){
+  unsigned int i;
+  unsigned int start;
+
+  Fresh();                                      //no room to send, it waits
+  tx_full = YES;
+  AT_Send("AT\r\n", NULL, ONE_SECOND, EMPTY, Done);
+  for(i=COUNT_RESET; i<3 * ONE_SECOND * PASSES_PER_TICK; i++)
+    Pass();
+  CHECK(module_heard == EMPTY);
+  CHECK(num_results == EMPTY);                  //no timeout before it's out
+  tx_full = NO;
+  Run();
+  CHECK(num_results == 1 && results[0] == AT_RESULT_OK);
+
+  Fresh();                                      //full queue
+  for(i=COUNT_RESET; i<AT_QUEUE_SIZE; i++)
+    CHECK(AT_Send(i ? "AT\r\n" : "AT&Y1\r\n", NULL, ONE_SECOND, EMPTY,
+                  i ? Done : Done_Then_Send));
+  CHECK(!AT_Send("AT\r\n", NULL, ONE_SECOND, EMPTY, Done));
+  Run();
+  CHECK(num_results == AT_QUEUE_SIZE + 1);      //and the one the callback sent
+  CHECK(!strcmp(module_log[0], "AT&Y1"));       //in order
+  CHECK(!strcmp(module_log[AT_QUEUE_SIZE], "AT+RESET=1"));
+  for(i=COUNT_RESET; i<num_results; i++)
+    CHECK(results[i] == AT_RESULT_OK);
+
+  Fresh();                                      //AT_Clear, nobody hears back
+  AT_Send("AT\r\n", NULL, ONE_SECOND, EMPTY, Done);
+  AT_Send("AT\r\n", NULL, ONE_SECOND, EMPTY, Done);
+  Pass();
+  AT_Clear();
+  Run();
+  CHECK(!AT_Busy());
+  CHECK(num_results == EMPTY);
+
+  Fresh();                                      //what H does now vs the sleeps
+  start = pass_count;
+  AT_Send("AT&Y1\r\n", NULL, ONE_SECOND, AT_DEFAULT_RETRIES, Done_Then_Send);
+  Run();
+  printf("profile switch:        %5u ms (the old way slept %d ms)\n",
+         (pass_count - start) * PASS_MS, OLD_PROFILE_MS);
+  CHECK(num_results == 2);
+  CHECK((pass_count - start) * PASS_MS < OLD_PROFILE_MS / 10);
+}
+
+//==============================================================================
+//the link task, from 115200
+unsigned int Link(char fastest, char slowest){
+  Start_Link_Speed(fastest, slowest);
+  return Run();
+}
+
+char Heard(const char* command){
+  unsigned int i;
+  for(i=COUNT_RESET; i<module_heard; i++)
+    if(!strcmp(module_log[i], command))
+      return YES;
+  return NO;
+}
+
+void Test_Link(void){
+  unsigned int ms;
+
+  Fresh();                                      //921600 is turned down
+  module_max_baud = BAUD460800;
+  ms = Link(LINK_FASTEST, LINK_SLOWEST_FAST);
+  printf("link, 921600 ERROR:    %5u ms -> %lu\n", ms, current_Baud_3);
+  CHECK(current_Baud_3 == BAUD460800);
+  CHECK(module_baud == BAUD460800);
+  CHECK(module_resets == EMPTY);
+  CHECK(Heard("ATB=921600"));
+  CHECK(!strncmp(display_line[DISPLAY_LINE_4], "L 460800", 8));
+
+  Fresh();                                      //OK to 921600, then it's gone
+  module_broken_baud = BAUD921600;
+  ms = Link(LINK_FASTEST, LINK_SLOWEST_FAST);
+  printf("link, 921600 broken:   %5u ms -> %lu, %u reset\n",
+         ms, current_Baud_3, module_resets);
+  CHECK(current_Baud_3 == BAUD460800);          //reset, back to 115200, next one
+  CHECK(module_baud == BAUD460800);
+  CHECK(module_resets == 1);
+  CHECK(sessions_cleared == 1);
+  CHECK(module_garbled > EMPTY);                //the AT at 921600
+
+  Fresh();                                      //SMCLK can't do the top two
+  smclk_max_baud = BAUD230400;
+  ms = Link(LINK_FASTEST, LINK_SLOWEST_FAST);
+  printf("link, SMCLK <= 230400: %5u ms -> %lu\n", ms, current_Baud_3);
+  CHECK(current_Baud_3 == BAUD230400);
+  CHECK(!Heard("ATB=921600"));                  //never asked
+  CHECK(!Heard("ATB=460800"));
+
+  Fresh();                                      //nobody home
+  module_dead = YES;
+  ms = Link(LINK_FASTEST, LINK_SLOWEST_FAST);
+  printf("link, dead module:     %5u ms -> %lu, %u reset\n",
+         ms, current_Baud_3, module_resets);
+  CHECK(current_Baud_3 == BAUD115200);
+  CHECK(module_resets == 1);                    //one reset, then it gives up
+  CHECK(!strncmp(display_line[DISPLAY_LINE_4], "link ???", 8));
+
+  Fresh();                                      //F then S
+  Link(LINK_FASTEST, LINK_SLOWEST_FAST);
+  CHECK(current_Baud_3 == BAUD921600);
+  Link(LINK_9600, LINK_9600);
+  CHECK(current_Baud_3 == BAUD9600);
+  CHECK(module_baud == BAUD9600);
+  CHECK(module_resets == EMPTY);
+}
+
+//==============================================================================
+int main(void){
+  clear_Ring(&UCA3_Rx_Ring);
+  Test_Match();
+  Test_Replies();
+  Test_Chatter();
+  Test_Queue();
+  Test_Link();
+  if(failures){
+    printf("iot_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("iot_test: passed\n");
+  return 0;
+}
@@ -0,0 +1,72 @@
+//==============================================================================
+//      msp430.h stand in for the host tests
+//
+//      the real one comes with IAR.  Only the registers the tested files
+//      touch are here, and the test that builds them defines them (so it
+//      can look at what got written).
+//
+//==============================================================================
+extern volatile unsigned int TB0CCR3;   //the wheels, shapeMacros.h
+extern volatile unsigned int TB0CCR4;
+extern volatile unsigned int TB0CCR5;
+extern volatile unsigned int TB0CCR6;
+
+extern volatile unsigned int P3OUT;     //IOT_RESET, iot.c
+
+//the DMA (dma.c, interrupts_DMA.c) and the eUSCI TX side it feeds
+//bit values are the MSP430FR5994 ones
+#pragma GCC diagnostic ignored "-Wunknown-pragmas"      //#pragma vector
+#define __interrupt
+#define __even_in_range(value, top)     (value)
+#define __get_interrupt_state()         (0)
+#define __disable_interrupt()
+#define __set_interrupt_state(state)    ((void)(state))
+
+//dma.c writes the address registers with (unsigned short)&DMAxSA, which
+//would cut a host pointer down to 16 bits, so the test gets the name
+#define __data16_write_addr(address, value)     Mock_Write_Addr(#address, value)
+extern void Mock_Write_Addr(const char* address, unsigned long value);
+
+extern volatile unsigned int DMACTL0;
+extern volatile unsigned int DMACTL1;
+extern volatile unsigned int DMACTL4;
+extern volatile unsigned int DMAIV;
+extern volatile unsigned int DMA0CTL;
+extern volatile unsigned int DMA1CTL;
+extern volatile unsigned int DMA3CTL;
+extern volatile unsigned int DMA0SZ;
+extern volatile unsigned int DMA1SZ;
+extern volatile unsigned int DMA3SZ;
+extern volatile unsigned long DMA0SA;   //addresses, a pointer's worth
+extern volatile unsigned long DMA0DA;
+extern volatile unsigned long DMA1SA;
+extern volatile unsigned long DMA1DA;
+extern volatile unsigned long DMA3SA;
+extern volatile unsigned long DMA3DA;
+extern volatile unsigned int UCA0IFG;
+extern volatile unsigned int UCA3IFG;
+extern volatile unsigned int UCA0TXBUF;
+extern volatile unsigned int UCA3TXBUF;
+extern volatile unsigned int ADC12MEM8;
+
+#define DMARMWDIS               (0x0001)
+#define DMA0TSEL                (0x001F)
+#define DMA1TSEL                (0x1F00)
+#define DMA3TSEL                (0x1F00)
+#define DMADT_0                 (0x0000)
+#define DMADT_1                 (0x1000)
+#define DMASRCINCR_3            (0x0300)
+#define DMADSTINCR_0            (0x0000)
+#define DMADSTINCR_3            (0x0C00)
+#define DMASRCBYTE              (0x0040)
+#define DMADSTBYTE              (0x0080)
+#define DMAIE                   (0x0004)
+#define DMAEN                   (0x0010)
+#define UCTXIFG                 (0x0002)
+#define DMAIV__NONE             (0x0000)
+#define DMAIV__DMA0IFG          (0x0002)
+#define DMAIV__DMA1IFG          (0x0004)
+#define DMAIV__DMA2IFG          (0x0006)
+#define DMAIV__DMA3IFG          (0x0008)
+#define DMAIV__DMA4IFG          (0x000A)
+#define DMAIV__DMA5IFG          (0x000C)
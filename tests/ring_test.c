@@ -0,0 +1,273 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      ring_test.c
+//
+//      host test and throughput benchmark for ring.c
+//      ring.c is plain C with nothing from msp430.h, so it builds on the PC
+//
+//      from the top of the repo:
+//              gcc -O2 -I. tests/ring_test.c ring.c -o ring_test && ./ring_test
+//
+//      the test part covers
+//              full / empty / count / space
+//              buffer wrap (wr and rd going around the 128 slots)
+//              index wrap (wr and rd going past 0xFFFF... - started near it)
+//              dropped / rejected / high_water
+//              ring_Read_Span / ring_Read_Commit, including a wrapped ring
+//              0x00 chars going through like any other char
+//
+//      the benchmark pushes the same bytes through the ring and through a
+//      copy of the old SMALL_RING_SIZE (50) ring, the one that used 0x00
+//      as the empty marker and cleared every slot behind the reader, and
+//      prints bytes/sec for both.  Host numbers, so only the ratio matters.
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include "macros.h"
+
+#define BENCH_BYTES             (50000000UL)    //per run
+#define OLD_RING_SIZE           (50)            //SMALL_RING_SIZE before ring.c
+#define BENCH_CHUNK             (32)            //bytes per "ISR burst"
+
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//full / empty
+void Test_Full_Empty(void){
+  Ring r = {0};
+  char c;
+  unsigned int i;
+  clear_Ring(&r);
+  CHECK(ring_Count(&r) == EMPTY);
+  CHECK(ring_Space(&r) == RING_SIZE);
+  CHECK(get_Ring_Char(&r, &c) == NO);           //nothing to read
+  for(i=COUNT_RESET; i<RING_SIZE; i++)
+    CHECK(put_Ring_Char(&r, (char)i) == YES);
+  CHECK(ring_Count(&r) == RING_SIZE);
+  CHECK(ring_Space(&r) == EMPTY);
+  CHECK(put_Ring_Char(&r, 'x') == NO);          //full, turned away
+  for(i=COUNT_RESET; i<RING_SIZE; i++){
+    CHECK(get_Ring_Char(&r, &c) == YES);
+    CHECK(c == (char)i);                        //0x00 included
+  }
+  CHECK(get_Ring_Char(&r, &c) == NO);
+  CHECK(ring_Count(&r) == EMPTY);
+}
+
+//go around the buffer a bunch of times, a few chars at a time
+//then again with wr/rd about to roll past UINT_MAX
+void Test_Wrap(unsigned int start){
+  Ring r = {0};
+  char c;
+  unsigned int i;
+  unsigned int j;
+  unsigned char next_in = COUNT_RESET;
+  unsigned char next_out = COUNT_RESET;
+  r.wr = start;
+  r.rd = start;
+  for(i=COUNT_RESET; i<RING_SIZE * 10; i++){
+    for(j=COUNT_RESET; j<7; j++)                //odd sized bites so the
+      CHECK(put_Ring_Char(&r, (char)next_in++)); //buffer end moves around
+    CHECK(ring_Count(&r) == 7);
+    for(j=COUNT_RESET; j<7; j++){
+      CHECK(get_Ring_Char(&r, &c));
+      CHECK((unsigned char)c == next_out);
+      next_out++;
+    }
+    CHECK(ring_Count(&r) == EMPTY);
+  }
+  CHECK(r.wr != start);                         //it really did move
+  if(start > UINT_MAX - RING_SIZE)
+    CHECK(r.wr < start);                        //and rolled over
+}
+
+//the counters
+void Test_Counters(void){
+  Ring r = {0};
+  char data[RING_SIZE];
+  char c;
+  unsigned int i;
+  for(i=COUNT_RESET; i<RING_SIZE; i++)
+    data[i] = 'a' + (i % 26);
+
+  CHECK(ring_Write(&r, data, 100) == 100);
+  CHECK(r.high_water == 100);
+  CHECK(ring_Write(&r, data, 100) == RING_SIZE - 100);  //takes what fits
+  CHECK(r.dropped == 100 - (RING_SIZE - 100));          //the rest is counted
+  CHECK(r.high_water == RING_SIZE);
+  CHECK(put_Ring_Char(&r, 'x') == NO);
+  CHECK(r.dropped == 100 - (RING_SIZE - 100) + 1);
+
+  for(i=COUNT_RESET; i<10; i++)
+    get_Ring_Char(&r, &c);
+  CHECK(ring_Write_All(&r, data, 11) == NO);    //10 free, all or nothing
+  CHECK(r.rejected == 1);
+  CHECK(ring_Count(&r) == RING_SIZE - 10);      //nothing went in
+  CHECK(ring_Write_All(&r, data, 10) == YES);
+  CHECK(ring_Count(&r) == RING_SIZE);
+  CHECK(r.rejected == 1);
+
+  clear_Ring(&r);                               //counters cover the whole run
+  CHECK(r.high_water == RING_SIZE);
+  CHECK(r.rejected == 1);
+  CHECK(ring_Write(&r, data, 5) == 5);
+  CHECK(r.high_water == RING_SIZE);             //never goes back down
+}
+
+//span/commit on a ring that wraps, it takes two spans
+void Test_Span(void){
+  Ring r = {0};
+  volatile char* span;
+  char data[RING_SIZE];
+  char out[RING_SIZE];
+  unsigned int got = COUNT_RESET;
+  unsigned int n;
+  unsigned int i;
+  for(i=COUNT_RESET; i<RING_SIZE; i++)
+    data[i] = (char)(i * 3);
+
+  r.wr = RING_SIZE - 20;                        //20 before the buffer end
+  r.rd = RING_SIZE - 20;
+  CHECK(ring_Write(&r, data, 50) == 50);
+
+  n = ring_Read_Span(&r, &span);
+  CHECK(n == 20);                               //up to the end of the buffer
+  CHECK(span == &r.buffer[RING_SIZE - 20]);
+  for(i=COUNT_RESET; i<5; i++)                  //only use some of it
+    out[got++] = span[i];
+  ring_Read_Commit(&r, 5);
+  CHECK(ring_Count(&r) == 45);
+
+  n = ring_Read_Span(&r, &span);
+  CHECK(n == 15);                               //the rest of the first piece
+  for(i=COUNT_RESET; i<n; i++)
+    out[got++] = span[i];
+  ring_Read_Commit(&r, n);
+
+  n = ring_Read_Span(&r, &span);
+  CHECK(n == 30);                               //the wrapped piece
+  CHECK(span == &r.buffer[COUNT_RESET]);
+  for(i=COUNT_RESET; i<n; i++)
+    out[got++] = span[i];
+  ring_Read_Commit(&r, n);
+
+  CHECK(ring_Read_Span(&r, &span) == EMPTY);
+  CHECK(got == 50);
+  for(i=COUNT_RESET; i<50; i++)
+    CHECK(out[i] == data[i]);
+
+  //a span can't get past wr even when the buffer end is further away
+  r.wr = 3;
+  r.rd = 3;
+  ring_Write(&r, data, 4);
+  CHECK(ring_Read_Span(&r, &span) == 4);
+}
+
+//==============================================================================
+//the old ring, copied from the serial.c before ring.c
+//0x00 meant empty, so the reader had to clear each slot behind it
+volatile char old_ring[OLD_RING_SIZE];
+volatile unsigned int old_wr = COUNT_RESET;
+volatile unsigned int old_rd = COUNT_RESET;
+
+void Old_Put(char c){
+  old_ring[old_wr] = c;
+  old_wr++;
+  if(old_wr >= OLD_RING_SIZE)
+    old_wr = COUNT_RESET;
+}
+
+char Old_Get(void){
+  char myChar = old_ring[old_rd];
+  if(myChar == EMPTY)   return EMPTY;
+  old_ring[old_rd] = EMPTY;
+  old_rd++;
+  if(old_rd >= OLD_RING_SIZE)
+    old_rd = COUNT_RESET;
+  return myChar;
+}
+
+double Seconds(clock_t start){
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+//a burst goes in like the RX ISR would, then the main loop empties it
+void Benchmark(void){
+  unsigned long moved;
+  unsigned long check_old = COUNT_RESET;
+  unsigned long check_get = COUNT_RESET;
+  unsigned long check_span = COUNT_RESET;
+  unsigned int i;
+  unsigned int n;
+  char c;
+  volatile char* span;
+  Ring r = {0};
+  clock_t start;
+  double t_old;
+  double t_get;
+  double t_span;
+
+  start = clock();
+  for(moved=COUNT_RESET; moved<BENCH_BYTES; moved+=BENCH_CHUNK){
+    for(i=COUNT_RESET; i<BENCH_CHUNK; i++)
+      Old_Put((char)('A' + (i & 0x0F)));        //no 0x00, it can't carry one
+    while((c = Old_Get()))
+      check_old += (unsigned char)c;
+  }
+  t_old = Seconds(start);
+
+  start = clock();
+  for(moved=COUNT_RESET; moved<BENCH_BYTES; moved+=BENCH_CHUNK){
+    for(i=COUNT_RESET; i<BENCH_CHUNK; i++)
+      put_Ring_Char(&r, (char)('A' + (i & 0x0F)));
+    while(get_Ring_Char(&r, &c))
+      check_get += (unsigned char)c;
+  }
+  t_get = Seconds(start);
+
+  start = clock();
+  for(moved=COUNT_RESET; moved<BENCH_BYTES; moved+=BENCH_CHUNK){
+    for(i=COUNT_RESET; i<BENCH_CHUNK; i++)
+      put_Ring_Char(&r, (char)('A' + (i & 0x0F)));
+    while((n = ring_Read_Span(&r, &span))){
+      for(i=COUNT_RESET; i<n; i++)
+        check_span += (unsigned char)span[i];
+      ring_Read_Commit(&r, n);
+    }
+  }
+  t_span = Seconds(start);
+
+  CHECK(check_old == check_get);                //same bytes came out of all 3
+  CHECK(check_old == check_span);
+  CHECK(r.dropped == EMPTY);
+
+  printf("throughput, %lu bytes in %d byte bursts\n", BENCH_BYTES, BENCH_CHUNK);
+  printf("  old 50 slot ring        %8.1f MB/s\n", BENCH_BYTES / t_old / 1e6);
+  printf("  ring.c get_Ring_Char    %8.1f MB/s\n", BENCH_BYTES / t_get / 1e6);
+  printf("  ring.c spans            %8.1f MB/s\n", BENCH_BYTES / t_span / 1e6);
+}
+
+//==============================================================================
+int main(void){
+  Test_Full_Empty();
+  Test_Wrap(COUNT_RESET);
+  Test_Wrap(UINT_MAX - 200);                    //indexes roll past the top
+  Test_Counters();
+  Test_Span();
+  Benchmark();
+  if(failures){
+    printf("ring_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("ring_test: passed\n");
+  return 0;
+}
@@ -0,0 +1,226 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      task_test.c
+//
+//      host test for the cooperative tasks (timerMacros.h): the terminal
+//      keeps getting read while a 2 second timed move is going
+//      shapes.c, ring.c and assembler.c are the real ones, the wheels are
+//      plain variables (tests/msp430.h) and the rest of the car is stubbed
+//
+//      from the top of the repo:
+//              gcc -O2 -I. -Itests tests/task_test.c shapes.c ring.c assembler.c -o task_test && ./task_test
+//
+//      Every pass of the make-believe main loop is PASS_MS long and one
+//      char comes in on the terminal during it (a stream of ^1234F0nnn\r
+//      commands, about 9600 baud).  TA0_tick goes up every 100 ms like the
+//      TA0 CCR0 interrupt does it.  The move is the way Command_Process
+//      does one now:  Forward_Timed(2 s), then a task that waits on
+//      !Motion_Busy() while the loop goes on with Motion_Process and the
+//      terminal.
+//
+//      The same move the old way (delay_100ms spinning until it's over,
+//      copied from the timers.c before the tasks) is run after it, to show
+//      what the tasks fixed:  nothing gets read and the ring overflows.
+//
+//      Task_Time_Up/Task_Reset are copied from timers.c, which needs the
+//      real registers to build.
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <string.h>
+#include "macros.h"
+
+#define PASS_MS                 (10)
+#define PASSES_PER_TICK         (100 / PASS_MS) //TA0_tick is 100 ms
+#define MOVE_TIME               (2 * ONE_SECOND)
+#define MOVE_PASSES             (MOVE_TIME * PASSES_PER_TICK)
+#define STREAM_COMMAND_LENGTH   (11)            //^1234F0nnn\r
+
+//the wheels and TA0
+volatile unsigned int TB0CCR3;
+volatile unsigned int TB0CCR4;
+volatile unsigned int TB0CCR5;
+volatile unsigned int TB0CCR6;
+unsigned volatile int TA0_tick = COUNT_RESET;
+
+//what the rest of the car would have given shapes.c
+volatile int ADC_Left_Detector;
+volatile int ADC_Right_Detector;
+float on_threshold;
+float black_threshold;
+float white_threshold;
+float pulse_on_threshold;
+float pulse_black_threshold;
+float pulse_white_threshold;
+char emitter_pulsed;
+volatile char event;
+unsigned int RTC200;
+char runTimer;
+char display_line[NUM_DISPLAY_LINES][NUM_DISPLAY_CHARS];
+char Check_Button_1(void){ return NO; }
+char Check_Button_2(void){ return NO; }
+void Enable_Emitter(void){}
+void Disable_Emitter(void){}
+void clearDisplay(void){}
+void endEvent(void){}
+void resetRTC200(void){}
+void showRTC200(int line){ (void)line; }
+char get_UCA3_RX(void){ return EMPTY; }
+Ring UCA0_Rx_Ring;
+
+//copied from timers.c
+char Task_Time_Up(Task* task){
+  if((int)(TA0_tick - task->deadline) < EMPTY)
+    return NO;
+  return YES;
+}
+
+void Task_Reset(Task* task){
+  task->resume = TASK_START;
+}
+
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//the terminal side
+Assembler pc_assembler;
+unsigned int commands_run = COUNT_RESET;        //out of the assembler
+unsigned int commands_while_moving = COUNT_RESET;
+unsigned int stream_sent = COUNT_RESET;         //chars put on the wire
+
+void Execute_Command(char* command, char source, char cid){
+  char expected[COMMAND_MAX_LENGTH];
+  (void)source;                                 //it's all the terminal
+  (void)cid;
+  sprintf(expected, "^1234F0%03u", commands_run % 1000);
+  CHECK(!strcmp(command, expected));            //none of it got lost
+  commands_run++;
+  if(Motion_Busy())
+    commands_while_moving++;
+}
+
+//one char of the stream, like USCI_A0_ISR
+void Terminal_ISR(void){
+  char command[COMMAND_MAX_LENGTH];
+  unsigned int n = stream_sent / STREAM_COMMAND_LENGTH;
+  unsigned int at = stream_sent % STREAM_COMMAND_LENGTH;
+  sprintf(command, "^1234F0%03u\r", n % 1000);
+  put_Ring_Char(&UCA0_Rx_Ring, command[at]);
+  stream_sent++;
+}
+
+//the PC part of IOT_Communication
+void Terminal_Process(void){
+  volatile char* span;
+  unsigned int span_length;
+  unsigned int i;
+  while((span_length = ring_Read_Span(&UCA0_Rx_Ring, &span))){
+    for(i=COUNT_RESET; i<span_length; i++)
+      Assembler_Char(&pc_assembler, span[i]);
+    ring_Read_Commit(&UCA0_Rx_Ring, span_length);
+  }
+}
+
+//==============================================================================
+//PASS_MS of time going by: a char comes in, the tick moves every so often
+unsigned int pass_count = COUNT_RESET;
+void Time_Goes_By(void){
+  Terminal_ISR();
+  pass_count++;
+  if(!(pass_count % PASSES_PER_TICK))
+    TA0_tick++;
+}
+
+char Wheels_On(void){
+  return (LEFT_FORWARD_SPEED != WHEEL_OFF) && (RIGHT_FORWARD_SPEED != WHEEL_OFF);
+}
+
+//the move, like a command task: start it, wait for it
+Task move_task;
+char Move_Task(void){
+  TASK_BEGIN(&move_task);
+  Forward_Timed(MOVE_TIME);
+  TASK_WAIT_UNTIL(&move_task, !Motion_Busy());
+  TASK_END(&move_task);
+}
+
+//the old way, from the timers.c/shapes.c before the tasks
+unsigned int delay_timer = COUNT_RESET;
+void Old_Timer_Process(void){                   //the tick is the only time there is
+  unsigned int tick = TA0_tick;
+  Time_Goes_By();
+  if(TA0_tick != tick)
+    delay_timer++;
+}
+
+void Old_Forward_Timed(int num_ms){
+  Forward_Move();
+  delay_timer = NO;
+  while(delay_timer != (unsigned int)num_ms)
+    Old_Timer_Process();
+  Brake_All();
+}
+
+//==============================================================================
+int main(void){
+  unsigned int passes = COUNT_RESET;
+  unsigned int wheel_passes = COUNT_RESET;
+  unsigned int most_waiting = COUNT_RESET;
+  unsigned int start_tick;
+  unsigned int before;
+
+  Init_Assembler(&pc_assembler, COMMAND_SOURCE_PC, TCP_NO_CID, YES);
+  Motors_Off();
+
+  //the new way ===============================================================
+  TA0_tick = 0xFFF0;                            //and the tick wraps mid move
+  start_tick = TA0_tick;
+  Task_Reset(&move_task);
+  while(Move_Task() == TASK_WAITING){           //one pass of the OS loop
+    if(Wheels_On())
+      wheel_passes++;
+    if(ring_Count(&UCA0_Rx_Ring) > most_waiting)
+      most_waiting = ring_Count(&UCA0_Rx_Ring);
+    Time_Goes_By();
+    Motion_Process();
+    Terminal_Process();
+    passes++;
+    CHECK(passes < MOVE_PASSES * 2);            //it has to end
+    if(passes >= MOVE_PASSES * 2)
+      break;
+  }
+  printf("tasks:       move took %u ticks, %u passes with the wheels on\n",
+         (unsigned int)(TA0_tick - start_tick), wheel_passes);
+  printf("             %u chars came in, %u commands read during the move, "
+         "%u dropped, %u waiting at most\n",
+         stream_sent, commands_while_moving, UCA0_Rx_Ring.dropped, most_waiting);
+  CHECK(!Wheels_On());                          //it stopped
+  CHECK((unsigned int)(TA0_tick - start_tick) >= MOVE_TIME);
+  CHECK((unsigned int)(TA0_tick - start_tick) <= MOVE_TIME + ADJUST_1);
+  CHECK(wheel_passes >= MOVE_PASSES - PASSES_PER_TICK);
+  CHECK(commands_while_moving >= MOVE_PASSES / STREAM_COMMAND_LENGTH - ADJUST_1);
+  CHECK(UCA0_Rx_Ring.dropped == EMPTY);
+  CHECK(most_waiting <= ADJUST_1);              //read every pass
+
+  //the old way ===============================================================
+  before = commands_run;
+  Old_Forward_Timed(MOVE_TIME);
+  printf("delay_100ms: %u commands read during the move, %u dropped\n",
+         commands_run - before, UCA0_Rx_Ring.dropped);
+  CHECK(commands_run == before);                //nothing read while it spun
+  CHECK(UCA0_Rx_Ring.dropped > EMPTY);          //200 chars into 128
+
+  if(failures){
+    printf("task_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("task_test: passed\n");
+  return 0;
+}
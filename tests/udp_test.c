@@ -0,0 +1,512 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      udp_test.c
+//
+//      host test for the UDP control channel (udp.c), and command to PWM
+//      latency over UDP and TCP with a stand-in for the module and the wifi
+//      frames.c, udp.c, session.c, assembler.c, commands.c, iot.c and ring.c
+//      are the real ones, the wheels, the timer and the module are played by
+//      this file (Execute_Command and the pin check are copied from serial.c)
+//
+//      from the top of the repo:
+//              gcc -O2 -I. -Itests tests/udp_test.c frames.c udp.c session.c assembler.c commands.c iot.c ring.c -o udp_test && ./udp_test
+//
+//      Every char goes in through Frame_RX_Char like USCI_A3_ISR, and the
+//      loop pass does what IOT_Communication and Command_Process do.  A
+//      move starts the wheels in Execute_Command_FRAM, which is where
+//      Stats_Latency (Q1) gets called, so the numbers here are the Q1 ones.
+//
+//      the test part covers
+//              D1 through the AT engine (AT+NSUDP, CONNECT <cid>, OK)
+//              <ESC>u datagram framing, the address skipped
+//              the pin checked before the seq, a bad pin can't move it
+//              stale and duplicate seqs dropped, any seq after a quiet
+//              UDP_RESYNC_TIME
+//              malformed datagrams (no seq, no ':', empty, UDP off), and a
+//              datagram that never ended, the next one still gets through
+//              the newest datagram throws out the move that's going
+//      ints are 32 bits here, so the wrap at 65535 isn't tested
+//
+//      the latency part sends a steering command every SEND_EVERY_MS for
+//      STEER_COMMANDS, once as UDP datagrams and once over a TCP stream,
+//      through a make-believe wifi link:  BASE_DELAY_MS plus up to
+//      JITTER_MS each way, and some packets lost.  UDP just loses them, TCP
+//      resends them after RTO_MS and holds up everything behind them
+//      (head-of-line blocking).  For each way in it prints how old the
+//      commands were when they started the wheels, counted from when the
+//      controller sent them, how many old ones ran after a newer one, and
+//      the most Q1 saw (from the frame coming in to the wheels, what the
+//      car can measure by itself).
+//      Every move is MOVE_MS, and the command's argument is its number.
+//
+//      then it times both dispatch paths on the host (frame in to command
+//      queued), host numbers so only the ratio matters
+//
+//      exits 0 if everything passed, 1 if anything failed
+//
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "macros.h"
+
+#define PASS_US                 (1000)          //one OS loop pass
+#define US_PER_MS               (1000UL)
+#define US_PER_TICK             (100000UL)      //TA0_tick, 100 ms
+#define US_PER_TIMER_COUNT      (2)             //Timer_Now() is 2 us a count
+#define MOVE_MS                 (40)
+#define SEND_EVERY_MS           (50)
+#define STEER_COMMANDS          (2000)
+#define BASE_DELAY_MS           (5)
+#define JITTER_MS               (60)            //wifi, on a bad day
+#define RTO_MS                  (200)           //the least a TCP resend waits
+#define LOSS_PERCENT            (3)
+#define DISPATCH_RUNS           (1000000UL)
+#define FRAME_TEXT_MAX          (COMMAND_MAX_LENGTH + 32)    //the data and the frame around it
+#define UDP_CID                 ('3')
+#define TCP_CID                 ('1')
+#define NOT_RUN                 (0xFFFFFFFFUL)
+
+//what the rest of the car would have given them
+unsigned volatile int TA0_tick = COUNT_RESET;
+volatile unsigned int P3OUT = IOT_RESET;
+unsigned long current_Baud_3 = BAUD115200;
+char display_line[NUM_DISPLAY_LINES][NUM_DISPLAY_CHARS];
+Ring UCA3_Rx_Ring;
+volatile unsigned int bulk_frames_received = COUNT_RESET;
+char sent_to_module[FRAME_TEXT_MAX];            //the last thing the AT engine sent
+unsigned long now_us = COUNT_RESET;
+unsigned long wheels_until = COUNT_RESET;       //now_us the move is over
+unsigned int bad_pins = COUNT_RESET;
+
+char read_UCA3_RX(char* c){ return get_Ring_Char(&UCA3_Rx_Ring, c); }
+char setBaud_UCA3(unsigned long baud){ current_Baud_3 = baud; return YES; }
+char Baud_Possible(unsigned long baud){ (void)baud; return YES; }
+char transmitString_UCA3(char* str){ strcpy(sent_to_module, str); return YES; }
+char Command_Reply(char source, char cid, const char* data, unsigned int length){
+  (void)source; (void)cid; (void)data; (void)length;
+  return YES;
+}
+void Stats_Bad_Pin(char port){ (void)port; bad_pins++; }
+unsigned long Timer_Now(void){ return now_us / US_PER_TIMER_COUNT; }
+char Motion_Busy(void){ return now_us < wheels_until; }
+void Motion_Stop(void){ wheels_until = now_us; }
+
+//copied from timers.c
+char Task_Time_Up(Task* task){
+  if((int)(TA0_tick - task->deadline) < EMPTY)
+    return NO;
+  return YES;
+}
+
+void Task_Reset(Task* task){
+  task->resume = TASK_START;
+}
+
+//copied from serial.c, less the display
+int get_Pin_From_Command_Char(char* command){
+  int i = COMMAND_PIN_INDEX;
+  int parse_num = EMPTY;
+  while(command[i] != '^' && command[i] != EMPTY){
+    parse_num*=MOVE_UP_A_TENS_PLACE;
+    parse_num+=(command[i]-MAKE_A_CHAR);
+    i++;
+    if(i==COMMAND_DIRECTION_INDEX){
+      break;
+    }
+  }
+  return parse_num;
+}
+
+char Command_Pin_OK(char* command){
+  return (get_Pin_From_Command_Char(command) == COMMAND_PIN);
+}
+
+void Execute_Command(char* command, char source, char cid){
+  int my_pin = get_Pin_From_Command_Char(command);
+  if(my_pin != COMMAND_PIN)
+    Stats_Bad_Pin(source);
+  if(my_pin == COMMAND_PIN)
+    if(command[COMMAND_DIRECTION_INDEX] == '^')
+      Queue_Command_Batch(&command[COMMAND_LETTER_INDEX], source, cid);
+}
+
+extern unsigned int datagrams_accepted;         //udp.c
+extern unsigned int datagrams_stale;
+extern unsigned int datagrams_malformed;
+extern unsigned int datagrams_bad_pin;
+extern char udp_enabled;
+extern char udp_server_cid;
+extern volatile unsigned int frames_rejected;   //frames.c
+unsigned int command_Queue_Space(void);         //commands.c
+
+int failures = COUNT_RESET;
+
+#define CHECK(cond)     do{ if(!(cond)){ failures++; \
+                          printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); } \
+                        }while(0)
+
+//==============================================================================
+//the wheels: every move is MOVE_MS, the argument is which command it was
+unsigned long started_at[STEER_COMMANDS];       //now_us it started, NOT_RUN if never
+int last_started = -1;                          //the newest command that has run
+unsigned int ran_late = COUNT_RESET;            //ran after a newer one already had
+unsigned int moves = COUNT_RESET;
+unsigned long latency_max[NUM_VIAS];            //the biggest Stats_Latency got, Q1's max
+
+void Execute_Command_FRAM(char letter, int argument){
+  if(letter != 'f' && letter != 'l' && letter != 'r')
+    return;
+  wheels_until = now_us + MOVE_MS * US_PER_MS;
+  moves++;
+  if(argument < EMPTY || argument >= STEER_COMMANDS)
+    return;
+  if(started_at[argument] == NOT_RUN)
+    started_at[argument] = now_us;
+  if(argument < last_started)
+    ran_late++;
+  else
+    last_started = argument;
+}
+
+//Q1's max (stats.c), arrival to the wheels
+void Stats_Latency(char via, unsigned long arrival){
+  unsigned long units = (Timer_Now() - arrival) / LATENCY_COUNTS_PER_UNIT;
+  if(units > latency_max[(unsigned char)via])
+    latency_max[(unsigned char)via] = units;
+}
+
+//the main loop's part in this
+void Loop_Pass(void){
+  Frame* frame;
+  while((frame = get_Frame())){
+    Session_Frame(frame);
+    release_Frame();
+  }
+  AT_Process();
+  Command_Process();
+}
+
+void Time_Goes_By(unsigned long us){
+  now_us += us;
+  TA0_tick = now_us / US_PER_TICK;
+}
+
+void Feed(const char* text){
+  while(*text)
+    Frame_RX_Char(*text++);
+}
+
+//<ESC>u<n><ip> <port><tab>DATA<ESC>E
+void Datagram(char* out, const char* data){
+  sprintf(out, "\x1Bu%c10.0.0.5 5000\t%s\x1B" "E", UDP_CID, data);
+}
+
+void Send_Datagram(const char* data){
+  char text[FRAME_TEXT_MAX];
+  Datagram(text, data);
+  Feed(text);
+  Loop_Pass();
+}
+
+//<ESC>S<n>COMMAND<ESC>E
+void TCP_Frame(char* out, const char* data){
+  sprintf(out, "\x1BS%c%s\x1B" "E", TCP_CID, data);
+}
+
+void Reset_Wheels(void){
+  unsigned int i;
+  for(i=COUNT_RESET; i<STEER_COMMANDS; i++)
+    started_at[i] = NOT_RUN;
+  last_started = -1;
+  ran_late = COUNT_RESET;
+  moves = COUNT_RESET;
+  wheels_until = now_us;
+  for(i=COUNT_RESET; i<NUM_VIAS; i++)
+    latency_max[i] = COUNT_RESET;
+  clear_Command_Queue();
+}
+
+//==============================================================================
+//D1, the way the module answers it
+void Open_UDP(void){
+  unsigned int i;
+  Start_UDP(YES);
+  Loop_Pass();                                  //the AT engine sends it
+  CHECK(!strcmp(sent_to_module, UDP_PORT_COMMAND));
+  Feed("\r\nCONNECT 3\r\n\r\nOK\r\n");          //module chatter, not a frame
+  for(i=COUNT_RESET; i<3; i++)
+    Loop_Pass();
+  CHECK(udp_enabled);
+  CHECK(udp_server_cid == UDP_CID);
+  CHECK(!AT_Busy());
+}
+
+void Test_Datagrams(void){
+  unsigned int accepted;
+  unsigned int stale;
+  unsigned int malformed;
+  unsigned int rejected;
+
+  Reset_Wheels();
+  Send_Datagram("5:6824^f7");                   //off, so it's nothing
+  CHECK(datagrams_malformed == 1);
+  CHECK(moves == EMPTY);
+
+  Open_UDP();
+  Send_Datagram("17:6824^f1");
+  CHECK(datagrams_accepted == 1);
+  CHECK(moves == 1);
+  CHECK(started_at[1] != NOT_RUN);
+
+  stale = datagrams_stale;                      //the same one again, and an older one
+  Send_Datagram("17:6824^f2");
+  Send_Datagram("16:6824^f3");
+  CHECK(datagrams_stale == stale + 2);
+  CHECK(moves == 1);
+  Send_Datagram("19:6824^f4");                  //newer, even with one missing
+  CHECK(moves == 2);
+
+  Send_Datagram("60000:1111^f5");               //wrong pin, big seq
+  CHECK(datagrams_bad_pin == 1);
+  CHECK(moves == 2);
+  Send_Datagram("20:6824^f6");                  //didn't lock anybody out
+  CHECK(moves == 3);
+
+  malformed = datagrams_malformed;              //what doesn't look like one
+  Send_Datagram("6824^f7");                     //no seq
+  Send_Datagram("21^f7");                       //no ':'
+  Send_Datagram(":6824^f7");
+  Send_Datagram("");
+  CHECK(datagrams_malformed == malformed + 4);
+  CHECK(moves == 3);
+
+  rejected = frames_rejected;                   //one that never ended
+  Feed("\x1Bu3 10.0.0.5 5000\t22:6824^f8");
+  Send_Datagram("23:6824^f9");
+  CHECK(frames_rejected == rejected + 1);
+  CHECK(started_at[8] == NOT_RUN);
+  CHECK(started_at[9] != NOT_RUN);
+
+  accepted = datagrams_accepted;                //the controller restarts from 0
+  Send_Datagram("0:6824^f10");
+  CHECK(datagrams_accepted == accepted);        //too soon
+  Time_Goes_By(UDP_RESYNC_TIME * US_PER_TICK);
+  Send_Datagram("0:6824^f11");
+  CHECK(datagrams_accepted == accepted + 1);
+  CHECK(started_at[11] != NOT_RUN);
+
+  Time_Goes_By(MOVE_MS * US_PER_MS);            //the newest one wins
+  Reset_Wheels();
+  Send_Datagram("1:6824^f12;f13;f14");          //three moves queued
+  CHECK(started_at[12] != NOT_RUN);
+  Time_Goes_By(PASS_US);
+  Send_Datagram("2:6824^r15");                  //throws out 13 and 14
+  CHECK(started_at[15] == now_us);
+  Time_Goes_By(MOVE_MS * US_PER_MS * 3);
+  Loop_Pass();
+  CHECK(started_at[13] == NOT_RUN);
+  CHECK(started_at[14] == NOT_RUN);
+  CHECK(datagrams_bad_pin == 1);
+  CHECK(bad_pins == EMPTY);                     //udp.c counts its own
+}
+
+//==============================================================================
+//the wifi: each packet gets there BASE_DELAY_MS + up to JITTER_MS later,
+//or not at all
+unsigned long seed = 12345;
+unsigned long Random(unsigned long range){
+  seed = seed * 1103515245UL + 12345;
+  return ((seed >> 16) & 0x7FFF) % range;
+}
+
+char Lost(void){
+  return Random(100) < LOSS_PERCENT;
+}
+
+unsigned long Wifi_Delay(void){
+  return (BASE_DELAY_MS + Random(JITTER_MS + ADJUST_1)) * US_PER_MS;
+}
+
+typedef struct {
+  unsigned long at;                     //now_us it gets to the module
+  char text[FRAME_TEXT_MAX];
+} Packet;
+
+Packet packets[STEER_COMMANDS];
+unsigned int num_packets;
+
+typedef struct {
+  const char* name;
+  unsigned int ran;
+  unsigned int ran_late;
+  unsigned int lost;
+  unsigned long mean_ms;
+  unsigned long p99_ms;
+  unsigned long max_ms;
+  unsigned long q1_units;               //Q1's max, 0.1 ms
+} Steer_Result;
+
+int Compare_Packets(const void* a, const void* b){
+  unsigned long at_a = ((const Packet*)a)->at;
+  unsigned long at_b = ((const Packet*)b)->at;
+  return (at_a > at_b) - (at_a < at_b);
+}
+
+int Compare_Longs(const void* a, const void* b){
+  unsigned long x = *(const unsigned long*)a;
+  unsigned long y = *(const unsigned long*)b;
+  return (x > y) - (x < y);
+}
+
+//controller sends command n at n * SEND_EVERY_MS after start
+void Make_Packets(char udp, unsigned long start){
+  char data[COMMAND_MAX_LENGTH];
+  unsigned long sent;
+  unsigned long at;
+  unsigned long stream_at = start;              //TCP: nothing passes the one before
+  unsigned int n;
+  num_packets = COUNT_RESET;
+  seed = 12345;                                 //the same wifi for both
+  for(n=COUNT_RESET; n<STEER_COMMANDS; n++){
+    sent = start + n * SEND_EVERY_MS * US_PER_MS;
+    if(udp){
+      if(Lost())
+        continue;
+      sprintf(data, "%u:6824^%c%u", n, "flr"[n % 3], n);
+      Datagram(packets[num_packets].text, data);
+      packets[num_packets].at = sent + Wifi_Delay();
+    }
+    else{
+      at = sent;
+      while(Lost())                             //resent until it gets there
+        at += RTO_MS * US_PER_MS;
+      at += Wifi_Delay();
+      if(at < stream_at)                        //in order, behind the last one
+        at = stream_at;
+      stream_at = at;
+      sprintf(data, "6824^%c%u", "flr"[n % 3], n);
+      TCP_Frame(packets[num_packets].text, data);
+      packets[num_packets].at = at;
+    }
+    num_packets++;
+  }
+  qsort(packets, num_packets, sizeof(Packet), Compare_Packets);
+}
+
+void Steer(Steer_Result* r, char udp){
+  static unsigned long ages[STEER_COMMANDS];
+  unsigned long start;
+  unsigned long sum = COUNT_RESET;
+  unsigned int next = COUNT_RESET;
+  unsigned int n;
+
+  Time_Goes_By(UDP_RESYNC_TIME * US_PER_TICK);  //any seq goes
+  Reset_Wheels();
+  start = now_us;
+  Make_Packets(udp, start);
+  while(next < num_packets || Motion_Busy()
+        || command_Queue_Space() != COMMAND_QUEUE_SIZE){  //till it's all run
+    if(next < num_packets && packets[next].at <= now_us)
+      Feed(packets[next++].text);               //one a pass, about the line rate
+    Loop_Pass();
+    Time_Goes_By(PASS_US);
+  }
+
+  r->ran = COUNT_RESET;
+  for(n=COUNT_RESET; n<STEER_COMMANDS; n++){
+    if(started_at[n] == NOT_RUN)
+      continue;
+    ages[r->ran] = (started_at[n] - (start + n * SEND_EVERY_MS * US_PER_MS)) / US_PER_MS;
+    sum += ages[r->ran];
+    r->ran++;
+  }
+  qsort(ages, r->ran, sizeof(ages[0]), Compare_Longs);
+  r->ran_late = ran_late;
+  r->lost = STEER_COMMANDS - r->ran;
+  r->mean_ms = r->ran ? sum / r->ran : 0;
+  r->p99_ms = r->ran ? ages[r->ran * 99 / 100] : 0;
+  r->max_ms = r->ran ? ages[r->ran - ADJUST_1] : 0;
+  r->q1_units = latency_max[udp ? VIA_UDP : VIA_TCP];
+}
+
+void Test_Latency(void){
+  Steer_Result results[2] = {{.name = "TCP"}, {.name = "UDP"}};
+  unsigned int i;
+  Steer(&results[0], NO);
+  Steer(&results[1], YES);
+  printf("%d steering commands %d ms apart, %d%% lost, %d-%d ms each way, "
+         "TCP resends after %d ms\n", STEER_COMMANDS, SEND_EVERY_MS, LOSS_PERCENT,
+         BASE_DELAY_MS, BASE_DELAY_MS + JITTER_MS, RTO_MS);
+  printf("age at the wheels, ms from when the controller sent it:\n");
+  printf("%-4s %6s %6s %6s %6s %6s %9s %8s\n",
+         "", "ran", "lost", "mean", "p99", "max", "ran late", "Q1 max");
+  for(i=COUNT_RESET; i<2; i++)
+    printf("%-4s %6u %6u %6lu %6lu %6lu %9u %5lu.%lu\n", results[i].name,
+           results[i].ran, results[i].lost, results[i].mean_ms, results[i].p99_ms,
+           results[i].max_ms, results[i].ran_late,
+           results[i].q1_units / 10, results[i].q1_units % 10);
+
+  CHECK(results[0].lost == EMPTY);              //TCP gets them all there
+  CHECK(results[0].ran_late == EMPTY);          //in order
+  CHECK(results[1].ran_late == EMPTY);          //UDP never runs an old one
+  CHECK(results[1].lost > EMPTY);               //the price
+  CHECK(results[1].max_ms <= BASE_DELAY_MS + JITTER_MS + ADJUST_1);
+  CHECK(results[1].max_ms < results[0].max_ms);
+  CHECK(results[1].p99_ms < results[0].p99_ms);
+  CHECK(results[1].q1_units < results[0].q1_units);      //nothing waits behind an old one
+}
+
+//==============================================================================
+//frame in to command queued, both ways, host time
+double Dispatch_NS(char udp){
+  char text[FRAME_TEXT_MAX];
+  char data[COMMAND_MAX_LENGTH];
+  unsigned long n;
+  clock_t start;
+  Frame* frame;
+  Time_Goes_By(UDP_RESYNC_TIME * US_PER_TICK);
+  Reset_Wheels();
+  start = clock();
+  for(n=COUNT_RESET; n<DISPATCH_RUNS; n++){
+    if(udp){
+      sprintf(data, "%lu:6824^f1", n);
+      Datagram(text, data);
+    }
+    else{
+      sprintf(data, "6824^f%lu", n);
+      TCP_Frame(text, data);
+    }
+    Feed(text);
+    while((frame = get_Frame())){
+      Session_Frame(frame);
+      release_Frame();
+    }
+    clear_Command_Queue();
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / DISPATCH_RUNS;
+}
+
+void Test_Dispatch(void){
+  double tcp = Dispatch_NS(NO);
+  double udp = Dispatch_NS(YES);
+  printf("dispatch, frame in to command queued (host, with the sprintf):\n");
+  printf("  TCP frame -> session assembler   %6.0f ns\n", tcp);
+  printf("  UDP datagram -> UDP_Datagram      %6.0f ns\n", udp);
+}
+
+//==============================================================================
+int main(void){
+  clear_Ring(&UCA3_Rx_Ring);
+  Test_Datagrams();
+  Test_Latency();
+  Test_Dispatch();
+  if(failures){
+    printf("udp_test: %d FAILED\n", failures);
+    return 1;
+  }
+  printf("udp_test: passed\n");
+  return 0;
+}
@@ -13,15 +13,20 @@
 
 extern void Init_Timers(void);
 extern void Init_Timer_A0(void);
+extern void Init_Timer_A1(void);
+extern void Timer_A1_Rate(unsigned int hz);
 extern void Init_Timer_B0(void);
 
 extern void Timer_Process(void);
-extern void delay_100ms(int delay_amount);
+extern void delay_100ms(int delay_amount);     //blocks! init only, use TASK_DELAY
 extern void Show_RTC200_Process(void);
+extern unsigned long Timer_Now(void);          //TA0R counts, see timers.c
+extern unsigned long Timer_Since(unsigned long then);
 
 
 //extern unsigned volatile char update_display_count;
 extern unsigned volatile int TA0_CCR0_COUNT;
+extern unsigned volatile int TA0_tick;
 extern unsigned volatile int TA0_CCR1_COUNT;
 extern volatile unsigned int my_lcd_count;
 
@@ -35,6 +40,14 @@ extern volatile unsigned int my_lcd_count;
 #define TIMERA0_100MS   (50000)
 #define TA0CCR0_INTERVAL        TIMERA0_100MS    //the main timer used in Timer Process
 #define TA0CCR1_INTERVAL        TIMERA0_100MS    //the button debounce timer, enabled/disabled often
+#define TIMER_NOW_WRAP  (65536UL * TA0CCR0_INTERVAL)    //Timer_Now() goes back to 0 here
+
+//Timer A1 runs off SMCLK and starts the ADC conversions (G<hz>, Set_ADC_Rate)
+//ADC sequences a second, TA1 goes ADC_SEQUENCE_LENGTH times that
+#define ADC_RATE_MIN            (1000)
+#define ADC_RATE_MAX            (5000)   //4 conversions of 192+14 MODOSC clocks (typical) fit in 200us
+#define ADC_RATE_DEFAULT        (2000)
+#define TA1_MAX_PERIOD          (65536UL)        //TA1CCR0 + 1, it's a 16 bit timer
 
 #define TIMER_IV_MAX    (14)
 #define CCR_NOFLAG      (0x00)
@@ -83,4 +96,54 @@ extern void resetRTC200(void);         //restarts RTC200 at 00:00.00
 
 #define DISPLAY_UPDATE_TIME  (2)          //how often to update the lcd display (in hundred ms)
 
+
+
+//Cooperative Tasks ============================================================
+//a task is a function that can wait without blocking the OS loop
+//every call it picks up where it left off, and returns TASK_WAITING until
+//it reaches TASK_END, then TASK_DONE (and starts over from the top next time)
+//
+//      char Blink_Task(void){
+//        static Task task;
+//        TASK_BEGIN(&task);
+//        P5OUT |= LCD_BACKLITE;
+//        TASK_DELAY(&task, ONE_SECOND);        //the OS loop keeps going
+//        P5OUT &= ~LCD_BACKLITE;
+//        TASK_END(&task);
+//      }
+//
+//the rules (it's a switch statement in disguise):
+//      - only one TASK_DELAY/TASK_WAIT_UNTIL per line
+//      - no TASK_xxx inside of another switch statement in the task
+//      - local variables are forgotten at every wait, use statics
+//      - Task_Reset() before reusing a task that got abandoned halfway
+typedef struct {
+  unsigned int resume;          //where to pick back up (a line number)
+  unsigned int deadline;        //the TA0_tick that TASK_DELAY waits for
+} Task;
+
+#define TASK_WAITING    (0)
+#define TASK_DONE       (1)
+#define TASK_START      (0)
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)        //the host tests (tests/)
+#define TASK_FALLTHROUGH        __attribute__((fallthrough))
+#else
+#define TASK_FALLTHROUGH                        //IAR doesn't warn about it
+#endif
+
+//falling into the next case is the whole point, TASK_FALLTHROUGH says so
+#define TASK_BEGIN(task)        switch((task)->resume){ case TASK_START:
+#define TASK_WAIT_UNTIL(task, condition)                        \
+        (task)->resume = __LINE__; TASK_FALLTHROUGH;            \
+        case __LINE__:                                          \
+        if(!(condition)) return TASK_WAITING
+#define TASK_DELAY(task, ticks)                                 \
+        (task)->deadline = TA0_tick + (ticks);                  \
+        TASK_WAIT_UNTIL(task, Task_Time_Up(task))
+#define TASK_END(task)          } (task)->resume = TASK_START; return TASK_DONE
+
+extern char Task_Time_Up(Task* task);
+extern void Task_Reset(Task* task);
+
 #endif
@@ -14,8 +14,14 @@
 //              Timer_Process(void)
 //              Init_Timers(void)
 //              Init_Timer_A0(void)
+//              Init_Timer_A1(void)
 //              Init_Timer_B0(void)
+//              Timer_A1_Rate(unsigned int hz)
 //              delay_100ms(int)
+//              Task_Time_Up(Task*)
+//              Task_Reset(Task*)
+//              Timer_Now(void)
+//              Timer_Since(unsigned long then)
 //              Show_RTC200_Process(void)
 //              resetRTC200(void)
 
@@ -27,6 +33,7 @@
 #include  <string.h>
 
 unsigned volatile int TA0_CCR0_COUNT = COUNT_RESET;        //increments every 100ms
+unsigned volatile int TA0_tick = COUNT_RESET;              //same, but never reset (free running)
 extern volatile unsigned int my_lcd_count = COUNT_RESET;   //how often to update LCD
 
 extern char runTimer = YES;             //set to NO to pause RTC200
@@ -92,12 +99,57 @@ extern void Show_RTC200_Process(void){
 //====================================================
 //            real time delay function
 //====================================================
+//nothing else runs while this waits (no serial, no ADC, no events)
+//so it's only for init, everything else uses TASK_DELAY
 void delay_100ms(int delay_amount) {
   delay_timer = NO;
   while(delay_timer!=delay_amount)Timer_Process();
 }
 
 
+//====================================================
+//            cooperative task helpers
+//====================================================
+//see timerMacros.h for the TASK_xxx macros
+//has TA0_tick reached the deadline yet? (signed, so the wrap is fine)
+char Task_Time_Up(Task* task){
+  if((int)(TA0_tick - task->deadline) < EMPTY)
+    return NO;
+  return YES;
+}
+
+//next call starts the task from the top
+void Task_Reset(Task* task){
+  task->resume = TASK_START;
+}
+
+//fine grained time, in TA0R counts (2 us), for measuring short things
+//TA0_tick says which 100ms we're in, TA0R - the last CCR0 match says how
+//far into it.  If the CCR0 interrupt is pending (we're in another ISR)
+//neither has moved yet, so the answer still comes out right.
+//wraps when TA0_tick does (every 109 minutes), use Timer_Since to subtract
+unsigned long Timer_Now(void){
+  unsigned int tick;
+  unsigned int count;
+  unsigned int next_tick_at;
+  do{                                           //try again if the tick went by
+    tick = TA0_tick;
+    count = TA0R;
+    next_tick_at = TA0CCR0;
+  }while(tick != TA0_tick);
+  return (unsigned long)tick * TA0CCR0_INTERVAL
+         + (unsigned int)(count - (next_tick_at - TA0CCR0_INTERVAL));
+}
+
+//counts since then (a Timer_Now()), the wrap isn't at 2^32 so it's done here
+unsigned long Timer_Since(unsigned long then){
+  unsigned long now = Timer_Now();
+  if(now >= then)
+    return now - then;
+  return TIMER_NOW_WRAP - (then - now);
+}
+
+
 
 //====================================================
 //            Initialization Functions 
@@ -118,6 +170,7 @@ void delay_100ms(int delay_amount) {
 //Call this to set up all of the timers
 void Init_Timers(void) {
   Init_Timer_A0();
+  Init_Timer_A1();
   Init_Timer_B0();
 }
 
@@ -144,6 +197,31 @@ void Init_Timer_A0(void) {
 }
 
 
+//Timer A1 paces the ADC, TA1.1 starts each conversion (see Set_ADC_Rate)
+//it only goes to the ADC, not to a pin
+void Init_Timer_A1(void) {
+  TA1CTL = TASSEL__SMCLK;       //use SMCLK as the source, no divider
+  TA1CTL |= TACLR;              //stopped until Timer_A1_Rate
+  TA1CCTL1 = OUTMOD_7;          //Reset/Set - TA1.1 goes high at the top of every period
+}
+
+//hz rising edges a second on TA1.1, 0 stops it
+//the period comes from the clock registers, so it follows SMCLK if that changes
+void Timer_A1_Rate(unsigned int hz) {
+  unsigned long period;
+  TA1CTL &= ~MC__UPDOWN;        //MC = 0, stop
+  if(!hz)
+    return;
+  period = get_SMCLK_Frequency() / hz;
+  if(period > TA1_MAX_PERIOD)                   //too slow for 16 bits, as slow as it goes
+    period = TA1_MAX_PERIOD;
+  TA1CCR0 = (unsigned int)period - ADJUST_1;    //up mode counts 0 to TA1CCR0
+  TA1CCR1 = TA1CCR0 >> ADJUST_1;                //half high, half low
+  TA1CTL |= TACLR;
+  TA1CTL |= MC__UP;
+}
+
+
 void Init_Timer_B0(void) {
 // SMCLK source, up count mode, PWM Right Side    
 // TB0.1 P3.6 R_REVERSE
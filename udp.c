@@ -0,0 +1,166 @@
+//==============================================================================
+//      Chris Hamby Presents...
+//
+//      udp.c
+//
+//      UDP control channel, for joystick style driving
+//
+//      Over TCP one lost packet holds up everything behind it until it's
+//      resent, so a steering command can show up way late, and a late one
+//      is worse than none.  D1 opens a UDP port (4167) next to the TCP one
+//      (4166 stays up for everything else), D0 closes it again.
+//
+//      The module hands us each datagram as
+//                              <ESC>u<n><ip> <port><tab>DATA<ESC>E
+//      (frames.c takes care of that), and DATA is
+//                              <seq>:<pin>^<commands>          e.g. 17:6824^f3
+//      seq is a decimal number that goes up by one (or more) every datagram
+//      and wraps at 65535.  A datagram that isn't newer than the newest one
+//      so far got passed on the way here, it's stale, and it's dropped.
+//      Nothing for UDP_RESYNC_TIME and any seq is taken again, so a
+//      controller that restarts from 0 doesn't get ignored.
+//
+//      The pin is checked before any of that, and a datagram with the wrong
+//      one is counted in datagrams_bad_pin and doesn't move the seq, so a
+//      stray packet with a big seq can't lock the real controller out.
+//
+//      The newest datagram always wins:  whatever the car is doing and
+//      whatever is still queued is thrown out, then its commands run right
+//      away.
+//
+//      UDP is drive only.  There's no reply to a datagram, so Q, P and the
+//      rest still want TCP or the terminal.  Text commands only, binary
+//      commands have their own sequence number and stay on TCP.
+//
+//      global functions
+//              Start_UDP(char on)
+//              UDP_Datagram(Frame* frame)
+//              clear_UDP(void)
+//
+//      local functions
+//              UDP_Server_Char(char c)
+//              UDP_Server_Done(char result)
+//              UDP_Close_Done(char result)
+//
+//==============================================================================
+#include "macros.h"
+#include  "functions.h"
+#include <string.h>
+
+void UDP_Server_Char(char c);
+void UDP_Server_Done(char result);
+void UDP_Close_Done(char result);
+
+char udp_enabled = NO;                          //datagrams are thrown out until D1 works
+char udp_server_cid = TCP_NO_CID;               //the module's <n> for the UDP port
+char udp_server_next = NO;                      //the next reply char is the cid
+AT_Matcher udp_server_matcher = {UDP_SERVER_TOKEN, COUNT_RESET};
+char udp_close_command[UDP_CLOSE_LENGTH] = UDP_CLOSE_COMMAND;
+
+char udp_seen = NO;                             //got a seq yet?
+unsigned int udp_last_seq = COUNT_RESET;        //the newest one
+unsigned int udp_last_tick = COUNT_RESET;       //TA0_tick when it came in
+unsigned int datagrams_accepted  = COUNT_RESET;
+unsigned int datagrams_stale     = COUNT_RESET; //older than one we already ran
+unsigned int datagrams_malformed = COUNT_RESET; //no <seq>: in front, or UDP is off
+unsigned int datagrams_bad_pin   = COUNT_RESET; //not counted under TCP
+
+
+
+//==============================================================================
+//D<n> - 1 opens the UDP port, 0 closes it
+void Start_UDP(char on){
+  if(on){
+    if(udp_server_cid != TCP_NO_CID)            //already open
+      return;
+    udp_server_next = NO;
+    udp_server_matcher.index = COUNT_RESET;
+    if(!AT_Send_Hook(UDP_PORT_COMMAND, NULL, AT_DEFAULT_TIMEOUT, AT_DEFAULT_RETRIES,
+                     UDP_Server_Done, UDP_Server_Char))
+      UDP_Server_Done(AT_RESULT_ERROR);         //AT queue is full
+    return;
+  }
+  udp_enabled = NO;                             //stop listening right away
+  if(udp_server_cid == TCP_NO_CID)
+    return;
+  udp_close_command[UDP_CLOSE_CID_INDEX] = udp_server_cid;
+  udp_server_cid = TCP_NO_CID;
+  AT_Send(udp_close_command, NULL, AT_DEFAULT_TIMEOUT, EMPTY, UDP_Close_Done);
+}
+
+//the AT+NSUDP reply, CONNECT <cid> then OK
+void UDP_Server_Char(char c){
+  if(udp_server_next){
+    udp_server_cid = c;
+    udp_server_next = NO;
+  }
+  else if(AT_Match(&udp_server_matcher, c))
+    udp_server_next = YES;
+}
+
+void UDP_Server_Done(char result){
+  if(result == AT_RESULT_OK && udp_server_cid != TCP_NO_CID){
+    udp_enabled = YES;
+    udp_seen = NO;                              //new port, new controller
+    strcpy(display_line[DISPLAY_LINE_2], "UDP  4167 ");
+  }
+  else{
+    udp_server_cid = TCP_NO_CID;
+    strcpy(display_line[DISPLAY_LINE_2], "UDP FAILED");
+  }
+}
+
+//the module was reset, the port is gone
+void clear_UDP(void){
+  udp_enabled = NO;
+  udp_server_cid = TCP_NO_CID;
+}
+
+void UDP_Close_Done(char result){
+  if(result == AT_RESULT_OK)
+    strcpy(display_line[DISPLAY_LINE_2], "UDP closed");
+}
+
+
+//==============================================================================
+//a datagram from frames.c, NUL terminated
+void UDP_Datagram(Frame* frame){
+  char* c = frame->data;
+  unsigned int seq = COUNT_RESET;
+  if(!udp_enabled){
+    datagrams_malformed++;
+    return;
+  }
+  if(*c < '0' || *c > '9'){                     //has to start with the seq
+    datagrams_malformed++;
+    return;
+  }
+  while(*c >= '0' && *c <= '9'){
+    seq *= MOVE_UP_A_TENS_PLACE;                //wraps at 65535 like the sender
+    seq += (*c - MAKE_A_CHAR);
+    c++;
+  }
+  if(*c != UDP_SEQ_SEPARATOR){
+    datagrams_malformed++;
+    return;
+  }
+  c++;
+  if(!Command_Pin_OK(c)){                       //before it can touch the seq
+    datagrams_bad_pin++;
+    return;
+  }
+  if(udp_seen && (int)(seq - udp_last_seq) <= EMPTY            //signed, so the wrap is fine
+     && (int)(TA0_tick - udp_last_tick) < UDP_RESYNC_TIME){
+    datagrams_stale++;
+    return;
+  }
+  udp_seen = YES;
+  udp_last_seq = seq;
+  udp_last_tick = TA0_tick;
+  datagrams_accepted++;
+  command_via = VIA_UDP;
+  command_arrival = frame->arrival;
+  command_takeover = YES;                       //the newest one wins
+  Execute_Command(c, COMMAND_SOURCE_TCP, TCP_NO_CID);  //no cid, replies go nowhere
+  command_takeover = NO;
+}